@@ -29,6 +29,7 @@
 */
 
 #include "WriteGrayscaleTIFF.h"
+#include "thread_pool.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -59,11 +60,53 @@
 #define PlanarConfiguration 284
 #define ResolutionUnit      296
 #define Software            305
+#define Predictor           317
 #define ColorMap            320
+#define TileWidth           322
+#define TileLength          323
+#define TileOffsets         324
+#define TileByteCounts      325
 #define TIFFTAG_SAMPLEFORMAT        339 // data sample format
+#define ModelPixelScale           33550 // GeoTIFF: pixel size in model coordinates
+#define ModelTiepoint             33922 // GeoTIFF: model coordinates of a raster point
+#define GeoKeyDirectory           34735 // GeoTIFF: keys describing the coordinate system
+#define TIFFTAG_GDAL_NODATA       42113 // ASCII value of void pixels, as used by GDAL
 
 #define PHOTOMETRIC_MINISBLACK  1      // min value is black
 #define SAMPLEFORMAT_UINT       1      // unsigned integer data
+#define COMPRESSION_NONE        1
+#define COMPRESSION_LZW         5
+#define PREDICTOR_NONE          1
+#define PREDICTOR_HORIZONTAL    2      // each sample stored as difference from the one to its left
+#define FILETYPE_REDUCEDIMAGE   1      // reduced-resolution version of another image in the file
+
+// GeoTIFF keys and values
+#define GTModelTypeGeoKey       1024
+#define GTRasterTypeGeoKey      1025
+#define GeographicTypeGeoKey    2048
+#define ProjectedCSTypeGeoKey   3072
+#define ModelTypeProjected      1
+#define ModelTypeGeographic     2
+#define RasterPixelIsArea       1      // tiepoint at upper left corner of pixel, not its center
+
+// Width and height of tiles in compressed TIFF output (a multiple of 16, as TIFF requires)
+#define TILE_SIZE 256
+
+// Most images in compressed TIFF output: the full-resolution image and its overviews
+#define MAX_TIFF_LEVELS 32
+
+// Codes of TIFF's variant of LZW compression, which are 9 to 12 bits long
+#define LZW_CLEAR     256
+#define LZW_EOI       257
+#define LZW_FIRST     258
+#define LZW_MAX_CODE  4095
+#define LZW_MIN_BITS  9
+#define LZW_HASH_BITS 13     // hash table of about twice the number of codes
+#define LZW_HASH_SIZE (1 << LZW_HASH_BITS)
+
+// Largest LZW output for count bytes of input: every byte a code of at most
+// 12 bits, plus clear codes, the final code, EOI, and padding
+#define LZW_BOUND(count) ((count) * 3 / 2 + (count) / 1024 + 16)
 
 static int am_big_endian()
    {
@@ -130,7 +173,7 @@ static int WriteString(FILE *hFileRef, const char *str, int count)
       return -1;
       }
 
-   if (count & (1 == 0))
+   if ((count & 1) == 0)
       {
       return 0;
       }
@@ -196,7 +239,7 @@ static int WriteTIFFAsciiTag(FILE *hFile, int tag, const char *str, int count, i
 
    if (count <= 0) return 0;
 
-   err = WriteTIFFTag(hFile, Software, TIFFascii, count, offset);
+   err = WriteTIFFTag(hFile, tag, TIFFascii, count, offset);
 
    if (count > 4)
       {
@@ -217,7 +260,7 @@ static int WriteBigTIFFAsciiTag(FILE *hFile, int tag, const char *str, int count
 
    if (count <= 0) return 0;
 
-   err = WriteBigTIFFTag(hFile, Software, TIFFascii, count, offset);
+   err = WriteBigTIFFTag(hFile, tag, TIFFascii, count, offset);
 
    if (count > 8)
       {
@@ -231,16 +274,147 @@ static int WriteBigTIFFAsciiTag(FILE *hFile, int tag, const char *str, int count
    return err;
    }
 
-static int WriteBitmap(FILE *hFile, int width, int height, const float *data)
+static int WriteDouble(FILE *hFileRef, double x)
+   {
+   int lCount;
+
+   lCount = fwrite(&x, sizeof(double), 1, hFileRef);
+   if (lCount != 1)
+      {
+      return -1;
+      }
+
+   return 0;
+   }
+
+static int GeoKeyCount(const GeoTIFFInfo *geo)
+   {
+   return geo->epsg ? 3 : 2;
+   }
+
+static int GeoTIFFSpace(const GeoTIFFInfo *geo)
+   // Number of bytes of GeoTIFF tag values, as written by WriteGeoTIFFValues()
+   {
+   if (!geo)
+      {
+      return 0;
+      }
+
+   return 3*8 + 6*8 + (GeoKeyCount(geo) + 1) * 4*2;
+   }
+
+static int WriteGeoTIFFTags(FILE *hFile, const GeoTIFFInfo *geo, int bigTIFF, long long offset)
+   // Writes the 3 GeoTIFF tags, whose values will be written at offset
+   {
+   int err;
+   int keyShorts = (GeoKeyCount(geo) + 1) * 4;
+
+   if (bigTIFF)
+      {
+      err  = WriteBigTIFFTag(hFile, ModelPixelScale, TIFFdouble, 3, offset);
+      err |= WriteBigTIFFTag(hFile, ModelTiepoint, TIFFdouble, 6, offset + 3*8);
+      err |= WriteBigTIFFTag(hFile, GeoKeyDirectory, TIFFshort, keyShorts, offset + 9*8);
+      }
+   else
+      {
+      err  = WriteTIFFTag(hFile, ModelPixelScale, TIFFdouble, 3, (int) offset);
+      err |= WriteTIFFTag(hFile, ModelTiepoint, TIFFdouble, 6, (int) offset + 3*8);
+      err |= WriteTIFFTag(hFile, GeoKeyDirectory, TIFFshort, keyShorts, (int) offset + 9*8);
+      }
+
+   return err;
+   }
+
+static int WriteGeoTIFFValues(FILE *hFile, const GeoTIFFInfo *geo)
+   {
+   int err;
+
+   // pixel scale (positive Y scale for rows running in the -Y direction)
+   err  = WriteDouble(hFile, geo->xdim);
+   err |= WriteDouble(hFile, geo->ydim);
+   err |= WriteDouble(hFile, 0.0);
+
+   // upper left corner of upper left pixel
+   err |= WriteDouble(hFile, 0.0);
+   err |= WriteDouble(hFile, 0.0);
+   err |= WriteDouble(hFile, 0.0);
+   err |= WriteDouble(hFile, geo->xmin);
+   err |= WriteDouble(hFile, geo->ymax);
+   err |= WriteDouble(hFile, 0.0);
+
+   // key directory version 1.1.0, then each key ID, location (0 = value here), count, and value
+   err |= WriteWord(hFile, 1);
+   err |= WriteWord(hFile, 1);
+   err |= WriteWord(hFile, 0);
+   err |= WriteWord(hFile, (unsigned short) GeoKeyCount(geo));
+
+   err |= WriteWord(hFile, GTModelTypeGeoKey);
+   err |= WriteWord(hFile, 0);
+   err |= WriteWord(hFile, 1);
+   err |= WriteWord(hFile, geo->geographic ? ModelTypeGeographic : ModelTypeProjected);
+
+   err |= WriteWord(hFile, GTRasterTypeGeoKey);
+   err |= WriteWord(hFile, 0);
+   err |= WriteWord(hFile, 1);
+   err |= WriteWord(hFile, RasterPixelIsArea);
+
+   if (geo->epsg)
+      {
+      err |= WriteWord(hFile, geo->geographic ? GeographicTypeGeoKey : ProjectedCSTypeGeoKey);
+      err |= WriteWord(hFile, 0);
+      err |= WriteWord(hFile, 1);
+      err |= WriteWord(hFile, (unsigned short) geo->epsg);
+      }
+
+   return err;
+   }
+
+static unsigned short Quantize16Bit(float fltval)
+   {
+   const unsigned short nodata = 0;
+
+   if (flt_isnan(fltval))
+      {
+      return nodata;
+      }
+   // check limits before integer conversion to avoid overflow
+   else if (fltval <= 0.0)
+      {
+      return 0;
+      }
+   else if (fltval >= 65535.0)
+      {
+      return 65535;
+      }
+   else
+      {
+      return (unsigned short) (fltval+0.5);
+      }
+   }
+
+static int WriteBitmap(FILE *hFile, int width, int height, const void *data, int bitsPerSample)
+   // data is floats quantized to 16 bits, or 8-bit pixels written as is
    {
    int lCount;
    int i, j;
-   float fltval;
    const float *ptr;
    int bufsize;
    unsigned short *buffer;
 
-   const unsigned short nodata = 0;
+   if (bitsPerSample == 8)
+      {
+      const unsigned char *pixels = (const unsigned char *) data;
+
+      for (i=0; i<height; ++i, pixels+=width)
+         {
+         lCount = fwrite(pixels, 1, width, hFile);
+         if (lCount != width)
+            {
+            return -1;
+            }
+         }
+      return 0;
+      }
 
    bufsize = width * sizeof(unsigned short);
    buffer = (unsigned short *) malloc(bufsize);
@@ -249,28 +423,11 @@ static int WriteBitmap(FILE *hFile, int width, int height, const float *data)
       return -2;
       }
 
-   for (i=0, ptr=data; i<height; ++i, ptr+=width)
+   for (i=0, ptr=(const float *) data; i<height; ++i, ptr+=width)
       {
       for (j=0; j<width; ++j)
          {
-         fltval = ptr[j];
-         if (flt_isnan(fltval))
-            {
-            buffer[j] = nodata;
-            }
-         // check limits before integer conversion to avoid overflow
-         else if (fltval <= 0.0)
-            {
-            buffer[j] = 0;
-            }
-         else if (fltval >= 65535.0)
-            {
-            buffer[j] = 65535;
-            }
-         else
-            {
-            buffer[j] = (unsigned short) (fltval+0.5);
-            }
+         buffer[j] = Quantize16Bit(ptr[j]);
          }
 
       lCount = fwrite(buffer, sizeof(unsigned short), width, hFile);
@@ -285,8 +442,14 @@ static int WriteBitmap(FILE *hFile, int width, int height, const float *data)
    return 0;
    }
 
-int WriteGrayscale16BitToTIFF(
-   FILE *hFile, int width, int height, const float *data, const char *softwareVersion, size_t *fileSize
+static int WriteGrayscaleStripBigTIFF(
+   FILE *hFile, int width, int height, const void *data, int bitsPerSample,
+   const char *softwareVersion, const GeoTIFFInfo *geo, int nodata, size_t *fileSize
+);
+
+static int WriteGrayscaleStripTIFF(
+   FILE *hFile, int width, int height, const void *data, int bitsPerSample,
+   const char *softwareVersion, const GeoTIFFInfo *geo, int nodata, size_t *fileSize
 )
    {
    size_t lWriteCount, tiffSize;
@@ -294,10 +457,12 @@ int WriteGrayscale16BitToTIFF(
    long pos, offsetpos;
    int err;
    int softwareCount, softwareSpace;
+   int nodataCount;
+   char nodataString[4];
 
    err = 0;
 
-   lWriteCount = (size_t) height * (size_t) width * sizeof(unsigned short);
+   lWriteCount = (size_t) height * (size_t) width * (bitsPerSample / 8);
 
    softwareCount = softwareVersion ? strlen(softwareVersion) : 0;
 
@@ -310,6 +475,18 @@ int WriteGrayscale16BitToTIFF(
       sTagCount++;
       }
 
+   nodataCount = 0;
+   if (nodata >= 0)
+      {
+      nodataCount = sprintf(nodataString, "%d", nodata & 0xFF) + 1;  // include NUL terminator
+      sTagCount++;
+      }
+
+   if (geo)
+      {
+      sTagCount += 3;
+      }
+
 // Write the header
    if (am_big_endian())
       {
@@ -343,7 +520,7 @@ int WriteGrayscale16BitToTIFF(
 
    err |= WriteTIFFTag(hFile, ImageWidth, TIFFlong, 1, width);
    err |= WriteTIFFTag(hFile, ImageLength, TIFFlong, 1, height);
-   err |= WriteTIFFTag(hFile, BitsPerSample, TIFFshort, 1, 16);
+   err |= WriteTIFFTag(hFile, BitsPerSample, TIFFshort, 1, bitsPerSample);
    err |= WriteTIFFTag(hFile, Compression, TIFFshort, 1, 1);
    err |= WriteTIFFTag(hFile, PhotometricInterp, TIFFshort, 1, PHOTOMETRIC_MINISBLACK);
    err |= WriteTIFFTag(hFile, StripOffsets, TIFFlong, 1, 0);
@@ -364,9 +541,23 @@ int WriteGrayscale16BitToTIFF(
       err |= WriteTIFFAsciiTag(hFile, Software, softwareVersion, softwareCount, 24);
       }
    err |= WriteTIFFTag(hFile, TIFFTAG_SAMPLEFORMAT, TIFFshort, 1, SAMPLEFORMAT_UINT);
+   if (geo)
+      {
+      // values follow the tags
+      err |= WriteGeoTIFFTags(hFile, geo, 0, 24 + softwareSpace + 2 + 12 * sTagCount + 4);
+      }
+   if (nodataCount)
+      {
+      err |= WriteTIFFAsciiTag(hFile, TIFFTAG_GDAL_NODATA, nodataString, nodataCount, 0);
+      }
 
    err |= WriteLong(hFile, 0);
 
+   if (geo)
+      {
+      err |= WriteGeoTIFFValues(hFile, geo);
+      }
+
    if (err)
       {
       return err;
@@ -384,7 +575,8 @@ int WriteGrayscale16BitToTIFF(
    if ((tiffSize-1)>>31 > 1)
       {
       rewind(hFile);
-      return WriteGrayscale16BitToBigTIFF(hFile, width, height, data, softwareVersion, fileSize);
+      return WriteGrayscaleStripBigTIFF(
+         hFile, width, height, data, bitsPerSample, softwareVersion, geo, nodata, fileSize);
       }
 
    if (fileSize)
@@ -401,14 +593,15 @@ int WriteGrayscale16BitToTIFF(
       return err;
       }
 
-   err = WriteBitmap(hFile, width, height, data);
+   err = WriteBitmap(hFile, width, height, data, bitsPerSample);
 
    return err;
    }
 
 
-int WriteGrayscale16BitToBigTIFF(
-   FILE *hFile, int width, int height, const float *data, const char *softwareVersion, size_t *fileSize
+static int WriteGrayscaleStripBigTIFF(
+   FILE *hFile, int width, int height, const void *data, int bitsPerSample,
+   const char *softwareVersion, const GeoTIFFInfo *geo, int nodata, size_t *fileSize
 )
    {
    size_t lWriteCount;
@@ -416,10 +609,12 @@ int WriteGrayscale16BitToBigTIFF(
    long pos, offsetpos;
    int err;
    int softwareCount, softwareSpace;
+   int nodataCount;
+   char nodataString[4];
 
    err = 0;
 
-   lWriteCount = (size_t) height * (size_t) width * sizeof(unsigned short);
+   lWriteCount = (size_t) height * (size_t) width * (bitsPerSample / 8);
 
    softwareCount = softwareVersion ? strlen(softwareVersion) : 0;
 
@@ -432,6 +627,18 @@ int WriteGrayscale16BitToBigTIFF(
       sTagCount++;
       }
 
+   nodataCount = 0;
+   if (nodata >= 0)
+      {
+      nodataCount = sprintf(nodataString, "%d", nodata & 0xFF) + 1;  // include NUL terminator
+      sTagCount++;
+      }
+
+   if (geo)
+      {
+      sTagCount += 3;
+      }
+
 // Write the header
    if (am_big_endian())
       {
@@ -460,7 +667,7 @@ int WriteGrayscale16BitToBigTIFF(
 
    err |= WriteBigTIFFTag(hFile, ImageWidth, TIFFlong, 1, width);
    err |= WriteBigTIFFTag(hFile, ImageLength, TIFFlong, 1, height);
-   err |= WriteBigTIFFTag(hFile, BitsPerSample, TIFFshort, 1, 16);
+   err |= WriteBigTIFFTag(hFile, BitsPerSample, TIFFshort, 1, bitsPerSample);
    err |= WriteBigTIFFTag(hFile, Compression, TIFFshort, 1, 1);
    err |= WriteBigTIFFTag(hFile, PhotometricInterp, TIFFshort, 1, PHOTOMETRIC_MINISBLACK);
    err |= WriteBigTIFFTag(hFile, StripOffsets, TIFFlong, 1, 0);
@@ -490,9 +697,23 @@ int WriteGrayscale16BitToBigTIFF(
       err |= WriteBigTIFFAsciiTag(hFile, Software, softwareVersion, softwareCount, 24);
       }
    err |= WriteBigTIFFTag(hFile, TIFFTAG_SAMPLEFORMAT, TIFFshort, 1, SAMPLEFORMAT_UINT);
+   if (geo)
+      {
+      // values follow the tags
+      err |= WriteGeoTIFFTags(hFile, geo, 1, 24 + softwareSpace + 8 + 20 * sTagCount + 8);
+      }
+   if (nodataCount)
+      {
+      err |= WriteBigTIFFAsciiTag(hFile, TIFFTAG_GDAL_NODATA, nodataString, nodataCount, 0);
+      }
 
    err |= Write8Byte(hFile, 0);
 
+   if (geo)
+      {
+      err |= WriteGeoTIFFValues(hFile, geo);
+      }
+
    if (err)
       {
       return err;
@@ -519,7 +740,870 @@ int WriteGrayscale16BitToBigTIFF(
       return err;
       }
 
-   err = WriteBitmap(hFile, width, height, data);
+   err = WriteBitmap(hFile, width, height, data, bitsPerSample);
+
+   return err;
+   }
+
+
+// Bit packer for LZW output
+typedef struct
+   {
+   unsigned char *bytes;   // output buffer, at least LZW_BOUND(input count) bytes
+   size_t size;            // number of bytes output
+   unsigned long bits;     // low nbits bits not yet output
+   int nbits;
+   } LZWOutput;
+
+static void PutCode(LZWOutput *out, int code, int codeBits)
+   {
+   out->bits = (out->bits << codeBits) | (unsigned long) code;
+   out->nbits += codeBits;
+   while (out->nbits >= 8)
+      {
+      out->nbits -= 8;
+      out->bytes[out->size++] = (unsigned char) (out->bits >> out->nbits);
+      }
+   }
+
+static size_t LZWEncode(const unsigned char *in, size_t count, unsigned char *out)
+   // Compresses count bytes with TIFF's LZW (which switches to longer codes
+   // one code early) into out; returns number of bytes output.
+   // Table entries are found by hashing (prefix code, next byte) pairs.
+   {
+   long  keys [LZW_HASH_SIZE];  // (prefix << 8 | byte) of each entry, or -1
+   short codes[LZW_HASH_SIZE];  // code of each entry
+   LZWOutput output;
+   size_t i;
+   int codeBits = LZW_MIN_BITS;
+   int nextCode = LZW_FIRST;
+   int prefix;
+
+   output.bytes = out;
+   output.size  = 0;
+   output.bits  = 0;
+   output.nbits = 0;
+
+   memset(keys, -1, sizeof(keys));
+   PutCode(&output, LZW_CLEAR, codeBits);
+
+   if (count > 0)
+      {
+      prefix = in[0];
+      for (i=1; i<=count; ++i)
+         {
+         if (i < count)
+            {
+            long key = ((long) prefix << 8) | in[i];
+            unsigned int h = ((unsigned int) key * 2654435761U) >> (32 - LZW_HASH_BITS);
+
+            h &= LZW_HASH_SIZE - 1;
+            while (keys[h] != -1 && keys[h] != key)
+               {
+               h = (h + 1) & (LZW_HASH_SIZE - 1);
+               }
+            if (keys[h] == key)
+               {
+               prefix = codes[h];  // string continues in table
+               continue;
+               }
+
+            PutCode(&output, prefix, codeBits);
+            keys[h]  = key;
+            codes[h] = (short) nextCode;
+            prefix = in[i];
+            }
+         else
+            {
+            PutCode(&output, prefix, codeBits);    // final string
+            }
+
+         // the code just assigned (or, at the end, that would be) may need a longer code next
+         if (++nextCode == LZW_MAX_CODE - 1)
+            {
+            PutCode(&output, LZW_CLEAR, codeBits);
+            memset(keys, -1, sizeof(keys));
+            nextCode = LZW_FIRST;
+            codeBits = LZW_MIN_BITS;
+            }
+         else if (nextCode > (1 << codeBits) - 1)
+            {
+            ++codeBits;
+            }
+         }
+      }
+
+   PutCode(&output, LZW_EOI, codeBits);
+   if (output.nbits > 0)
+      {
+      PutCode(&output, 0, 8 - output.nbits);
+      }
+
+   return output.size;
+   }
+
+// Parameters shared by all tiles of compressed TIFF output
+typedef struct
+   {
+   const void *data;        // floats quantized to 16 bits, or 8-bit pixels
+   int bitsPerSample;
+   int compression;         // COMPRESSION_LZW, or COMPRESSION_NONE to copy samples as is
+   int width;
+   int height;
+   int tilesAcross;
+   long firstTile;          // tile compressed into outputs[0]
+   unsigned char **outputs; // compressed bytes of each tile of batch
+   size_t *sizes;           // number of compressed bytes of each tile of batch
+   char *failed;            // per tile of batch: set nonzero if the chunk starting there
+                            // failed to allocate memory
+   } TileTask;
+
+// Thread_Pool_Task compressing tiles firstTile+begin..firstTile+end-1
+static void CompressTilesTask(void *state, long begin, long end)
+   {
+   TileTask *task = (TileTask *) state;
+   size_t tileBytes = TILE_SIZE * TILE_SIZE * (task->bitsPerSample / 8);
+   int differencing = task->compression == COMPRESSION_LZW;
+   unsigned char *samples;
+   long n;
+   int i, j;
+
+   samples = (unsigned char *) malloc(tileBytes);
+   if (!samples)
+      {
+      task->failed[begin] = 1;   // each chunk writes only its own flag
+      return;
+      }
+
+   for (n=begin; n<end; ++n)
+      {
+      long tile = task->firstTile + n;
+      int row0 = (int) (tile / task->tilesAcross) * TILE_SIZE;
+      int col0 = (int) (tile % task->tilesAcross) * TILE_SIZE;
+
+      for (i=0; i<TILE_SIZE; ++i)
+         {
+         // edge tiles are padded by repeating the last row and column of the image
+         int row = row0 + i < task->height ? row0 + i : task->height - 1;
+         size_t offset = (size_t) row * task->width;
+
+         // horizontal differencing, modulo 2^bitsPerSample
+         if (task->bitsPerSample == 8)
+            {
+            const unsigned char *ptr = (const unsigned char *) task->data + offset;
+            unsigned char *tileRow = samples + i * TILE_SIZE;
+            unsigned char left = 0;
+
+            for (j=0; j<TILE_SIZE; ++j)
+               {
+               int col = col0 + j < task->width ? col0 + j : task->width - 1;
+               unsigned char value = ptr[col];
+
+               tileRow[j] = (unsigned char) (value - left);
+               left = differencing ? value : 0;
+               }
+            }
+         else
+            {
+            const float *ptr = (const float *) task->data + offset;
+            unsigned short *tileRow = (unsigned short *) samples + i * TILE_SIZE;
+            unsigned short left = 0;
+
+            for (j=0; j<TILE_SIZE; ++j)
+               {
+               int col = col0 + j < task->width ? col0 + j : task->width - 1;
+               unsigned short value = Quantize16Bit(ptr[col]);
+
+               tileRow[j] = (unsigned short) (value - left);
+               left = differencing ? value : 0;
+               }
+            }
+         }
+
+      if (task->compression == COMPRESSION_LZW)
+         {
+         task->sizes[n] = LZWEncode(samples, tileBytes, task->outputs[n]);
+         }
+      else
+         {
+         memcpy(task->outputs[n], samples, tileBytes);
+         task->sizes[n] = tileBytes;
+         }
+      }
+
+   free(samples);
+   }
+
+static int WriteTileArray(FILE *hFile, const long long *values, long count, int bigTIFF)
+   {
+   int err = 0;
+   long n;
+
+   for (n=0; n<count; ++n)
+      {
+      err |= bigTIFF ? Write8Byte(hFile, values[n]) : WriteLong(hFile, (unsigned int) values[n]);
+      }
+
+   return err;
+   }
+
+// One image of tiled TIFF output: the full-resolution image or an overview
+typedef struct
+   {
+   const void *data;        // floats quantized to 16 bits, or 8-bit pixels
+   int width;
+   int height;
+   int compression;         // COMPRESSION_LZW or COMPRESSION_NONE
+   long numTiles;
+   long long *tileOffsets;  // file position of each tile
+   long long *tileByteCounts;
+   } TiledImage;
+
+static int WriteCompressedTiles(
+   FILE *hFile, TiledImage *image, int bitsPerSample, long long limit, long long *totalBytes
+)
+   // Writes the tiles of image at the current file position, filling in its
+   // tile offsets and byte counts, and adds up their sizes in *totalBytes;
+   // returns -1 on write error, -2 on memory error. If limit is nonzero, stops
+   // (without writing the tile) once the total reaches limit, so that fewer than
+   // limit bytes are written.
+   {
+   TileTask task;
+   long batch, first, n;
+   size_t bound;
+   int err;
+   int failed;
+
+   err = 0;
+   *totalBytes = 0;
+
+   task.data          = image->data;
+   task.bitsPerSample = bitsPerSample;
+   task.compression   = image->compression;
+   task.width         = image->width;
+   task.height        = image->height;
+   task.tilesAcross   = (image->width  + TILE_SIZE - 1) / TILE_SIZE;
+   image->numTiles    = task.tilesAcross * (long) ((image->height + TILE_SIZE - 1) / TILE_SIZE);
+   failed             = 0;
+
+   // compress a few tiles per thread at a time, to limit memory use
+   batch = 4L * thread_pool_threads();
+   if (batch > image->numTiles)
+      {
+      batch = image->numTiles;
+      }
+   bound = LZW_BOUND(TILE_SIZE * TILE_SIZE * (bitsPerSample / 8));
+
+   image->tileOffsets    = (long long *) malloc(image->numTiles * sizeof(long long));
+   image->tileByteCounts = (long long *) malloc(image->numTiles * sizeof(long long));
+   if (!image->tileOffsets || !image->tileByteCounts)
+      {
+      return -2;
+      }
+   task.outputs = (unsigned char **) calloc(batch, sizeof(unsigned char *));
+   task.sizes   = (size_t *) malloc(batch * sizeof(size_t));
+   task.failed  = (char *) calloc(batch, 1);
+   if (!task.outputs || !task.sizes || !task.failed)
+      {
+      free(task.outputs);
+      free(task.sizes);
+      free(task.failed);
+      return -2;
+      }
+   for (n=0; n<batch; ++n)
+      {
+      task.outputs[n] = (unsigned char *) malloc(bound);
+      if (!task.outputs[n])
+         {
+         failed = 1;
+         }
+      }
+
+   // CONCURRENCY NOTE: Each tile reads only the data array and writes only
+   // its own output buffer; tiles are then written in order.
+
+   for (first=0; first<image->numTiles && !err && !failed; first+=batch)
+      {
+      long count = image->numTiles - first < batch ? image->numTiles - first : batch;
+
+      task.firstTile = first;
+      thread_pool_run(count, 1, CompressTilesTask, &task);
+
+      failed = memchr(task.failed, 1, count) != NULL;
+      for (n=0; n<count && !failed; ++n)
+         {
+         long pos;
+
+         *totalBytes += task.sizes[n];
+         if (limit && *totalBytes >= limit)
+            {
+            break;
+            }
+         pos = ftell(hFile);
+         if (pos < 0 || fwrite(task.outputs[n], 1, task.sizes[n], hFile) != task.sizes[n])
+            {
+            err = -1;
+            break;
+            }
+         image->tileOffsets[first+n]    = pos;
+         image->tileByteCounts[first+n] = task.sizes[n];
+         }
+      if (limit && *totalBytes >= limit)
+         {
+         break;
+         }
+      }
+
+   for (n=0; n<batch; ++n)
+      {
+      free(task.outputs[n]);
+      }
+   free(task.outputs);
+   free(task.sizes);
+   free(task.failed);
+
+   if (failed && !err)
+      {
+      err = -2;
+      }
+
+   return err;
+   }
+
+// Parameters for reducing an image to half its width and height
+typedef struct
+   {
+   const void *data;        // floats, or 8-bit pixels
+   void *reduced;           // output: same type as data
+   int bitsPerSample;
+   int width;               // of data
+   int height;
+   int nodata;              // 8-bit value of void pixels, or negative if none
+   } ReduceTask;
+
+// Thread_Pool_Task computing reduced rows begin..end-1
+static void ReduceRowsTask(void *state, long begin, long end)
+   {
+   ReduceTask *task = (ReduceTask *) state;
+   int reducedWidth = (task->width + 1) / 2;
+   long i;
+   int j, di, dj;
+
+   for (i=begin; i<end; ++i)
+      {
+      // each reduced pixel is the mean of the (up to) 2x2 pixels it covers, skipping void ones
+      int rows = 2*i + 1 < task->height ? 2 : 1;
+
+      for (j=0; j<reducedWidth; ++j)
+         {
+         int cols = 2*j + 1 < task->width ? 2 : 1;
+         int count = 0;
+
+         if (task->bitsPerSample == 8)
+            {
+            const unsigned char *ptr = (const unsigned char *) task->data;
+            unsigned char *out = (unsigned char *) task->reduced + (size_t) i * reducedWidth;
+            int sum = 0;
+
+            for (di=0; di<rows; ++di)
+               {
+               for (dj=0; dj<cols; ++dj)
+                  {
+                  int value = ptr[(size_t) (2*i + di) * task->width + 2*j + dj];
+                  if (value != task->nodata)
+                     {
+                     sum += value;
+                     count++;
+                     }
+                  }
+               }
+            out[j] = (unsigned char) (count ? (sum + count/2) / count : task->nodata);
+            }
+         else
+            {
+            const float *ptr = (const float *) task->data;
+            float *out = (float *) task->reduced + (size_t) i * reducedWidth;
+            float sum = 0.0f;
+
+            for (di=0; di<rows; ++di)
+               {
+               for (dj=0; dj<cols; ++dj)
+                  {
+                  float value = ptr[(size_t) (2*i + di) * task->width + 2*j + dj];
+                  if (!flt_isnan(value))
+                     {
+                     sum += value;
+                     count++;
+                     }
+                  }
+               }
+            out[j] = count ? sum / count : ptr[(size_t) (2*i) * task->width + 2*j];  // NaN if none
+            }
+         }
+      }
+   }
+
+static void *ReduceImage(const void *data, int width, int height, int bitsPerSample, int nodata)
+   // Returns a new image of half the width and height (rounded up) of data,
+   // or NULL if memory allocation failed
+   {
+   ReduceTask task;
+   int reducedWidth  = (width  + 1) / 2;
+   int reducedHeight = (height + 1) / 2;
+   size_t sampleSize = bitsPerSample == 8 ? 1 : sizeof(float);
+
+   task.reduced = malloc((size_t) reducedWidth * (size_t) reducedHeight * sampleSize);
+   if (!task.reduced)
+      {
+      return NULL;
+      }
+
+   task.data          = data;
+   task.bitsPerSample = bitsPerSample;
+   task.width         = width;
+   task.height        = height;
+   task.nodata        = nodata;
+
+   // CONCURRENCY NOTE: Each reduced row reads only the data array and
+   // writes only its own pixels.
+
+   thread_pool_run(reducedHeight, 16, ReduceRowsTask, &task);
+
+   return task.reduced;
+   }
+
+static int WriteTiledIFD(
+   FILE *hFile, const TiledImage *image, int overview, int bitsPerSample, int bigTIFF,
+   const char *softwareVersion, const GeoTIFFInfo *geo, const char *nodataString, long long *nextPos
+)
+   // Writes the image file directory of image at the current file position,
+   // followed by the values that don't fit in it; overviews get only the tags
+   // that describe the image data. The offset of the next IFD is left 0, and
+   // its file position returned in *nextPos.
+   {
+   long long ifdPos, extraPos, pos, geoPos, offsetsPos, countsPos;
+   long numTiles = image->numTiles;
+   int entrySize, fieldSize;
+   int err;
+   int softwareCount, softwareSpace;
+   int nodataCount;
+   int predictor;
+   short sTagCount;
+
+   err = 0;
+
+   predictor = image->compression == COMPRESSION_LZW ? PREDICTOR_HORIZONTAL : PREDICTOR_NONE;
+   softwareCount = softwareVersion && !overview ? strlen(softwareVersion) : 0;
+   nodataCount   = nodataString    && !overview ? strlen(nodataString)    : 0;
+   if (overview)
+      {
+      geo = NULL;
+      }
+
+   sTagCount = overview ? 14 : 16;
+   softwareSpace = 0;
+   if (softwareCount)
+      {
+      softwareCount++;  // include NUL terminator
+      softwareSpace = softwareCount + (softwareCount & 1);  // round up to word boundary
+      sTagCount++;
+      }
+   if (nodataCount)
+      {
+      nodataCount++;    // include NUL terminator
+      sTagCount++;
+      }
+   if (geo)
+      {
+      sTagCount += 3;
+      }
+
+   ifdPos = ftell(hFile);
+   if (ifdPos < 0)
+      {
+      return -1;
+      }
+   if (ifdPos & 1)
+      {
+      err |= fputc(0, hFile) == EOF ? -1 : 0;  // pad to word boundary
+      ifdPos++;
+      }
+
+   entrySize = bigTIFF ? 20 : 12;
+   fieldSize = bigTIFF ?  8 :  4;
+   extraPos  = ifdPos + (bigTIFF ? 8 : 2) + entrySize * sTagCount + fieldSize;
+   *nextPos  = extraPos - fieldSize;
+
+   pos = extraPos;
+   if (!overview && !bigTIFF)
+      {
+      pos += 16;    // after X and Y resolutions
+      }
+   if (softwareCount > fieldSize)
+      {
+      pos += softwareSpace;
+      }
+   geoPos = pos;
+   pos += GeoTIFFSpace(geo);
+   offsetsPos = pos;
+   countsPos  = numTiles > 1 ? pos + fieldSize * numTiles : pos;
+
+   if (bigTIFF)
+      {
+      err |= Write8Byte(hFile, sTagCount);
+      if (overview)
+         {
+         err |= WriteBigTIFFTag(hFile, NewSubFile, TIFFlong, 1, FILETYPE_REDUCEDIMAGE);
+         }
+      err |= WriteBigTIFFTag(hFile, ImageWidth, TIFFlong, 1, image->width);
+      err |= WriteBigTIFFTag(hFile, ImageLength, TIFFlong, 1, image->height);
+      err |= WriteBigTIFFTag(hFile, BitsPerSample, TIFFshort, 1, bitsPerSample);
+      err |= WriteBigTIFFTag(hFile, Compression, TIFFshort, 1, image->compression);
+      err |= WriteBigTIFFTag(hFile, PhotometricInterp, TIFFshort, 1, PHOTOMETRIC_MINISBLACK);
+      err |= WriteBigTIFFTag(hFile, SamplesPerPixel, TIFFshort, 1, 1);
+
+      if (!overview)
+         {
+         err |= WriteBigTIFFTag(hFile, XResolution, TIFFrational, 1, 0);
+         err |= fseek(hFile, -8, SEEK_CUR);
+         err |= WriteLong(hFile, (int) (72*0x02710)); // X resolution in pixels per inch
+         err |= WriteLong(hFile, 0x02710);
+
+         err |= WriteBigTIFFTag(hFile, YResolution, TIFFrational, 1, 0);
+         err |= fseek(hFile, -8, SEEK_CUR);
+         err |= WriteLong(hFile, (int) (72*0x02710)); // Y resolution in pixels per inch
+         err |= WriteLong(hFile, 0x02710);
+         }
+
+      err |= WriteBigTIFFTag(hFile, PlanarConfiguration, TIFFshort, 1, 1);
+      if (!overview)
+         {
+         err |= WriteBigTIFFTag(hFile, ResolutionUnit, TIFFshort, 1, 2);
+         }
+      if (softwareCount)
+         {
+         err |= WriteBigTIFFAsciiTag(hFile, Software, softwareVersion, softwareCount, extraPos);
+         }
+      err |= WriteBigTIFFTag(hFile, Predictor, TIFFshort, 1, predictor);
+      err |= WriteBigTIFFTag(hFile, TileWidth, TIFFlong, 1, TILE_SIZE);
+      err |= WriteBigTIFFTag(hFile, TileLength, TIFFlong, 1, TILE_SIZE);
+      err |= WriteBigTIFFTag(hFile, TileOffsets, TIFFlong8, numTiles,
+                             numTiles > 1 ? offsetsPos : image->tileOffsets[0]);
+      err |= WriteBigTIFFTag(hFile, TileByteCounts, TIFFlong8, numTiles,
+                             numTiles > 1 ? countsPos : image->tileByteCounts[0]);
+      err |= WriteBigTIFFTag(hFile, TIFFTAG_SAMPLEFORMAT, TIFFshort, 1, SAMPLEFORMAT_UINT);
+      if (geo)
+         {
+         err |= WriteGeoTIFFTags(hFile, geo, 1, geoPos);
+         }
+      if (nodataCount)
+         {
+         err |= WriteBigTIFFAsciiTag(hFile, TIFFTAG_GDAL_NODATA, nodataString, nodataCount, 0);
+         }
+      err |= Write8Byte(hFile, 0);
+      }
+   else
+      {
+      err |= WriteWord(hFile, sTagCount);
+      if (overview)
+         {
+         err |= WriteTIFFTag(hFile, NewSubFile, TIFFlong, 1, FILETYPE_REDUCEDIMAGE);
+         }
+      err |= WriteTIFFTag(hFile, ImageWidth, TIFFlong, 1, image->width);
+      err |= WriteTIFFTag(hFile, ImageLength, TIFFlong, 1, image->height);
+      err |= WriteTIFFTag(hFile, BitsPerSample, TIFFshort, 1, bitsPerSample);
+      err |= WriteTIFFTag(hFile, Compression, TIFFshort, 1, image->compression);
+      err |= WriteTIFFTag(hFile, PhotometricInterp, TIFFshort, 1, PHOTOMETRIC_MINISBLACK);
+      err |= WriteTIFFTag(hFile, SamplesPerPixel, TIFFshort, 1, 1);
+      if (!overview)
+         {
+         err |= WriteTIFFTag(hFile, XResolution, TIFFrational, 1, (int) extraPos);
+         err |= WriteTIFFTag(hFile, YResolution, TIFFrational, 1, (int) extraPos + 8);
+         }
+      err |= WriteTIFFTag(hFile, PlanarConfiguration, TIFFshort, 1, 1);
+      if (!overview)
+         {
+         err |= WriteTIFFTag(hFile, ResolutionUnit, TIFFshort, 1, 2);
+         }
+      if (softwareCount)
+         {
+         err |= WriteTIFFAsciiTag(hFile, Software, softwareVersion, softwareCount, (int) extraPos + 16);
+         }
+      err |= WriteTIFFTag(hFile, Predictor, TIFFshort, 1, predictor);
+      err |= WriteTIFFTag(hFile, TileWidth, TIFFlong, 1, TILE_SIZE);
+      err |= WriteTIFFTag(hFile, TileLength, TIFFlong, 1, TILE_SIZE);
+      err |= WriteTIFFTag(hFile, TileOffsets, TIFFlong, numTiles,
+                          (int) (numTiles > 1 ? offsetsPos : image->tileOffsets[0]));
+      err |= WriteTIFFTag(hFile, TileByteCounts, TIFFlong, numTiles,
+                          (int) (numTiles > 1 ? countsPos : image->tileByteCounts[0]));
+      err |= WriteTIFFTag(hFile, TIFFTAG_SAMPLEFORMAT, TIFFshort, 1, SAMPLEFORMAT_UINT);
+      if (geo)
+         {
+         err |= WriteGeoTIFFTags(hFile, geo, 0, geoPos);
+         }
+      if (nodataCount)
+         {
+         err |= WriteTIFFAsciiTag(hFile, TIFFTAG_GDAL_NODATA, nodataString, nodataCount, 0);
+         }
+      err |= WriteLong(hFile, 0);
+
+      if (!overview)
+         {
+         err |= WriteLong(hFile, (int) (72*0x02710)); // X resolution in pixels per inch
+         err |= WriteLong(hFile, 0x02710);
+         err |= WriteLong(hFile, (int) (72*0x02710)); // Y resolution in pixels per inch
+         err |= WriteLong(hFile, 0x02710);
+         }
+      }
+
+   if (softwareCount > fieldSize)
+      {
+      err |= WriteString(hFile, softwareVersion, softwareCount);
+      }
+   if (geo)
+      {
+      err |= WriteGeoTIFFValues(hFile, geo);
+      }
+   if (numTiles > 1)
+      {
+      err |= WriteTileArray(hFile, image->tileOffsets,    numTiles, bigTIFF);
+      err |= WriteTileArray(hFile, image->tileByteCounts, numTiles, bigTIFF);
+      }
+
+   return err;
+   }
+
+static int WriteGrayscaleTiledTIFF(
+   FILE *hFile, int width, int height, const void *data, int bitsPerSample,
+   const char *softwareVersion, const GeoTIFFInfo *geo, int nodata, int overviews, size_t *fileSize
+)
+   {
+   TiledImage images[MAX_TIFF_LEVELS];
+   long long ifdPos, nextPos, endPos;
+   long long rawBytes, totalBytes;
+   int numLevels, level;
+   int bigTIFF;
+   int err;
+   char nodataString[4];
+   char header[16];
+
+   err = 0;
+
+   if (nodata >= 0)
+      {
+      sprintf(nodataString, "%d", nodata & 0xFF);
+      }
+
+   // the full-resolution image, then overviews until one fits in a tile
+   images[0].data   = data;
+   images[0].width  = width;
+   images[0].height = height;
+   numLevels = 1;
+   while (overviews && numLevels < MAX_TIFF_LEVELS &&
+          (images[numLevels-1].width > TILE_SIZE || images[numLevels-1].height > TILE_SIZE))
+      {
+      images[numLevels].data   = NULL;
+      images[numLevels].width  = (images[numLevels-1].width  + 1) / 2;
+      images[numLevels].height = (images[numLevels-1].height + 1) / 2;
+      numLevels++;
+      }
+   for (level=0; level<numLevels; ++level)
+      {
+      images[level].compression    = COMPRESSION_LZW;
+      images[level].tileOffsets    = NULL;
+      images[level].tileByteCounts = NULL;
+      }
+
+   rawBytes = (long long) width * height * (bitsPerSample / 8);
+
+// Write the tiles of every image after space for either kind of header, which is written last
+   memset(header, 0, sizeof(header));
+   if (fwrite(header, sizeof(header), 1, hFile) != 1)
+      {
+      err = -1;
+      }
+
+   // each overview is reduced from the previous image, which is then no longer needed
+   for (level=0; level<numLevels && !err; ++level)
+      {
+      if (level > 0)
+         {
+         images[level].data = ReduceImage(
+            images[level-1].data, images[level-1].width, images[level-1].height,
+            bitsPerSample, nodata);
+         if (level > 1)
+            {
+            free((void *) images[level-1].data);
+            }
+         if (!images[level].data)
+            {
+            err = -2;
+            break;
+            }
+         }
+      err = WriteCompressedTiles(
+         hFile, &images[level], bitsPerSample, level == 0 ? rawBytes : 0, &totalBytes);
+      if (level == 0 && !err && totalBytes >= rawBytes)
+         {
+         // noisy images (such as rough terrain) can get bigger with LZW; if compression
+         // doesn't make the full-resolution image any smaller, write it uncompressed over
+         // the (shorter) start of the file: in strips, or as tiles to keep the overviews
+         free(images[0].tileOffsets);
+         free(images[0].tileByteCounts);
+         images[0].tileOffsets    = NULL;
+         images[0].tileByteCounts = NULL;
+         if (numLevels == 1)
+            {
+            if (fseek(hFile, 0, SEEK_SET))
+               {
+               return -1;
+               }
+            return WriteGrayscaleStripTIFF(
+               hFile, width, height, data, bitsPerSample, softwareVersion, geo, nodata, fileSize);
+            }
+         for (level=0; level<numLevels; ++level)
+            {
+            images[level].compression = COMPRESSION_NONE;
+            }
+         level = 0;
+         if (fseek(hFile, sizeof(header), SEEK_SET))
+            {
+            return -1;
+            }
+         err = WriteCompressedTiles(hFile, &images[0], bitsPerSample, 0, &totalBytes);
+         }
+      }
+   if (numLevels > 1 && level > 1)
+      {
+      free((void *) images[level-1].data);
+      }
+
+// Write the image file directories, each followed by the values that don't fit in it
+   ifdPos = ftell(hFile);
+   if (ifdPos < 0)
+      {
+      err = -1;
+      }
+   ifdPos += ifdPos & 1;    // word boundary
+
+   // BigTIFF if classic TIFF's 32-bit offsets can't reach the end of the file
+   endPos = ifdPos;
+   for (level=0; level<numLevels && !err; ++level)
+      {
+      endPos += 2 + 12 * 21 + 4 + 16 + strlen(softwareVersion ? softwareVersion : "") + 2 +
+                GeoTIFFSpace(geo) + 8 * images[level].numTiles + 1;
+      }
+   bigTIFF = (endPos - 1) >> 32 != 0;
+
+   nextPos = 0;
+   for (level=0; level<numLevels && !err; ++level)
+      {
+      long long pos = ftell(hFile);
+
+      pos += pos & 1;
+      if (level > 0)
+         {
+         // link the previous IFD to this one
+         err |= fseek(hFile, (long) nextPos, SEEK_SET);
+         err |= bigTIFF ? Write8Byte(hFile, pos) : WriteLong(hFile, (unsigned int) pos);
+         err |= fseek(hFile, 0, SEEK_END);
+         }
+      err |= WriteTiledIFD(
+         hFile, &images[level], level > 0, bitsPerSample, bigTIFF,
+         softwareVersion, geo, nodata >= 0 ? nodataString : NULL, &nextPos);
+      }
+
+   for (level=0; level<numLevels; ++level)
+      {
+      free(images[level].tileOffsets);
+      free(images[level].tileByteCounts);
+      }
+
+   if (err)
+      {
+      return err;
+      }
+
+   endPos = ftell(hFile);
+   if (endPos < 0)
+      {
+      return -1;
+      }
+
+// Write the header
+   err |= fseek(hFile, 0, SEEK_SET);
+   if (am_big_endian())
+      {
+      err |= WriteWord(hFile, 0x4d4d); // 'MM' is for Motorola (big-endian) number format in the file
+      }
+   else
+      {
+      err |= WriteWord(hFile, 0x4949); // 'II' is for Intel (little-endian) number format in the file
+      }
+   if (bigTIFF)
+      {
+      err |= WriteWord(hFile, 43);
+      err |= WriteWord(hFile, 8);
+      err |= WriteWord(hFile, 0);
+      err |= Write8Byte(hFile, ifdPos);    // Offset of tags
+      }
+   else
+      {
+      err |= WriteWord(hFile, 42);
+      err |= WriteLong(hFile, (unsigned int) ifdPos);  // Offset of tags
+      }
+   err |= fseek(hFile, (long) endPos, SEEK_SET);
+
+   if (fileSize)
+      {
+      *fileSize = (size_t) endPos;
+      }
 
    return err;
    }
+
+
+int WriteGrayscale16BitToTIFF(
+   FILE *hFile, int width, int height, const float *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, size_t *fileSize
+)
+   {
+   return WriteGrayscaleStripTIFF(
+      hFile, width, height, data, 16, softwareVersion, geo, -1, fileSize);
+   }
+
+int WriteGrayscale16BitToBigTIFF(
+   FILE *hFile, int width, int height, const float *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, size_t *fileSize
+)
+   {
+   return WriteGrayscaleStripBigTIFF(
+      hFile, width, height, data, 16, softwareVersion, geo, -1, fileSize);
+   }
+
+int WriteGrayscale16BitToCompressedTIFF(
+   FILE *hFile, int width, int height, const float *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, int overviews, size_t *fileSize
+)
+   {
+   return WriteGrayscaleTiledTIFF(
+      hFile, width, height, data, 16, softwareVersion, geo, -1, overviews, fileSize);
+   }
+
+int WriteGrayscale8BitToTIFF(
+   FILE *hFile, int width, int height, const unsigned char *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, int nodata, size_t *fileSize
+)
+   {
+   return WriteGrayscaleStripTIFF(
+      hFile, width, height, data, 8, softwareVersion, geo, nodata, fileSize);
+   }
+
+int WriteGrayscale8BitToCompressedTIFF(
+   FILE *hFile, int width, int height, const unsigned char *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, int nodata, int overviews, size_t *fileSize
+)
+   {
+   return WriteGrayscaleTiledTIFF(
+      hFile, width, height, data, 8, softwareVersion, geo, nodata, overviews, fileSize);
+   }
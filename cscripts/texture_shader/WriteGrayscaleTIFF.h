@@ -37,13 +37,52 @@
 extern "C" {
 #endif
 
+// Georeferencing recorded in GeoTIFF tags (pixel scale, tiepoint and GeoKey directory)
+typedef struct
+   {
+   double xmin;      // X coordinate of left   edge of image (longitude or easting)
+   double ymax;      // Y coordinate of top    edge of image (latitude  or northing)
+   double xdim;      // pixel width  in X units
+   double ydim;      // pixel height in Y units
+   int geographic;   // nonzero for longitude and latitude in degrees, zero for projected coordinates
+   int epsg;         // EPSG code of the coordinate system (e.g., 4326 or 3395), or 0 if unknown
+   } GeoTIFFInfo;
+
+// all writers record georeferencing in GeoTIFF tags unless geo is NULL
+
 // writes BigTIFF instead if file size would exceed 4 GB
 int WriteGrayscale16BitToTIFF(
-   FILE *hFile, int width, int height, const float *data, const char *softwareVersion, size_t *fileSize
+   FILE *hFile, int width, int height, const float *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, size_t *fileSize
 );  
 
 int WriteGrayscale16BitToBigTIFF(
-   FILE *hFile, int width, int height, const float *data, const char *softwareVersion, size_t *fileSize
+   FILE *hFile, int width, int height, const float *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, size_t *fileSize
+);
+
+// writes 256x256 tiles with LZW compression and horizontal differencing,
+// compressed on the threads of thread_pool.h; BigTIFF if file size would exceed 4 GB;
+// if overviews is nonzero, also writes reduced-resolution images of half the width
+// and height of the last (averaging 2x2 pixels, skipping voids) until one fits in a tile;
+// if compression wouldn't make the full-resolution image smaller, writes it uncompressed
+// instead: as the functions above do, or (with overviews) as uncompressed tiles;
+// returns -1 on write error, -2 on memory allocation error
+int WriteGrayscale16BitToCompressedTIFF(
+   FILE *hFile, int width, int height, const float *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, int overviews, size_t *fileSize
+);
+
+// 8-bit versions of the above, writing pixel values as is (e.g., from terrain_image_bytes());
+// a nodata value of 0 to 255 is recorded in a GDAL_NODATA tag, or none if negative
+int WriteGrayscale8BitToTIFF(
+   FILE *hFile, int width, int height, const unsigned char *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, int nodata, size_t *fileSize
+);
+
+int WriteGrayscale8BitToCompressedTIFF(
+   FILE *hFile, int width, int height, const unsigned char *data, const char *softwareVersion,
+   const GeoTIFFInfo *geo, int nodata, int overviews, size_t *fileSize
 );
 
 #ifdef __cplusplus
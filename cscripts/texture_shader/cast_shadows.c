@@ -0,0 +1,294 @@
+/*
+ * cast_shadows.c
+ *
+ * Created by agent on 2026 Oct 18.
+ * Shadow march moved from shadow.c, by Kyle Bradley, NTU.
+ *
+ * Copyright (c) 2026 agent.
+ * Portions copyright (c) 2011-2013 Leland Brown.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "cast_shadows.h"
+#include "thread_pool.h"
+#include "elevation_pyramid.h"
+
+#include <stdlib.h>
+#include <stddef.h> // for ptrdiff_t
+#include <math.h>
+
+#define LONG ptrdiff_t
+
+// Parameters shared by all rows for ray marching
+typedef struct {
+    const float *data;
+    float       *shadow;
+    int    nrows;
+    int    ncols;
+    double sun_x;
+    double sun_y;
+    double sun_z;
+    float  z_max;           // maximum elevation in data array
+    const Elevation_Pyramid *pyramid;   // block maxima of data, or NULL if not used
+} March_Task;
+
+static double block_steps(
+    double x, double y, double dx, double dy, int level, int bx, int by )
+// Returns the number of steps (dx, dy) from (x, y) to the edge of block (bx, by)
+// at given level of the pyramid, or HUGE_VAL if the ray never reaches it.
+{
+    double t = HUGE_VAL;
+
+    if (dx > 0.0) {
+        t = ((double)((bx + 1) << level) - x) / dx;
+    } else if (dx < 0.0) {
+        t = ((double)(bx << level) - x) / dx;
+    }
+    if (dy > 0.0) {
+        double ty = ((double)((by + 1) << level) - y) / dy;
+        t = ty < t ? ty : t;
+    } else if (dy < 0.0) {
+        double ty = ((double)(by << level) - y) / dy;
+        t = ty < t ? ty : t;
+    }
+
+    return t;
+}
+
+// Thread_Pool_Task marching rays from each pixel of rows begin..end-1
+static void march_rows_task( void *state, long begin, long end )
+{
+    const March_Task *task = (const March_Task *)state;
+
+    const float *data  = task->data;
+    int          nrows = task->nrows;
+    int          ncols = task->ncols;
+    double       sun_x = task->sun_x;
+    double       sun_y = task->sun_y;
+    double       sun_z = task->sun_z;
+    float        z_max = task->z_max;
+
+    const Elevation_Pyramid *pyramid = task->pyramid;
+
+    const float *ptr;
+    float *ptr2;
+
+    long i;
+    int  j;
+
+    for (i=begin; i<end; i++) {
+        ptr  = data         + (LONG)i * (LONG)ncols;
+        ptr2 = task->shadow + (LONG)i * (LONG)ncols;
+        for (j=0; j<ncols; j++) {
+            double x    = j;
+            double y    = i;
+            double zval = ptr[j];
+            int    lit  = 0;
+            int    x_int = (int)x;
+            int    y_int = (int)y;
+
+            // Steps are accumulated one at a time (rather than computed from the
+            // start of the ray), so results match the original march exactly.
+
+            while (x_int > 0 && x_int < ncols && y_int > 0 && y_int < nrows && zval <= z_max) {
+                const float *ptr3 = data + (LONG)y_int * (LONG)ncols;
+                if (zval < ptr3[x_int]) {
+                    lit = lit + (ptr3[x_int] - zval);   // Sum the height above the sun line
+                } else if (pyramid && PYRAMID_MAX( pyramid, 1, y_int, x_int ) <= zval) {
+                    // The ray (which only rises) stays above the largest block here
+                    // whose maximum is below it, so nothing in that block adds to
+                    // the sum: take the steps through it without sampling.
+                    int    level = 1;
+                    int    bx, by;
+                    double steps;
+                    long   n;
+                    while (level < pyramid->nlevels &&
+                           PYRAMID_MAX( pyramid, level+1, y_int, x_int ) <= zval)
+                    {
+                        ++level;
+                    }
+                    bx = x_int >> level;
+                    by = y_int >> level;
+                    steps = block_steps( x, y, sun_x, sun_y, level, bx, by );
+                    if (sun_z > 0.0 && (z_max - zval) / sun_z + 1.0 < steps - 1.0) {
+                        break;  // ray rises above z_max (ending the march) in this block
+                    }
+                    // Steps certainly inside the block are accumulated without checks,
+                    // then the rest one at a time - exactly as the march would.
+                    for (n = steps < 1.0e9 ? (long)steps - 1 : 1000000000L; n > 0; --n) {
+                        x = x + sun_x;
+                        y = y + sun_y;
+                        zval = zval + sun_z;
+                    }
+                    x_int = (int)x;
+                    y_int = (int)y;
+                    while ((x_int >> level) == bx && (y_int >> level) == by && zval <= z_max) {
+                        x = x + sun_x;
+                        y = y + sun_y;
+                        zval = zval + sun_z;
+                        x_int = (int)x;
+                        y_int = (int)y;
+                    }
+                    continue;
+                }
+                x = x + sun_x;
+                y = y + sun_y;
+                zval = zval + sun_z;
+                x_int = (int)x;
+                y_int = (int)y;
+            }
+            if (lit == 0) {
+                ptr2[j] = 0;
+            } else {
+                ptr2[j] = log( lit );   // Use the natural logarithm of the total shading volume
+            }
+        }
+    }
+}
+
+static float max_elevation( const float *data, int nrows, int ncols )
+{
+    const float *ptr;
+
+    float z_max = -999999;
+
+    int i, j;
+
+    for (i=0; i<nrows; ++i) {
+        ptr = data + (LONG)i * (LONG)ncols;
+        for (j=0; j<ncols; ++j) {
+            if (ptr[j] > z_max) {
+                z_max = ptr[j];
+            }
+        }
+    }
+
+    return z_max;
+}
+
+static long setup_march(
+    March_Task *task, const float *data, float *shadow, int nrows, int ncols,
+    double sun_x, double sun_y, double sun_z, float z_max, const Elevation_Pyramid *pyramid )
+// Fills in *task for one sun direction. Returns the number of rows to process.
+{
+    task->data   = data;
+    task->shadow = shadow;
+    task->nrows  = nrows;
+    task->ncols  = ncols;
+    task->sun_x  = sun_x;
+    task->sun_y  = sun_y;
+    task->sun_z  = sun_z;
+    task->z_max  = z_max;   // maximum value limits shadow search
+
+    // blocks can only be skipped if the ray never descends
+    task->pyramid = sun_z >= 0.0 && pyramid->nlevels > 0 ? pyramid : NULL;
+
+    return nrows;
+}
+
+// Per-sun tasks run together as a single parallel loop
+typedef struct {
+    int         nsuns;
+    const long *first;      // first row of each sun; first[nsuns] = total
+    March_Task *march;      // parameters for each sun
+} Batch_Task;
+
+// Thread_Pool_Task running iterations begin..end-1 of the combined loop
+static void batch_task( void *state, long begin, long end )
+{
+    const Batch_Task *batch = (const Batch_Task *)state;
+
+    int s;
+
+    for (s=0; s<batch->nsuns; ++s) {
+        long lo = begin > batch->first[s]   ? begin : batch->first[s];
+        long hi = end   < batch->first[s+1] ? end   : batch->first[s+1];
+        if (lo < hi) {
+            march_rows_task( &batch->march[s], lo - batch->first[s], hi - batch->first[s] );
+        }
+    }
+}
+
+int cast_shadows_batch(
+    const float *data, float *const *shadows, int nrows, int ncols,
+    const struct Shadow_Sun *suns, int nsuns )
+{
+    Batch_Task batch;
+    Elevation_Pyramid pyramid;
+
+    long *first = (long *)malloc( (nsuns + 1) * sizeof( long ) );
+
+    float z_max;
+
+    int s;
+
+    batch.nsuns = nsuns;
+    batch.first = first;
+    batch.march = (March_Task *)malloc( nsuns * sizeof( March_Task ) );
+
+    if (!first || !batch.march ||
+        build_elevation_pyramid( &pyramid, data, nrows, ncols, 0 ))
+    {
+        free( first );
+        free( batch.march );
+        return SHADOW_MALLOC_ERROR;
+    }
+
+    z_max = max_elevation( data, nrows, ncols );    // shared by all suns
+
+    first[0] = 0;
+    for (s=0; s<nsuns; ++s) {
+        first[s+1] = first[s] + setup_march( &batch.march[s], data, shadows[s],
+            nrows, ncols, suns[s].x, suns[s].y, suns[s].z, z_max, &pyramid );
+    }
+
+    // CONCURRENCY NOTE: Each row of marched rays reads only the data array and
+    // writes only its own pixels of its own sun's shadow array, so rows of all
+    // suns are processed in parallel, with results independent of the thread
+    // count.
+
+    thread_pool_run( first[nsuns], 1, batch_task, &batch );
+
+    free_elevation_pyramid( &pyramid );
+    free( first );
+    free( batch.march );
+
+    return SHADOW_SUCCESS;
+}
+
+int cast_shadows(
+    const float *data, float *shadow, int nrows, int ncols,
+    double sun_x, double sun_y, double sun_z )
+{
+    struct Shadow_Sun sun;
+
+    sun.x = sun_x;
+    sun.y = sun_y;
+    sun.z = sun_z;
+
+    return cast_shadows_batch( data, &shadow, nrows, ncols, &sun, 1 );
+}
@@ -0,0 +1,88 @@
+/*
+ * cast_shadows.h
+ *
+ * Created by agent on 2026 Oct 18.
+ * Shadow march moved from shadow.c, by Kyle Bradley, NTU.
+ *
+ * Copyright (c) 2026 agent.
+ * Portions copyright (c) 2011-2013 Leland Brown.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CAST_SHADOWS_H
+#define CAST_SHADOWS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum Shadow_Errors {
+    SHADOW_SUCCESS      = 0,
+    SHADOW_MALLOC_ERROR = 1     // memory allocation error occurred
+};
+
+// Computes cast shadows for a sun in the direction (sun_x, sun_y, sun_z).
+// For each pixel, sums the height of the terrain above the ray from that pixel
+// toward the sun, sampled at each step of the ray, and stores the natural log
+// of the total; pixels with less than 1 unit of terrain above their ray are 0.
+// Pixels in the first row and first column are always 0.
+// Runs on the threads of thread_pool.h, with results independent of the thread count.
+// Returns 0 on success, nonzero if an error occurred (see enum Shadow_Errors).
+int cast_shadows(
+    const float *data,  // input:  array of elevations (row-major order)
+    float *shadow,      // output: array of shadow values (row-major order)
+    int    nrows,       // input:  number of rows    in data arrays
+    int    ncols,       // input:  number of columns in data arrays
+    double sun_x,       // input:  ray step toward sun, in columns
+    double sun_y,       // input:  ray step toward sun, in rows
+    double sun_z        // input:  ray rise per step, in elevation units
+);
+
+// Direction toward the sun, as for cast_shadows()
+struct Shadow_Sun {
+    double x;   // ray step toward sun, in columns
+    double y;   // ray step toward sun, in rows
+    double z;   // ray rise per step, in elevation units
+};
+
+// Computes cast shadows (as for cast_shadows()) for several sun directions in
+// one pass, sharing any acceleration structures between them and spreading
+// the work for all suns across the threads of thread_pool.h.
+// Returns 0 on success, nonzero if an error occurred (see enum Shadow_Errors).
+int cast_shadows_batch(
+    const float *data,  // input:  array of elevations (row-major order)
+    float *const
+          *shadows,     // output: array of shadow values for each sun
+    int    nrows,       // input:  number of rows    in data arrays
+    int    ncols,       // input:  number of columns in data arrays
+    const struct Shadow_Sun
+          *suns,        // input:  direction toward each sun
+    int    nsuns        // input:  number of suns
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
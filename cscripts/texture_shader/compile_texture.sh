@@ -4,17 +4,18 @@
 TEXTURE_DIR="${1}"
 CCOMPILER="${2}"
 
-CFLAGS="-O2 -funroll-loops -lm"
+CFLAGS="-O2 -funroll-loops"
+LIBS="-lm -lpthread"
 
 cd "${TEXTURE_DIR}"
 
 rm -f texture texture_image shadow svf
 
-${CCOMPILER} -DNOMAIN -c *.c
-${CCOMPILER} ${CFLAGS} *.o texture.c -o texture
-${CCOMPILER} ${CFLAGS} *.o shadow.c -o shadow
-${CCOMPILER} ${CFLAGS} *.o svf.c -o svf
-${CCOMPILER} ${CFLAGS} *.o texture_image.c -o texture_image
+${CCOMPILER} ${CFLAGS} -DNOMAIN -c *.c
+${CCOMPILER} ${CFLAGS} *.o texture.c -o texture ${LIBS}
+${CCOMPILER} ${CFLAGS} *.o shadow.c -o shadow ${LIBS}
+${CCOMPILER} ${CFLAGS} *.o svf.c -o svf ${LIBS}
+${CCOMPILER} ${CFLAGS} *.o texture_image.c -o texture_image ${LIBS}
 
 # Cleanup
 rm -f *.o
@@ -42,16 +42,36 @@
 extern "C" {
 #endif
 
+// Maximum number of DCTs an implementation may perform per call to perform_dcts()
+// (dct_fftpack.c performs up to two groups of FFTPACK_BATCH, which may be 8)
+#define DCT_MAX_DATA 16
+
 struct Dct_Plan {
     // This structure must be filled in by calling setup_dcts() and should
     // not be modified by the caller.
     // Do NOT free these pointers - use cleanup_dcts() instead.
     // Note: input and output buffers may be the same.
-    void   * dct_buffer;    // internal buffer for use by perform_dcts()
-    double * in_data[2];    // input  data buffers for perform_dcts()
-    double * out_data[2];   // output data buffers for perform_dcts()
+    // Element j of buffer k is in_data[k][j*stride] (likewise for out_data).
+    void   * dct_buffer;                // internal buffer for use by perform_dcts()
+    int      ndata;                     // number of DCTs done by perform_dcts() (2 or more)
+    int      stride;                    // spacing between elements of each data buffer
+    double * in_data [DCT_MAX_DATA];    // input  data buffers for perform_dcts()
+    double * out_data[DCT_MAX_DATA];    // output data buffers for perform_dcts()
 };
 
+// Algorithms for select_dct_algorithm(). An implementation need not provide
+// all of these, but DCT_ALGORITHM_DEFAULT is always available.
+#define DCT_ALGORITHM_DEFAULT       0   // implementation's preferred algorithm
+#define DCT_ALGORITHM_QUARTER_WAVE  1   // quarter-wave cosine transforms
+#define DCT_ALGORITHM_MAKHOUL       2   // real FFT of even/odd-reordered data
+
+// Selects the algorithm used by subsequent calls to setup_dcts().
+// Returns zero if successful, or nonzero if the algorithm is not available.
+// Plans already set up are not affected.
+int select_dct_algorithm(
+    int algorithm   // DCT_ALGORITHM_xxx
+);
+
 // Specifies a DCT operation to be performed one or more times and
 // allocates buffers to be used by perform_dcts().
 // On return, plan->dct_buffer will be null if a memory allocation error occurred.
@@ -60,11 +80,11 @@ struct Dct_Plan setup_dcts(
     int nelems      // data length for each DCT
 );
 
-// Performs two DCTs, each of size nelems (see setup_dcts()).
+// Performs plan->ndata DCTs, each of size nelems (see setup_dcts()).
 // Input arrays are plan->in_data[.] and output arrays are plan->out_data[.].
 // Note: input buffers may be overwritten, even if output buffers are different.
-// Values in both data buffers must have similar magnitude to avoid roundoff error;
-// for a single DCT, fill both buffers with the same values, or one with zeroes.
+// Values in all data buffers must have similar magnitude to avoid roundoff error;
+// to perform fewer DCTs, fill the unused buffers with copies of a used one.
 void perform_dcts(
     const struct Dct_Plan *plan // from setup_dcts()
 );
@@ -0,0 +1,237 @@
+/*
+ * dct_benchmark.c
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Compares the speed and accuracy of the DCT algorithms available through
+// dct.h, over a range of transform lengths typical of DEM dimensions.
+//
+// Build (from this directory):
+//   cc -O2 -funroll-loops -o dct_benchmark
+//      dct_benchmark.c dct_fftpack.c fftpack.c fftpack_batch.c -lm
+//
+// Usage: dct_benchmark [length ...]
+//
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "dct.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+// minimum timing interval per measurement, in seconds
+static const double min_seconds = 0.25;
+
+static const int default_lengths[] = {
+    256, 360, 500, 512, 600, 1000, 1024, 1201, 1800, 2000,
+    2048, 3000, 3601, 4096, 5000, 6000, 8192, 10800,
+    1009, 2003, 4001    // primes use Bluestein's algorithm in dct_fftpack.c
+};
+
+static const struct {
+    int         algorithm;
+    const char *name;
+} algorithms[] = {
+    { DCT_ALGORITHM_QUARTER_WAVE, "quarter-wave" },
+    { DCT_ALGORITHM_MAKHOUL,      "Makhoul"      }
+};
+
+static const int num_algorithms = sizeof( algorithms ) / sizeof( algorithms[0] );
+
+static void fill_plan(
+    const struct Dct_Plan *plan,
+    const double *values,
+    int   nelems
+)
+{
+    int j, k;
+
+    for (k=0; k<plan->ndata; ++k) {
+        for (j=0; j<nelems; ++j) {
+            plan->in_data[k][j*plan->stride] = values[j + k*nelems];
+        }
+    }
+}
+
+// Returns average time in nanoseconds per transform of the given length,
+// or a negative value on error. Also returns the maximum relative error
+// of a DCT-II followed by DCT-III, compared to the original data.
+static double benchmark(
+    int     nelems,
+    double *values,     // DCT_MAX_DATA * nelems random values
+    double *roundtrip_error
+)
+{
+    struct Dct_Plan fwd_plan = setup_dcts( 2, nelems );
+    struct Dct_Plan bwd_plan = setup_dcts( 3, nelems );
+
+    double scale = 1.0 / (4.0 * nelems);
+    double max_err = 0.0;
+    double seconds;
+    long   reps, r;
+    clock_t start;
+    int j, k;
+
+    if (!fwd_plan.dct_buffer || !bwd_plan.dct_buffer) {
+        return -1.0;
+    }
+
+    // accuracy: forward and inverse transforms multiply data by 4*nelems
+    fill_plan( &fwd_plan, values, nelems );
+    perform_dcts( &fwd_plan );
+    for (k=0; k<fwd_plan.ndata; ++k) {
+        for (j=0; j<nelems; ++j) {
+            bwd_plan.in_data[k][j*bwd_plan.stride] = fwd_plan.out_data[k][j*fwd_plan.stride];
+        }
+    }
+    perform_dcts( &bwd_plan );
+    for (k=0; k<bwd_plan.ndata; ++k) {
+        for (j=0; j<nelems; ++j) {
+            double err = fabs( bwd_plan.out_data[k][j*bwd_plan.stride] * scale - values[j + k*nelems] );
+            if (err > max_err) {
+                max_err = err;
+            }
+        }
+    }
+    *roundtrip_error = max_err;
+
+    // speed: time forward and inverse transforms, refilling data each pass
+    // so that values stay bounded
+    reps = 1;
+    for (;;) {
+        start = clock();
+        for (r=0; r<reps; ++r) {
+            fill_plan( &fwd_plan, values, nelems );
+            perform_dcts( &fwd_plan );
+            fill_plan( &bwd_plan, values, nelems );
+            perform_dcts( &bwd_plan );
+        }
+        seconds = (double)( clock() - start ) / CLOCKS_PER_SEC;
+        if (seconds >= min_seconds) {
+            break;
+        }
+        reps *= 2;
+    }
+
+    seconds /= (double)reps * (double)( fwd_plan.ndata + bwd_plan.ndata );
+
+    cleanup_dcts( &bwd_plan );
+    cleanup_dcts( &fwd_plan );
+
+    return seconds * 1.0e9;
+}
+
+#ifndef NOMAIN
+
+int main( int argc, const char *argv[] )
+{
+    int num_lengths;
+    int *lengths;
+    double *values;
+    int i, j, a;
+
+    if (argc > 1) {
+        num_lengths = argc - 1;
+        lengths = (int *)malloc( num_lengths * sizeof( int ) );
+        if (!lengths) {
+            fprintf( stderr, "*** ERROR: Not enough memory.\n" );
+            exit( EXIT_FAILURE );
+        }
+        for (i=0; i<num_lengths; ++i) {
+            char *endptr;
+            lengths[i] = (int)strtol( argv[i+1], &endptr, 10 );
+            if (endptr == argv[i+1] || *endptr != '\0' || lengths[i] < 1) {
+                fprintf( stderr, "*** ERROR: Invalid length '%s'.\n", argv[i+1] );
+                exit( EXIT_FAILURE );
+            }
+        }
+    } else {
+        num_lengths = sizeof( default_lengths ) / sizeof( default_lengths[0] );
+        lengths = (int *)default_lengths;
+    }
+
+    printf( "%8s", "length" );
+    for (a=0; a<num_algorithms; ++a) {
+        printf( "  %14s ns/DCT  max error", algorithms[a].name );
+    }
+    printf( "  speedup\n" );
+
+    for (i=0; i<num_lengths; ++i) {
+        int n = lengths[i];
+        double ns[2];
+
+        values = (double *)malloc( DCT_MAX_DATA * n * sizeof( double ) );
+        if (!values) {
+            fprintf( stderr, "*** ERROR: Not enough memory.\n" );
+            exit( EXIT_FAILURE );
+        }
+        srand( n );
+        for (j=0; j<DCT_MAX_DATA*n; ++j) {
+            values[j] = (double)rand() / RAND_MAX - 0.5;
+        }
+
+        printf( "%8d", n );
+        for (a=0; a<num_algorithms; ++a) {
+            double err = 0.0;
+
+            if (select_dct_algorithm( algorithms[a].algorithm )) {
+                printf( "  %21s %10s", "n/a", "" );
+                ns[a] = -1.0;
+                continue;
+            }
+            ns[a] = benchmark( n, values, &err );
+            if (ns[a] < 0.0) {
+                fprintf( stderr, "\n*** ERROR: Not enough memory.\n" );
+                exit( EXIT_FAILURE );
+            }
+            printf( "  %21.1f %10.2e", ns[a], err );
+        }
+        if (ns[0] > 0.0 && ns[1] > 0.0) {
+            printf( "  %7.2f", ns[0] / ns[1] );
+        }
+        printf( "\n" );
+        fflush( stdout );
+
+        free( values );
+    }
+
+    select_dct_algorithm( DCT_ALGORITHM_DEFAULT );
+
+    if (lengths != default_lengths) {
+        free( lengths );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
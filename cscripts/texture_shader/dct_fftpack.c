@@ -48,15 +48,127 @@
 
 static const int max_factors = 30;
 
+// setup_dcts() uses up to two groups of FFTPACK_BATCH transforms (for Bluestein)
+#if 2*FFTPACK_BATCH > DCT_MAX_DATA
+#   error "2*FFTPACK_BATCH must not exceed DCT_MAX_DATA"
+#endif
+
+// Algorithm used by setup_dcts() when DCT_ALGORITHM_DEFAULT is selected;
+// may be overridden at build time, e.g. -DDCT_DEFAULT_ALGORITHM=1 (quarter-wave).
+// Makhoul's algorithm skips the pre- and post-processing passes of cosqf()/cosqb()
+// and measures 0-19% faster in dct_benchmark.c for typical DEM sizes.
+#ifndef DCT_DEFAULT_ALGORITHM
+#   define DCT_DEFAULT_ALGORITHM DCT_ALGORITHM_MAKHOUL
+#endif
+
+static int selected_algorithm = DCT_ALGORITHM_DEFAULT;
+
 struct Dct_Buffer{
     int     dct_type;   // 1 to 3 (DCT types I to III)
+    int     algorithm;  // DCT_ALGORITHM_QUARTER_WAVE or DCT_ALGORITHM_MAKHOUL
     int     nelems;     // length of inout_data0 and inout_data1 buffers
+    int     ngroups;    // number of FFTPACK_BATCH-wide groups in inout_batch
     double *inout_data0;// input/output buffer space
     double *inout_data1;// input/output buffer space
     double *wsave;      // workspace buffer
     int    *ifac;       // info on factorization of nelems
+    FFTPACK_VREAL
+           *inout_batch;// interleaved input/output buffer space for batched DCTs,
+                        // or NULL to perform two DCTs per call
+    FFTPACK_VREAL
+           *work_batch; // workspace buffer for batched DCTs
 };
 
+int select_dct_algorithm(
+    int algorithm   // DCT_ALGORITHM_xxx
+)
+// Selects the algorithm used by subsequent calls to setup_dcts().
+// Returns zero if successful, or nonzero if the algorithm is not available.
+{
+    switch (algorithm) {
+        case DCT_ALGORITHM_DEFAULT:
+        case DCT_ALGORITHM_QUARTER_WAVE:
+        case DCT_ALGORITHM_MAKHOUL:
+            selected_algorithm = algorithm;
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// DCT-II by Makhoul's algorithm: reorder even and odd elements into v,
+// take a real FFT of length n, and rotate each frequency by a quarter-sample.
+// Scaled by 4 to match cosqb(). w[k] = cos(k*pi/(2*n)) from cosqi(), so
+// sin(k*pi/(2*n)) = w[n-k]; wr and ifac are the rffti() data from cosqi().
+static void makhoul_dct2(
+    int n, FFTPACK_VREAL *x, FFTPACK_VREAL *v,
+    double *w, double *wr, int *ifac )
+{
+    int i;
+    int nh = (n + 1) >> 1;
+
+    if (n < 2) {
+        x[0] *= 4.0;
+        return;
+    }
+
+    for (i=0; i<nh; ++i) {
+        v[i] = x[2*i];
+    }
+    for (i=0; 2*i+1<n; ++i) {
+        v[n-1-i] = x[2*i+1];
+    }
+
+    rfftf_batch( n, v, x, wr, ifac );
+
+    x[0] = 4.0 * v[0];
+    for (i=1; i<nh; ++i) {
+        double c = 4.0 * w[i];
+        double s = 4.0 * w[n-i];
+        FFTPACK_VREAL re = v[2*i-1];
+        FFTPACK_VREAL im = v[2*i];
+        x[i]   = c * re + s * im;
+        x[n-i] = s * re - c * im;
+    }
+    if (!(n & 1)) {
+        x[n/2] = (4.0 * w[n/2]) * v[n-1];
+    }
+}
+
+// DCT-III by Makhoul's algorithm: the inverse of makhoul_dct2() steps,
+// scaled to match cosqf().
+static void makhoul_dct3(
+    int n, FFTPACK_VREAL *x, FFTPACK_VREAL *v,
+    double *w, double *wr, int *ifac )
+{
+    int i;
+    int nh = (n + 1) >> 1;
+
+    if (n < 2) {
+        return;
+    }
+
+    v[0] = x[0];
+    for (i=1; i<nh; ++i) {
+        double c = w[i];
+        double s = w[n-i];
+        v[2*i-1] = c * x[i] + s * x[n-i];
+        v[2*i]   = s * x[i] - c * x[n-i];
+    }
+    if (!(n & 1)) {
+        v[n-1] = (2.0 * w[n/2]) * x[n/2];
+    }
+
+    rfftb_batch( n, v, x, wr, ifac );
+
+    for (i=0; i<nh; ++i) {
+        x[2*i] = v[i];
+    }
+    for (i=0; 2*i+1<n; ++i) {
+        x[2*i+1] = v[n-1-i];
+    }
+}
+
 struct Dct_Plan setup_dcts(
     int dct_type,   // 1, 2, or 3 (DCT types I, II, III)
     int nelems      // data length for each DCT
@@ -65,17 +177,20 @@ struct Dct_Plan setup_dcts(
 // allocates buffers to be used by perform_dcts().
 // On return, plan->dct_buffer will be null if a memory allocation error occurred.
 {
-    const int max_ifac = (int)( 1.8 * max_factors + 6.9 );
+    const int max_ifac = 2 * max_factors + 7;  // see notes on cosqi() in fftpack.h
     
     struct Dct_Plan plan;
     struct Dct_Buffer *buf;
     double *data;
+    int k, m;
 
-    plan.dct_buffer  = NULL;
-    plan.in_data[0]  = NULL;
-    plan.in_data[1]  = NULL;
-    plan.out_data[0] = NULL;
-    plan.out_data[1] = NULL;
+    plan.dct_buffer = NULL;
+    plan.ndata      = 0;
+    plan.stride     = 1;
+    for (k=0; k<DCT_MAX_DATA; ++k) {
+        plan.in_data[k]  = NULL;
+        plan.out_data[k] = NULL;
+    }
     
     buf = (struct Dct_Buffer *)malloc( sizeof( struct Dct_Buffer ) );
     if (!buf) {
@@ -111,25 +226,122 @@ struct Dct_Plan setup_dcts(
     
     assert( buf->ifac[1] <= max_factors );
 
-    plan.dct_buffer  = (void *)buf;
-    plan.in_data[0]  = buf->inout_data0;
-    plan.in_data[1]  = buf->inout_data1;
-    plan.out_data[0] = buf->inout_data0; // in-place transforms
-    plan.out_data[1] = buf->inout_data1; // in-place transforms
+    buf->algorithm = selected_algorithm;
+    if (buf->algorithm == DCT_ALGORITHM_DEFAULT) {
+        buf->algorithm = DCT_DEFAULT_ALGORITHM;
+    }
+
+    // Length of the convolution used by Bluestein's algorithm, or 0 if not used
+    m = buf->ifac[ buf->ifac[1] + 2 ];
+
+    // If cosqi() chose Bluestein's algorithm, the real FFT of length nelems
+    // would be slow, so use the quarter-wave transforms in cosqf2()/cosqb2(),
+    // which apply it to two groups of transforms at once.
+    if (m != 0) {
+        buf->algorithm = DCT_ALGORITHM_QUARTER_WAVE;
+        buf->ngroups   = FFTPACK_BATCH >= 2 ? 2 : 0;
+    } else if (buf->algorithm == DCT_ALGORITHM_MAKHOUL) {
+        buf->ngroups   = FFTPACK_BATCH >= 2 ? 1 : 2;
+    } else {
+        // Batch FFTPACK_BATCH transforms together if possible
+        buf->ngroups   = FFTPACK_BATCH >= 2 ? 1 : 0;
+    }
+
+    buf->inout_batch = NULL;
+    buf->work_batch  = NULL;
+
+    if (buf->ngroups) {
+        int nwork = 3 * m > nelems ? 3 * m : nelems;
+        buf->inout_batch = (FFTPACK_VREAL *)malloc
+            ( (buf->ngroups * nelems + nwork) * sizeof( FFTPACK_VREAL ) );
+        if (!buf->inout_batch) {
+            free( data );
+            free( buf );
+            return plan;
+        }
+        buf->work_batch = buf->inout_batch + buf->ngroups * nelems;
+    }
+
+    plan.dct_buffer = (void *)buf;
+    if (buf->inout_batch) {
+        plan.ndata  = buf->ngroups * FFTPACK_BATCH;
+        plan.stride = FFTPACK_BATCH;
+        for (k=0; k<plan.ndata; ++k) {
+            double *group = (double *)( buf->inout_batch + (k / FFTPACK_BATCH) * nelems );
+            plan.in_data[k]  = group + k % FFTPACK_BATCH;
+            plan.out_data[k] = group + k % FFTPACK_BATCH;   // in-place transforms
+        }
+    } else {
+        plan.ndata  = 2;
+        plan.stride = 1;
+        plan.in_data[0]  = buf->inout_data0;
+        plan.in_data[1]  = buf->inout_data1;
+        plan.out_data[0] = buf->inout_data0; // in-place transforms
+        plan.out_data[1] = buf->inout_data1; // in-place transforms
+    }
     return plan;
 }
 
 void perform_dcts(
     const struct Dct_Plan *plan // from setup_dcts()
 )
-// Performs two DCTs, each of size nelems (see setup_dcts()).
+// Performs plan->ndata DCTs, each of size nelems (see setup_dcts()).
 // Input arrays are plan->in_data[.] and output arrays are plan->out_data[.].
 // Note: input buffers may be overwritten, even if output buffers are different.
-// Values in both data buffers must have similar magnitude to avoid roundoff error;
-// for a single DCT, fill both buffers with the same values, or one with zeroes.
+// Values in all data buffers must have similar magnitude to avoid roundoff error;
+// to perform fewer DCTs, fill the unused buffers with copies of a used one.
 {
     struct Dct_Buffer *buf = (struct Dct_Buffer *)(plan->dct_buffer);
 
+    if (buf->inout_batch) {
+        int n = buf->nelems;
+        int g;
+
+        // verify that caller has not altered these pointers
+        assert( plan->in_data[0]  == (double *)buf->inout_batch );
+        assert( plan->out_data[0] == (double *)buf->inout_batch );  // in-place transform
+
+        if (buf->ifac[ buf->ifac[1] + 2 ] != 0) {
+            // Bluestein's algorithm - both groups at once
+            FFTPACK_VREAL *x1 = buf->inout_batch;
+            FFTPACK_VREAL *x2 = buf->inout_batch + n;
+
+            switch (buf->dct_type) {
+                case 2:
+                    cosqb2_batch( n, x1, x2, buf->work_batch, buf->wsave, buf->ifac );
+                    break;
+                case 3:
+                    cosqf2_batch( n, x1, x2, buf->work_batch, buf->wsave, buf->ifac );
+                    break;
+                default:
+                    assert( 0 );    // illegal or unsupported dct_type
+            }
+            return;
+        }
+
+        for (g=0; g<buf->ngroups; ++g) {
+            FFTPACK_VREAL *x = buf->inout_batch + g * n;
+
+            switch (buf->algorithm * 4 + buf->dct_type) {
+                case DCT_ALGORITHM_QUARTER_WAVE * 4 + 2:
+                    cosqb_batch( n, x, buf->work_batch, buf->wsave, buf->ifac );
+                    break;
+                case DCT_ALGORITHM_QUARTER_WAVE * 4 + 3:
+                    cosqf_batch( n, x, buf->work_batch, buf->wsave, buf->ifac );
+                    break;
+                case DCT_ALGORITHM_MAKHOUL * 4 + 2:
+                    makhoul_dct2( n, x, buf->work_batch, buf->wsave, buf->wsave + n, buf->ifac );
+                    break;
+                case DCT_ALGORITHM_MAKHOUL * 4 + 3:
+                    makhoul_dct3( n, x, buf->work_batch, buf->wsave, buf->wsave + n, buf->ifac );
+                    break;
+                default:
+                    assert( 0 );    // illegal or unsupported dct_type
+            }
+        }
+        return;
+    }
+
     // verify that caller has not altered these pointers
     assert( plan->in_data[0]  == buf->inout_data0 );
     assert( plan->in_data[1]  == buf->inout_data1 );
@@ -162,19 +374,27 @@ void cleanup_dcts(
 // Frees memory allocated by setup_dcts().
 {
     struct Dct_Buffer *buf = (struct Dct_Buffer *)(plan->dct_buffer);
+    int k;
     
     // verify that caller has not altered these pointers
-    assert( plan->in_data[0]  == buf->inout_data0 );
-    assert( plan->in_data[1]  == buf->inout_data1 );
-    assert( plan->out_data[0] == buf->inout_data0 );
-    assert( plan->out_data[1] == buf->inout_data1 );
+    if (buf->inout_batch) {
+        assert( plan->in_data[0]  == (double *)buf->inout_batch );
+        assert( plan->out_data[0] == (double *)buf->inout_batch );
+    } else {
+        assert( plan->in_data[0]  == buf->inout_data0 );
+        assert( plan->in_data[1]  == buf->inout_data1 );
+        assert( plan->out_data[0] == buf->inout_data0 );
+        assert( plan->out_data[1] == buf->inout_data1 );
+    }
     
+    free( buf->inout_batch );
     free( buf->inout_data0 );
     free( buf );
     
-    plan->in_data[0]  = NULL;
-    plan->in_data[1]  = NULL;
-    plan->out_data[1] = NULL;
-    plan->out_data[0] = NULL;
-    plan->dct_buffer  = NULL;
+    for (k=0; k<DCT_MAX_DATA; ++k) {
+        plan->in_data[k]  = NULL;
+        plan->out_data[k] = NULL;
+    }
+    plan->ndata      = 0;
+    plan->dct_buffer = NULL;
 }
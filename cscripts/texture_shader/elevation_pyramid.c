@@ -0,0 +1,193 @@
+/*
+ * elevation_pyramid.c
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "elevation_pyramid.h"
+#include "thread_pool.h"
+
+#include "compatibility.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // for ptrdiff_t
+#include <math.h>
+
+#define LONG ptrdiff_t
+
+typedef struct {
+    const float *from;  // previous level
+    float       *to;    // level being built
+    int  fromrows;
+    int  fromcols;
+    int  tocols;
+    int  is_min;        // nonzero for minima, zero for maxima
+} Reduce_Task;
+
+// Thread_Pool_Task computing rows begin..end-1 of one level from the level below
+static void reduce_rows_task( void *state, long begin, long end )
+{
+    const Reduce_Task *task = (const Reduce_Task *)state;
+
+    long i;
+    int  j;
+
+    for (i=begin; i<end; ++i) {
+        const float *row0 = task->from + (LONG)(2*i) * (LONG)task->fromcols;
+        const float *row1 = 2*i+1 < task->fromrows ? row0 + task->fromcols : row0;
+        float       *to   = task->to + (LONG)i * (LONG)task->tocols;
+        for (j=0; j<task->tocols; ++j) {
+            int   j1 = 2*j+1 < task->fromcols ? 2*j+1 : 2*j;
+            float a  = row0[2*j], b = row0[j1], c = row1[2*j], d = row1[j1];
+            if (task->is_min) {
+                float ab = a < b ? a : b;
+                float cd = c < d ? c : d;
+                to[j] = ab < cd ? ab : cd;
+            } else {
+                float ab = a > b ? a : b;
+                float cd = c > d ? c : d;
+                to[j] = ab > cd ? ab : cd;
+            }
+        }
+    }
+}
+
+void free_elevation_pyramid( Elevation_Pyramid *pyramid )
+{
+    int level;
+
+    for (level=1; level<=pyramid->nlevels; ++level) {
+        free( (float *)pyramid->max[level] );
+        free( (float *)pyramid->min[level] );
+        pyramid->max[level] = NULL;
+        pyramid->min[level] = NULL;
+    }
+    pyramid->nlevels = 0;
+}
+
+int build_elevation_pyramid(
+    Elevation_Pyramid *pyramid, const float *data, int nrows, int ncols, int with_min )
+{
+    int level;
+    int rows = nrows;
+    int cols = ncols;
+
+    memset( pyramid, 0, sizeof( *pyramid ) );
+
+    pyramid->ncols[0] = ncols;
+    pyramid->max[0]   = data;
+    pyramid->min[0]   = with_min ? data : NULL;
+
+    for (level=1; (rows > 1 || cols > 1) && level<=PYRAMID_MAX_LEVELS; ++level) {
+        int  newrows = (rows + 1) / 2;
+        int  newcols = (cols + 1) / 2;
+        int  pass;
+
+        for (pass=0; pass<(with_min ? 2 : 1); ++pass) {
+            Reduce_Task task;
+            float *to = (float *)malloc( (LONG)newrows * (LONG)newcols * sizeof( float ) );
+
+            if (!to) {
+                free_elevation_pyramid( pyramid );
+                return 1;
+            }
+            if (pass == 0) {
+                pyramid->max[level] = to;
+            } else {
+                pyramid->min[level] = to;
+            }
+            pyramid->nlevels = level;   // so free_elevation_pyramid() will find it
+
+            task.from     = pass == 0 ? pyramid->max[level-1] : pyramid->min[level-1];
+            task.to       = to;
+            task.fromrows = rows;
+            task.fromcols = cols;
+            task.tocols   = newcols;
+            task.is_min   = pass;
+            thread_pool_run( newrows, 64, reduce_rows_task, &task );
+        }
+
+        pyramid->ncols[level] = newcols;
+        rows = newrows;
+        cols = newcols;
+    }
+
+    return 0;
+}
+
+// Returns nonzero if step k of the ray from (x0, y0) is in block (bx, by) at given level
+static INLINE int ray_in_block(
+    double x0, double y0, double dx, double dy, long k, int level, int bx, int by )
+{
+    int x_int = (int)(x0 + (double)k * dx);
+    int y_int = (int)(y0 + (double)k * dy);
+    return x_int >= 0 && y_int >= 0 && (x_int >> level) == bx && (y_int >> level) == by;
+}
+
+long pyramid_ray_exit(
+    double x0, double y0, double dx, double dy, long k, long kmax,
+    int level, int x_int, int y_int )
+{
+    int    bx = x_int >> level;
+    int    by = y_int >> level;
+    double t  = (double)kmax;
+    long   exit;
+
+    // estimate from where the ray crosses the block edges, then adjust
+    // for rounding so the result matches marching one step at a time
+
+    if (dx > 0.0) {
+        double tx = ((double)((bx + 1) << level) - x0) / dx;
+        t = tx < t ? tx : t;
+    } else if (dx < 0.0) {
+        double tx = ((double)(bx << level) - x0) / dx;
+        t = tx < t ? tx : t;
+    }
+    if (dy > 0.0) {
+        double ty = ((double)((by + 1) << level) - y0) / dy;
+        t = ty < t ? ty : t;
+    } else if (dy < 0.0) {
+        double ty = ((double)(by << level) - y0) / dy;
+        t = ty < t ? ty : t;
+    }
+
+    exit = (long)ceil( t );
+    if (exit <= k) {
+        exit = k + 1;
+    }
+    while (exit < kmax && ray_in_block( x0, y0, dx, dy, exit, level, bx, by )) {
+        ++exit;
+    }
+    while (exit - 1 > k && !ray_in_block( x0, y0, dx, dy, exit - 1, level, bx, by )) {
+        --exit;
+    }
+    return exit;
+}
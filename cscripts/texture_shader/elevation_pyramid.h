@@ -0,0 +1,89 @@
+/*
+ * elevation_pyramid.h
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Hierarchy of maximum (and optionally minimum) elevations over blocks of
+// 2x2, 4x4, 8x8, ... pixels. Ray marchers use it to skip whole blocks that
+// the ray passes over (or under) without any effect on the result.
+//
+
+#ifndef ELEVATION_PYRAMID_H
+#define ELEVATION_PYRAMID_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PYRAMID_MAX_LEVELS 30
+
+typedef struct {
+    int          nlevels;   // number of levels above full resolution
+    int          ncols[PYRAMID_MAX_LEVELS+1];   // number of blocks per row at each level
+    const float *max[PYRAMID_MAX_LEVELS+1];     // block maxima; level 0 is the data itself
+    const float *min[PYRAMID_MAX_LEVELS+1];     // block minima (all NULL if not built)
+} Elevation_Pyramid;
+
+// Builds levels 1..n of the pyramid, up to a single block covering the whole array.
+// Data array must remain valid while pyramid is in use.
+// Returns 0 on success, nonzero if a memory allocation error occurred.
+int build_elevation_pyramid(
+    Elevation_Pyramid *pyramid, // output: pyramid to initialize
+    const float *data,          // input:  array of elevations (row-major order)
+    int  nrows,                 // input:  number of rows    in data array
+    int  ncols,                 // input:  number of columns in data array
+    int  with_min               // input:  nonzero to build block minima as well as maxima
+);
+
+// Frees memory allocated by build_elevation_pyramid().
+void free_elevation_pyramid( Elevation_Pyramid *pyramid );
+
+// For a ray marched from (x0, y0) in steps of (dx, dy) pixels, sampling pixel
+// ((int)(x0 + k*dx), (int)(y0 + k*dy)) at step k, returns the first step after
+// step k that is outside the block at given level containing pixel (x_int, y_int),
+// or kmax if that is sooner.
+long pyramid_ray_exit(
+    double x0, double y0, double dx, double dy, long k, long kmax,
+    int level, int x_int, int y_int );
+
+// Returns maximum elevation of the block at given level containing pixel (row, col).
+#define PYRAMID_MAX( pyramid, level, row, col ) \
+    ((pyramid)->max[level][(ptrdiff_t)((row) >> (level)) * (pyramid)->ncols[level] + ((col) >> (level))])
+
+// Returns minimum elevation of the block at given level containing pixel (row, col).
+#define PYRAMID_MIN( pyramid, level, row, col ) \
+    ((pyramid)->min[level][(ptrdiff_t)((row) >> (level)) * (pyramid)->ncols[level] + ((col) >> (level))])
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
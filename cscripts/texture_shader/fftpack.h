@@ -58,6 +58,30 @@ extern "C" {
 //#define FFTPACK_REAL float
 #define FFTPACK_REAL double
 
+// Number of transforms computed together by cosqf_batch() and cosqb_batch().
+// With GCC-compatible compilers these use vector types, so the default matches
+// the width of the target's double-precision vector registers (compile with
+// -mavx or -march=native for 4); wider batches are split by the compiler and
+// run slower. Define FFTPACK_BATCH as 8 for AVX-512, or as 1 to disable batching.
+#ifndef FFTPACK_BATCH
+#   if defined( __GNUC__ ) && defined( __AVX__ )
+#       define FFTPACK_BATCH 4
+#   elif defined( __GNUC__ ) && (defined( __SSE2__ ) || defined( __ARM_NEON ))
+#       define FFTPACK_BATCH 2
+#   else
+#       define FFTPACK_BATCH 1
+#   endif
+#endif
+
+#if FFTPACK_BATCH > 1
+    // FFTPACK_BATCH values processed in lockstep; requires only scalar alignment
+    typedef FFTPACK_REAL FFTPACK_VREAL __attribute__((
+        vector_size( FFTPACK_BATCH * sizeof( FFTPACK_REAL ) ),
+        aligned( sizeof( FFTPACK_REAL ) ) ));
+#else
+    typedef FFTPACK_REAL FFTPACK_VREAL;
+#endif
+
 //*******************************************************************************
 //
 //  costi initializes wsave and ifac, used in cost().
@@ -79,12 +103,12 @@ extern "C" {
 //    ifac[0] = n, the number that was factored.
 //    ifac[1] = nf, the number of factors.
 //    ifac[2..1+nf], the factors.
-//    ifac[2+nf] = m, the smallest power of two >= 2*n,
+//    ifac[2+nf] = m, the smallest 5-smooth even number >= 2*n,
 //                    or 0 if Bluestein's algorithm is not warranted for this n.
-//    ifac[3+nf] = mf, the number of factors (2's and 4's) of m.
-//    ifac[4+nf..3+nf+mf], factors of m (2's and 4's).
+//    ifac[3+nf] = mf, the number of factors (2's, 3's, 4's, and 5's) of m.
+//    ifac[4+nf..3+nf+mf], factors of m (2's, 3's, 4's, and 5's).
 //    ifac[4+nf+mf] = 0.
-//    Note: For a given value max_n, max_mf < 2 + 0.8 * max_nf,
+//    Note: For a given value max_n, max_mf < 2 + max_nf,
 //    where max_nf and max_mf are the max values of nf and mf for n<=max_n.
 //
 //*******************************************************************************
@@ -124,10 +148,10 @@ extern "C" {
 //    ifac[0] = n, the number that was factored.
 //    ifac[1] = nf, the number of factors.
 //    ifac[2..1+nf], the factors.
-//    ifac[2+nf] = m, the smallest power of two >= 2*n,
+//    ifac[2+nf] = m, the smallest 5-smooth even number >= 2*n,
 //                    or 0 if Bluestein's algorithm is not warranted for this n.
-//    ifac[3+nf] = mf, the number of factors (2's and 4's) of m.
-//    ifac[4+nf..3+nf+mf], factors of m (2's and 4's).
+//    ifac[3+nf] = mf, the number of factors (2's, 3's, 4's, and 5's) of m.
+//    ifac[4+nf..3+nf+mf], factors of m (2's, 3's, 4's, and 5's).
 //    ifac[4+nf+mf] = 0.
 //
 //*******************************************************************************
@@ -155,12 +179,12 @@ extern "C" {
 //    ifac[0] = n, the number that was factored.
 //    ifac[1] = nf, the number of factors.
 //    ifac[2..1+nf], the factors.
-//    ifac[2+nf] = m, the smallest power of two >= 2*n,
+//    ifac[2+nf] = m, the smallest 5-smooth even number >= 2*n,
 //                    or 0 if Bluestein's algorithm is not warranted for this n.
-//    ifac[3+nf] = mf, the number of factors (2's and 4's) of m.
-//    ifac[4+nf..3+nf+mf], factors of m (2's and 4's).
+//    ifac[3+nf] = mf, the number of factors (2's, 3's, 4's, and 5's) of m.
+//    ifac[4+nf..3+nf+mf], factors of m (2's, 3's, 4's, and 5's).
 //    ifac[4+nf+mf] = 0.
-//    Note: For a given value max_n, max_mf < 2 + 0.8 * max_nf,
+//    Note: For a given value max_n, max_mf < 2 + max_nf,
 //    where max_nf and max_mf are the max values of nf and mf for n<=max_n.
 //
 //*******************************************************************************
@@ -205,9 +229,9 @@ void cosqi(int n, FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
 //    ifac[0] = n, the number that was factored.
 //    ifac[1] = nf, the number of factors.
 //    ifac[2..1+nf], the factors.
-//    ifac[2+nf] = m, the smallest power of two >= 2*n, or 0.
-//    ifac[3+nf] = mf, the number of factors (2's and 4's) of m.
-//    ifac[4+nf..3+nf+mf], factors of m (2's and 4's).
+//    ifac[2+nf] = m, the smallest 5-smooth even number >= 2*n, or 0.
+//    ifac[3+nf] = mf, the number of factors (2's, 3's, 4's, and 5's) of m.
+//    ifac[4+nf..3+nf+mf], factors of m (2's, 3's, 4's, and 5's).
 //    ifac[4+nf+mf] = 0.
 //
 //*******************************************************************************
@@ -252,10 +276,10 @@ void cosqf(int n, FFTPACK_REAL *RESTRICT x, FFTPACK_REAL *RESTRICT wsave, int *R
 //    ifac[0] = n, the number that was factored.
 //    ifac[1] = nf, the number of factors.
 //    ifac[2..1+nf], the factors.
-//    ifac[2+nf] = m, the smallest power of two >= 2*n,
+//    ifac[2+nf] = m, the smallest 5-smooth even number >= 2*n,
 //                    or 0 if Bluestein's algorithm is not warranted for this n.
-//    ifac[3+nf] = mf, the number of factors (2's and 4's) of m.
-//    ifac[4+nf..3+nf+mf], factors of m (2's and 4's).
+//    ifac[3+nf] = mf, the number of factors (2's, 3's, 4's, and 5's) of m.
+//    ifac[4+nf..3+nf+mf], factors of m (2's, 3's, 4's, and 5's).
 //    ifac[4+nf+mf] = 0.
 //
 //*******************************************************************************
@@ -301,9 +325,9 @@ void cosqf2(
 //    ifac[0] = n, the number that was factored.
 //    ifac[1] = nf, the number of factors.
 //    ifac[2..1+nf], the factors.
-//    ifac[2+nf] = m, the smallest power of two >= 2*n, or 0.
-//    ifac[3+nf] = mf, the number of factors (2's and 4's) of m.
-//    ifac[4+nf..3+nf+mf], factors of m (2's and 4's).
+//    ifac[2+nf] = m, the smallest 5-smooth even number >= 2*n, or 0.
+//    ifac[3+nf] = mf, the number of factors (2's, 3's, 4's, and 5's) of m.
+//    ifac[4+nf..3+nf+mf], factors of m (2's, 3's, 4's, and 5's).
 //    ifac[4+nf+mf] = 0.
 //
 //*******************************************************************************
@@ -348,10 +372,10 @@ void cosqb(int n, FFTPACK_REAL *RESTRICT x, FFTPACK_REAL *RESTRICT wsave, int *R
 //    ifac[0] = n, the number that was factored.
 //    ifac[1] = nf, the number of factors.
 //    ifac[2..1+nf], the factors.
-//    ifac[2+nf] = m, the smallest power of two >= 2*n,
+//    ifac[2+nf] = m, the smallest 5-smooth even number >= 2*n,
 //                    or 0 if Bluestein's algorithm is not warranted for this n.
-//    ifac[3+nf] = mf, the number of factors (2's and 4's) of m.
-//    ifac[4+nf..3+nf+mf], factors of m (2's and 4's).
+//    ifac[3+nf] = mf, the number of factors (2's, 3's, 4's, and 5's) of m.
+//    ifac[4+nf..3+nf+mf], factors of m (2's, 3's, 4's, and 5's).
 //    ifac[4+nf+mf] = 0.
 //
 //*******************************************************************************
@@ -359,6 +383,113 @@ void cosqb2(
     int n, FFTPACK_REAL *RESTRICT x1, FFTPACK_REAL *RESTRICT x2,
     FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
 
+//*******************************************************************************
+//
+//  cosqf_batch and cosqb_batch compute FFTPACK_BATCH fast cosine transforms
+//  of quarter wave data at once.
+//
+//  Description:
+//
+//    These compute the same transforms as cosqf and cosqb, for
+//    FFTPACK_BATCH sequences stored interleaved, so that every radix pass
+//    loads each twiddle factor once for all of the sequences and operates
+//    on them with vector instructions.
+//
+//    The arrays wsave and ifac must be initialized by calling cosqi.
+//    These routines always use the mixed-radix algorithm; when cosqi has
+//    chosen Bluestein's algorithm for n (ifac[2+nf] != 0), cosqf2_batch
+//    and cosqb2_batch are usually faster.
+//
+//  Parameters:
+//
+//    Input, int n, the length of each sequence.
+//
+//    Input/output, VREAL x[n].
+//    On input, x[i][j] is element i of sequence j to be transformed.
+//    On output, the transformed sequences in the same layout.
+//
+//    Workspace, VREAL work[n].
+//
+//    Input, REAL wsave[28*n], initialized by calling cosqi.
+//
+//    Input, int ifac[], initialized by calling cosqi.
+//
+//*******************************************************************************
+void cosqf_batch(
+    int n, FFTPACK_VREAL *RESTRICT x, FFTPACK_VREAL *RESTRICT work,
+    FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
+
+void cosqb_batch(
+    int n, FFTPACK_VREAL *RESTRICT x, FFTPACK_VREAL *RESTRICT work,
+    FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
+
+//*******************************************************************************
+//
+//  cosqf2_batch and cosqb2_batch compute 2*FFTPACK_BATCH fast cosine
+//  transforms of quarter wave data at once.
+//
+//  Description:
+//
+//    These compute the same transforms as cosqf2 and cosqb2, for two
+//    groups of FFTPACK_BATCH sequences, each stored interleaved as for
+//    cosqf_batch. Like cosqf2 and cosqb2, they use Bluestein's algorithm
+//    when cosqi has chosen it for n, which needs a larger work array.
+//
+//  Parameters:
+//
+//    Input, int n, the length of each sequence.
+//
+//    Input/output, VREAL x1[n], x2[n], the two groups of sequences.
+//
+//    Workspace, VREAL work[max(n,3*m)], where m = ifac[2+nf] (see cosqi).
+//
+//    Input, REAL wsave[28*n], initialized by calling cosqi.
+//
+//    Input, int ifac[], initialized by calling cosqi.
+//
+//*******************************************************************************
+void cosqf2_batch(
+    int n, FFTPACK_VREAL *RESTRICT x1, FFTPACK_VREAL *RESTRICT x2,
+    FFTPACK_VREAL *RESTRICT work, FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
+
+void cosqb2_batch(
+    int n, FFTPACK_VREAL *RESTRICT x1, FFTPACK_VREAL *RESTRICT x2,
+    FFTPACK_VREAL *RESTRICT work, FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
+
+//*******************************************************************************
+//
+//  rfftf_batch and rfftb_batch compute FFTPACK_BATCH real periodic
+//  transforms at once.
+//
+//  Description:
+//
+//    These compute the same transforms as rfftf and rfftb, for
+//    FFTPACK_BATCH sequences stored interleaved as for cosqf_batch.
+//
+//  Parameters:
+//
+//    Input, int n, the length of each sequence.
+//
+//    Input/output, VREAL r[n].
+//    On input, r[i][j] is element i of sequence j to be transformed.
+//    On output, the transformed sequences in the same layout.
+//
+//    Workspace, VREAL work[n].
+//
+//    Input, REAL wsave[n], initialized by calling rffti.  Note that this
+//    is wsave+n of the array initialized by cosqi, which calls rffti.
+//
+//    Input, int ifac[], initialized by calling rffti or cosqi.
+//
+//*******************************************************************************
+void rfftf_batch(
+    int n, FFTPACK_VREAL *RESTRICT r, FFTPACK_VREAL *RESTRICT work,
+    FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
+
+void rfftb_batch(
+    int n, FFTPACK_VREAL *RESTRICT r, FFTPACK_VREAL *RESTRICT work,
+    FFTPACK_REAL *RESTRICT wsave, int *RESTRICT ifac);
+
 
 //*******************************************************************************
 //
@@ -0,0 +1,164 @@
+/********************************************************************
+ *
+ * File: fftpack_batch.c
+ * Function: Batched fast cosine transforms using vector arithmetic
+ *
+ * Original author: Paul N. Swarztrauber
+ * Last modification date: 1985 Apr (public domain)
+ *
+ * Modifications by: Monty <xiphmont@mit.edu>
+ * Last modification date: 1996 Jul 01 (public domain)
+ *
+ * Modifications by: Leland Brown
+ * Last modification date: 2013 Nov 15
+ *
+ * Modifications by: agent
+ * Last modification date: 2026 Oct 18
+ *
+ * Copyright (c) 2011-2013 Leland Brown.
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************/
+
+#include "fftpack.h"
+
+#include <math.h>
+
+#define REAL FFTPACK_REAL
+#define DATA FFTPACK_VREAL
+
+// same radix kernels as fftpack.c, compiled for vector data
+#include "fftpack_kernels.h"
+
+void cosqf_batch(
+    int n, DATA *RESTRICT x, DATA *RESTRICT work,
+    REAL *RESTRICT wsave, int *RESTRICT ifac)
+{
+    static const REAL sqrt2 = 1.4142135623730950488;
+    //static const REAL sqrt2 = 1.414213562373095048801688724209698079; // long double
+    DATA tsqx;
+
+    if (n < 2) {
+        return;
+    }
+    if (n == 2) {
+        tsqx = sqrt2 * x[1];
+        x[1] = x[0] - tsqx;
+        x[0] += tsqx;
+        return;
+    }
+
+    csqf1(n, x, wsave, work, ifac);
+}
+
+void cosqb_batch(
+    int n, DATA *RESTRICT x, DATA *RESTRICT work,
+    REAL *RESTRICT wsave, int *RESTRICT ifac)
+{
+    static const REAL tsqrt2 = 2.8284271247461900976;
+    //static const REAL tsqrt2 = 2.828427124746190097603377448419396157;    // long double
+    DATA x1;
+
+    if (n < 2) {
+        x[0] *= 4.0;
+        return;
+    }
+    if (n == 2) {
+        x1   = (x[0] + x[1]) * 4.0;
+        x[1] = (x[0] - x[1]) * tsqrt2;
+        x[0] = x1;
+        return;
+    }
+
+    csqb1(n, x, wsave, work, ifac);
+}
+
+void cosqf2_batch(
+    int n, DATA *RESTRICT x1, DATA *RESTRICT x2, DATA *RESTRICT work,
+    REAL *RESTRICT wsave, int *RESTRICT ifac)
+{
+    int m;
+    int *mfac;
+
+    if (n <= 2) {
+        cosqf_batch(n, x1, work, wsave, ifac);
+        cosqf_batch(n, x2, work, wsave, ifac);
+        return;
+    }
+
+    mfac = ifac+ifac[1]+2;
+    m    = mfac[0];
+
+    if (m) {
+        csqf2(n, m, x1, x2, wsave, work, work+m*2, mfac);
+    } else {
+        csqf1(n, x1, wsave, work, ifac);
+        csqf1(n, x2, wsave, work, ifac);
+    }
+}
+
+void cosqb2_batch(
+    int n, DATA *RESTRICT x1, DATA *RESTRICT x2, DATA *RESTRICT work,
+    REAL *RESTRICT wsave, int *RESTRICT ifac)
+{
+    int m;
+    int *mfac;
+
+    if (n <= 2) {
+        cosqb_batch(n, x1, work, wsave, ifac);
+        cosqb_batch(n, x2, work, wsave, ifac);
+        return;
+    }
+
+    mfac = ifac+ifac[1]+2;
+    m    = mfac[0];
+
+    if (m) {
+        csqb2(n, m, x1, x2, wsave, work, work+m*2, mfac);
+    } else {
+        csqb1(n, x1, wsave, work, ifac);
+        csqb1(n, x2, wsave, work, ifac);
+    }
+}
+
+void rfftf_batch(
+    int n, DATA *RESTRICT r, DATA *RESTRICT work,
+    REAL *RESTRICT wsave, int *RESTRICT ifac)
+{
+    if (n == 1) {
+        return;
+    }
+    rftf1(n, r, work, wsave, ifac);
+}
+
+void rfftb_batch(
+    int n, DATA *RESTRICT r, DATA *RESTRICT work,
+    REAL *RESTRICT wsave, int *RESTRICT ifac)
+{
+    if (n == 1) {
+        return;
+    }
+    rftb1(n, r, work, wsave, ifac);
+}
@@ -0,0 +1,308 @@
+/*
+ * horizon_map.c
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "horizon_map.h"
+#include "horizon_scan.h"
+#include "thread_pool.h"
+
+#include "compatibility.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // for ptrdiff_t
+#include <math.h>
+
+#define LONG ptrdiff_t
+
+#define deg2rad(angleDegrees) ((angleDegrees) * M_PI / 180.0)
+#define rad2deg(angleRadians) ((angleRadians) * 180.0 / M_PI)
+
+// Identifies a horizon map cache file (not null-terminated); version 2 stores
+// the checksum in 4 bytes on every platform, where version 1 used unsigned long
+static const char horizon_magic[8] = { 'H','O','R','I','Z','O','N','2' };
+
+// Written native-endian to detect cache files from machines with other byte order
+static const int byte_order_mark = 0x01020304;
+
+int compute_horizon_map(
+    Horizon_Map *map, const float *data, int nrows, int ncols,
+    double xdim, double ydim, int nsectors )
+{
+    LONG size = (LONG)nrows * (LONG)ncols;
+
+    float *slopes;
+
+    int  s;
+    LONG n;
+
+    map->nrows    = nrows;
+    map->ncols    = ncols;
+    map->nsectors = nsectors;
+    map->angles   = (short *)malloc( nsectors * size * sizeof( short ) );
+
+    if (!map->angles) {
+        return HORIZON_MALLOC_ERROR;
+    }
+
+    // horizon slopes for one sector at a time, converted to angles
+    slopes = (float *)malloc( size * sizeof( float ) );
+    if (!slopes) {
+        free_horizon_map( map );
+        return HORIZON_MALLOC_ERROR;
+    }
+
+    for (s=0; s<nsectors; ++s) {
+        short *angles = map->angles + s * size;
+
+        if (sweep_horizons( data, slopes, nrows, ncols, xdim, ydim, 360.0 * s / nsectors, 0.0 )) {
+            free( slopes );
+            free_horizon_map( map );
+            return HORIZON_MALLOC_ERROR;
+        }
+
+        for (n=0; n<size; ++n) {
+            double angle = rad2deg( atan( slopes[n] ) );
+            angles[n] = (short)floor( angle * HORIZON_UNITS_PER_DEGREE + 0.5 );
+        }
+    }
+
+    free( slopes );
+
+    return HORIZON_SUCCESS;
+}
+
+static unsigned int data_checksum( const float *data, LONG count )
+// 32-bit FNV-1a hash of the bytes of the data array
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    unsigned int hash = 2166136261U;
+
+    LONG n;
+
+    for (n=0; n<count*(LONG)sizeof( float ); ++n) {
+        hash = ((hash ^ bytes[n]) * 16777619U) & 0xFFFFFFFFU;
+    }
+
+    return hash;
+}
+
+int read_horizon_map(
+    Horizon_Map *map, FILE *in_file, const float *data, int nrows, int ncols,
+    double xdim, double ydim, int nsectors )
+{
+    LONG size = (LONG)nrows * (LONG)ncols;
+
+    char         magic[8];
+    int          order;
+    int          dims[3];
+    double       spacing[2];
+    unsigned int checksum;
+
+    map->angles = NULL;
+
+    if (fread( magic,     sizeof( magic ),    1, in_file ) != 1 ||
+        fread( &order,    sizeof( order ),    1, in_file ) != 1 ||
+        fread( dims,      sizeof( dims ),     1, in_file ) != 1 ||
+        fread( spacing,   sizeof( spacing ),  1, in_file ) != 1 ||
+        fread( &checksum, sizeof( checksum ), 1, in_file ) != 1 ||
+        memcmp( magic, horizon_magic, sizeof( magic ) ) != 0)
+    {
+        return HORIZON_FILE_ERROR;
+    }
+
+    if (order != byte_order_mark || dims[0] != nrows || dims[1] != ncols ||
+        dims[2] != nsectors || spacing[0] != xdim || spacing[1] != ydim ||
+        checksum != data_checksum( data, size ))
+    {
+        return HORIZON_STALE_CACHE;
+    }
+
+    map->nrows    = nrows;
+    map->ncols    = ncols;
+    map->nsectors = nsectors;
+    map->angles   = (short *)malloc( nsectors * size * sizeof( short ) );
+
+    if (!map->angles) {
+        return HORIZON_MALLOC_ERROR;
+    }
+
+    if (fread( map->angles, sizeof( short ), nsectors * size, in_file ) != (size_t)(nsectors * size)) {
+        free_horizon_map( map );
+        return HORIZON_FILE_ERROR;
+    }
+
+    return HORIZON_SUCCESS;
+}
+
+int write_horizon_map(
+    const Horizon_Map *map, FILE *out_file, const float *data, double xdim, double ydim )
+{
+    LONG size = (LONG)map->nrows * (LONG)map->ncols;
+
+    int          dims[3];
+    double       spacing[2];
+    unsigned int checksum = data_checksum( data, size );
+
+    dims[0]    = map->nrows;
+    dims[1]    = map->ncols;
+    dims[2]    = map->nsectors;
+    spacing[0] = xdim;
+    spacing[1] = ydim;
+
+    if (fwrite( horizon_magic,    sizeof( horizon_magic ),    1, out_file ) != 1 ||
+        fwrite( &byte_order_mark, sizeof( byte_order_mark ),  1, out_file ) != 1 ||
+        fwrite( dims,             sizeof( dims ),             1, out_file ) != 1 ||
+        fwrite( spacing,          sizeof( spacing ),          1, out_file ) != 1 ||
+        fwrite( &checksum,        sizeof( checksum ),         1, out_file ) != 1 ||
+        fwrite( map->angles, sizeof( short ), map->nsectors * size, out_file ) !=
+            (size_t)(map->nsectors * size) ||
+        fflush( out_file ))
+    {
+        return HORIZON_FILE_ERROR;
+    }
+
+    return HORIZON_SUCCESS;
+}
+
+void free_horizon_map( Horizon_Map *map )
+{
+    free( map->angles );
+    map->angles = NULL;
+}
+
+static void find_sectors(
+    const Horizon_Map *map, double azimuth, int interpolate,
+    int *sector0, int *sector1, double *weight1 )
+// Finds the sectors (and weight of the second) used for given azimuth
+{
+    double pos = fmod( azimuth, 360.0 ) * map->nsectors / 360.0;
+
+    if (pos < 0.0) {
+        pos += map->nsectors;
+    }
+
+    if (interpolate) {
+        *sector0 = (int)floor( pos );
+        *weight1 = pos - *sector0;
+    } else {
+        *sector0 = (int)floor( pos + 0.5 );
+        *weight1 = 0.0;
+    }
+    *sector0 %= map->nsectors;
+    *sector1 = (*sector0 + 1) % map->nsectors;
+}
+
+double horizon_angle(
+    const Horizon_Map *map, int row, int col, double azimuth, int interpolate )
+{
+    LONG size  = (LONG)map->nrows * (LONG)map->ncols;
+    LONG index = (LONG)row * (LONG)map->ncols + col;
+
+    int    s0, s1;
+    double w1;
+
+    find_sectors( map, azimuth, interpolate, &s0, &s1, &w1 );
+
+    return ((1.0 - w1) * map->angles[s0 * size + index] + w1 * map->angles[s1 * size + index]) /
+           HORIZON_UNITS_PER_DEGREE;
+}
+
+void horizon_shadows(
+    const Horizon_Map *map, float *shadow, double sun_az, double sun_el, int interpolate )
+{
+    LONG size = (LONG)map->nrows * (LONG)map->ncols;
+
+    const short *RESTRICT angles0;
+    const short *RESTRICT angles1;
+
+    int    s0, s1;
+    double w1;
+    LONG   n;
+
+    find_sectors( map, sun_az, interpolate, &s0, &s1, &w1 );
+
+    angles0 = map->angles + s0 * size;
+    angles1 = map->angles + s1 * size;
+
+    for (n=0; n<size; ++n) {
+        double depth =
+            ((1.0 - w1) * angles0[n] + w1 * angles1[n]) / HORIZON_UNITS_PER_DEGREE - sun_el;
+        shadow[n] = depth > 0.0 ? (float)depth : 0.0f;
+    }
+}
+
+// Parameters for computing sky view factors from a horizon map
+typedef struct {
+    const Horizon_Map *map;
+    float             *skyview;
+} Sky_View_Task;
+
+// Thread_Pool_Task computing sky view factors for pixels begin..end-1
+static void horizon_sky_view_task( void *state, long begin, long end )
+{
+    const Sky_View_Task *task = (const Sky_View_Task *)state;
+    const Horizon_Map   *map  = task->map;
+
+    LONG size = (LONG)map->nrows * (LONG)map->ncols;
+
+    const short min_angle = -70 * HORIZON_UNITS_PER_DEGREE;
+
+    LONG n;
+    int  s;
+
+    for (n=begin; n<end; ++n) {
+        double high_sum = 0.0;
+        int    high_angle_count = 0;
+        for (s=0; s<map->nsectors; ++s) {
+            short angle = map->angles[s * size + n];
+            if (angle > min_angle) {
+                high_angle_count++;
+                high_sum += sin( deg2rad( (double)angle / HORIZON_UNITS_PER_DEGREE ) );
+            }
+        }
+        task->skyview[n] = high_sum / high_angle_count;
+    }
+}
+
+void horizon_sky_view( const Horizon_Map *map, float *skyview )
+{
+    Sky_View_Task task;
+
+    task.map     = map;
+    task.skyview = skyview;
+
+    // CONCURRENCY NOTE: Each pixel writes only its own sky view factor.
+
+    thread_pool_run( (long)map->nrows * (long)map->ncols, 4096, horizon_sky_view_task, &task );
+}
@@ -0,0 +1,131 @@
+/*
+ * horizon_map.h
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Horizon elevation angle of every pixel in each of a number of evenly spaced
+// azimuth directions. Once computed (or loaded from a cache file written next
+// to the elevation data), shadows for any sun elevation at these azimuths,
+// and sky view factors, follow from a lookup rather than marching rays.
+//
+
+#ifndef HORIZON_MAP_H
+#define HORIZON_MAP_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum Horizon_Errors {
+    HORIZON_SUCCESS      = 0,
+    HORIZON_MALLOC_ERROR = 1,   // memory allocation error occurred
+    HORIZON_FILE_ERROR   = 2,   // cache file could not be read or written
+    HORIZON_STALE_CACHE  = 3    // cache file does not match the elevation data
+};
+
+// Quantization of stored horizon angles (steps per degree)
+#define HORIZON_UNITS_PER_DEGREE 100
+
+typedef struct {
+    int    nrows;       // number of rows    in data array
+    int    ncols;       // number of columns in data array
+    int    nsectors;    // number of azimuth directions
+    short *angles;      // horizon angles in 1/HORIZON_UNITS_PER_DEGREE degrees,
+                        // for sector s at angles[(s*nrows + row)*ncols + col]
+} Horizon_Map;
+
+// Computes horizon angles for azimuths 0, 360/nsectors, 2*360/nsectors, ...
+// degrees (clockwise from north, toward the top row = north). The horizon
+// extends to the edge of the data; pixels with nothing in a direction (e.g.,
+// on the edge of the array) have a horizon angle of -90 degrees.
+// Runs on the threads of thread_pool.h, with results independent of the thread count.
+// Returns 0 on success, nonzero if an error occurred (see enum Horizon_Errors).
+int compute_horizon_map(
+    Horizon_Map *map,   // output: horizon map to initialize
+    const float *data,  // input:  array of elevations (row-major order)
+    int    nrows,       // input:  number of rows    in data array
+    int    ncols,       // input:  number of columns in data array
+    double xdim,        // input:  spacing between pixel columns (in elevation units)
+    double ydim,        // input:  spacing between pixel rows    (in elevation units)
+    int    nsectors     // input:  number of azimuth directions
+);
+
+// Reads a horizon map written by write_horizon_map() for the same data
+// array, pixel spacing, and number of sectors.
+// Returns 0 on success, HORIZON_STALE_CACHE if the file is for different data
+// (or was written on a machine with different byte order), or another
+// nonzero value if an error occurred (see enum Horizon_Errors).
+int read_horizon_map(
+    Horizon_Map *map,   // output: horizon map to initialize
+    FILE  *in_file,     // input:  cache file - should be opened in BINARY mode
+    const float *data,  // input:  array of elevations (row-major order)
+    int    nrows,       // input:  number of rows    in data array
+    int    ncols,       // input:  number of columns in data array
+    double xdim,        // input:  spacing between pixel columns (in elevation units)
+    double ydim,        // input:  spacing between pixel rows    (in elevation units)
+    int    nsectors     // input:  number of azimuth directions
+);
+
+// Writes a horizon map to a cache file, with a checksum of the data array
+// it was computed from.
+// Returns 0 on success, nonzero if an error occurred (see enum Horizon_Errors).
+int write_horizon_map(
+    const Horizon_Map *map, // input: horizon map to write
+    FILE  *out_file,    // input:  cache file - should be opened in BINARY mode
+    const float *data,  // input:  array of elevations the map was computed from
+    double xdim,        // input:  spacing between pixel columns (in elevation units)
+    double ydim         // input:  spacing between pixel rows    (in elevation units)
+);
+
+// Frees memory allocated by compute_horizon_map() or read_horizon_map().
+void free_horizon_map( Horizon_Map *map );
+
+// Returns horizon angle (in degrees) of pixel (row, col) at given azimuth
+// (in degrees clockwise from north), either from the nearest sector or
+// interpolated linearly between the two nearest sectors.
+double horizon_angle(
+    const Horizon_Map *map, int row, int col, double azimuth, int interpolate );
+
+// Computes shadows for a sun at given azimuth and elevation (in degrees):
+// the angle (in degrees) by which the horizon rises above the sun, or 0 for
+// pixels in sunlight.
+void horizon_shadows(
+    const Horizon_Map *map, float *shadow, double sun_az, double sun_el, int interpolate );
+
+// Computes the sky view factor of each pixel from its horizon angles,
+// as sky_view_factor() (see horizon_scan.h) does from marched horizons.
+void horizon_sky_view( const Horizon_Map *map, float *skyview );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
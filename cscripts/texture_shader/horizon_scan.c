@@ -0,0 +1,1038 @@
+/*
+ * horizon_scan.c
+ *
+ * Created by agent on 2026 Oct 18.
+ * Sky view factor adapted from svf.c, by Kyle Bradley, NTU.
+ *
+ * Copyright (c) 2026 agent.
+ * Portions copyright (c) 2011-2013 Leland Brown.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "horizon_scan.h"
+#include "thread_pool.h"
+#include "raster_tiles.h"
+
+#include "compatibility.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // for ptrdiff_t
+#include <math.h>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#   define HORIZON_SSE 1
+#else
+#   define HORIZON_SSE 0
+#endif
+
+#define LONG ptrdiff_t
+
+// Minimum search distance (in pixels) for which skipping blocks of the elevation
+// pyramid saves more time than checking them costs
+#define PYRAMID_MIN_DISTANCE 256
+
+// Size of tiles for sky view factor without the pyramid, small enough for the
+// pixels sampled by a tile's rays to stay in cache
+#define SKY_VIEW_TILE_ROWS 64
+#define SKY_VIEW_TILE_COLS 512
+
+#define deg2rad(angleDegrees) ((angleDegrees) * M_PI / 180.0)
+#define rad2deg(angleRadians) ((angleRadians) * 180.0 / M_PI)
+
+double fix_azimuth( double az, double xdim, double ydim )
+{
+    double val;
+    val=rad2deg(atan(ydim/xdim*tan(deg2rad(az))));
+    if (az>90) {
+        val=val+180;
+    }
+    if (az>270) {
+        val=val+180;
+    }
+    return val;
+}
+
+static void scan_horizon_slopes(
+    const float *data, int nrows, int ncols, const Elevation_Pyramid *pyramid,
+    int row, int col, double dx, double dy, double step_dist, int max_steps,
+    double *high_slope_out, double *low_slope_out )
+// As scan_horizon(), but returns the slopes (tangents) of the horizons,
+// or -HUGE_VAL and +HUGE_VAL if nothing is sampled.
+{
+    double x = col;
+    double y = row;
+    double base_zval = data[(LONG)row * (LONG)ncols + col];
+
+    double high_slope = -HUGE_VAL;
+    double low_slope  = HUGE_VAL;
+
+    int x_int = col;
+    int y_int = row;
+    int d_run = 1;
+
+    // Steps are computed from the start of the ray rather than accumulated,
+    // so that blocks of the pyramid which can't change either horizon
+    // (judged over the whole remaining search distance) are skipped.
+    // Since atan() is monotonic, horizons are found by comparing slopes,
+    // and only converted to angles at the end.
+
+    while (x_int > 0 && y_int > 0 && d_run <= max_steps) {
+        double this_zval;
+        double this_slope;
+        int    level;
+
+        x_int = (int)(x + d_run * dx);
+        y_int = (int)(y + d_run * dy);
+        if (x_int < 0 || y_int < 0 || x_int >= ncols || y_int >= nrows) {
+            break;
+        }
+
+        this_zval  = data[(LONG)y_int * (LONG)ncols + x_int];
+        this_slope = (this_zval - base_zval) / (d_run * step_dist);
+        if (this_slope > high_slope) {
+            high_slope = this_slope;
+        }
+        if (this_slope < low_slope) {
+            low_slope = this_slope;
+        }
+
+        // a block can't change either horizon if its slopes from the base
+        // point are all within high_slope..low_slope
+        level = 0;
+        while (pyramid && level < pyramid->nlevels) {
+            double block_max = PYRAMID_MAX( pyramid, level+1, y_int, x_int ) - base_zval;
+            double block_min = PYRAMID_MIN( pyramid, level+1, y_int, x_int ) - base_zval;
+            double near_d = d_run * step_dist;
+            double far_d  = max_steps * step_dist;
+            if (block_max / (block_max >= 0 ? near_d : far_d) > high_slope ||
+                block_min / (block_min >= 0 ? far_d : near_d) < low_slope)
+            {
+                break;
+            }
+            ++level;
+        }
+        if (level > 0) {
+            d_run = pyramid_ray_exit( x, y, dx, dy, d_run, max_steps+1, level, x_int, y_int );
+            // skipped steps stay in the block - stop if the last one was on the edge
+            x_int = (int)(x + (d_run-1) * dx);
+            y_int = (int)(y + (d_run-1) * dy);
+        } else {
+            d_run++;
+        }
+    }
+
+    *high_slope_out = high_slope;
+    *low_slope_out  = low_slope;
+}
+
+void scan_horizon(
+    const float *data, int nrows, int ncols, const Elevation_Pyramid *pyramid,
+    int row, int col, double dx, double dy, double step_dist, int max_steps,
+    double *high_angle, double *low_angle )
+{
+    double high_slope;
+    double low_slope;
+
+    scan_horizon_slopes( data, nrows, ncols, pyramid, row, col, dx, dy, step_dist, max_steps,
+                         &high_slope, &low_slope );
+
+    *high_angle = atan( high_slope );
+    *low_angle  = atan( low_slope  );
+}
+
+// Sample offsets and distances along a ray in one direction, the same for every
+// starting pixel (so neighboring pixels' rays sample neighboring pixels)
+typedef struct {
+    int    nsteps;      // number of samples
+    int   *col_off;     // column offset of each sample from the starting pixel
+    int   *row_off;     // row    offset of each sample from the starting pixel
+    LONG  *index_off;   // array index offset of each sample
+    float *inv_dist;    // reciprocal of distance to each sample
+    int    min_col_off, max_col_off;
+    int    min_row_off, max_row_off;
+} Ray_Stencil;
+
+static void make_stencil(
+    Ray_Stencil *stencil, int ncols, double dx, double dy, double step_dist, int nsteps,
+    int *col_off, int *row_off, LONG *index_off, float *inv_dist )
+{
+    int k;
+
+    stencil->nsteps    = nsteps;
+    stencil->col_off   = col_off;
+    stencil->row_off   = row_off;
+    stencil->index_off = index_off;
+    stencil->inv_dist  = inv_dist;
+    stencil->min_col_off = stencil->max_col_off = 0;
+    stencil->min_row_off = stencil->max_row_off = 0;
+
+    // treat roundoff in direction (e.g., cos(270 deg)) as exactly zero, which
+    // truncating sample coordinates toward the starting pixel used to hide
+    if (fabs( dx ) < 1e-12) {
+        dx = 0.0;
+    }
+    if (fabs( dy ) < 1e-12) {
+        dy = 0.0;
+    }
+
+    for (k=0; k<nsteps; ++k) {
+        col_off[k]   = (int)floor( (k+1) * dx );
+        row_off[k]   = (int)floor( (k+1) * dy );
+        index_off[k] = (LONG)row_off[k] * (LONG)ncols + col_off[k];
+        inv_dist[k]  = (float)(1.0 / ((k+1) * step_dist));
+        if (col_off[k] < stencil->min_col_off) stencil->min_col_off = col_off[k];
+        if (col_off[k] > stencil->max_col_off) stencil->max_col_off = col_off[k];
+        if (row_off[k] < stencil->min_row_off) stencil->min_row_off = row_off[k];
+        if (row_off[k] > stencil->max_row_off) stencil->max_row_off = row_off[k];
+    }
+}
+
+static float stencil_high_slope(
+    const float *data, int nrows, int ncols, const Ray_Stencil *stencil, int row, int col )
+// Returns highest slope from pixel (row, col) to the terrain sampled by the stencil,
+// stopping (as scan_horizon() does) before leaving the array or after reaching
+// row 0 or column 0; returns -HUGE_VAL if nothing is sampled.
+{
+    float base  = data[(LONG)row * (LONG)ncols + col];
+    float slope = -HUGE_VAL;
+
+    int x_int = col;
+    int y_int = row;
+    int k;
+
+    for (k=0; k<stencil->nsteps && x_int > 0 && y_int > 0; ++k) {
+        float this_slope;
+        x_int = col + stencil->col_off[k];
+        y_int = row + stencil->row_off[k];
+        if (x_int < 0 || y_int < 0 || x_int >= ncols || y_int >= nrows) {
+            break;
+        }
+        this_slope = (data[(LONG)y_int * (LONG)ncols + x_int] - base) * stencil->inv_dist[k];
+        if (this_slope > slope) {
+            slope = this_slope;
+        }
+    }
+
+    return slope;
+}
+
+static void stencil_high_slopes(
+    const float *RESTRICT data, float *RESTRICT slopes, int count, const Ray_Stencil *stencil )
+// Stores highest slopes from pixels data[0..count-1] to the terrain sampled by the
+// stencil, for pixels whose whole stencil is within the array (and not in row 0
+// or column 0). Neighboring pixels are processed in parallel SIMD lanes.
+{
+    const LONG  *RESTRICT index_off = stencil->index_off;
+    const float *RESTRICT inv_dist  = stencil->inv_dist;
+
+    int nsteps = stencil->nsteps;
+    int j = 0;
+    int k;
+
+#if HORIZON_SSE
+    for (; j+4<=count; j+=4) {
+        __m128 base  = _mm_loadu_ps( data + j );
+        __m128 slope = _mm_set1_ps( -HUGE_VAL );
+        for (k=0; k<nsteps; ++k) {
+            __m128 rise = _mm_sub_ps( _mm_loadu_ps( data + j + index_off[k] ), base );
+            slope = _mm_max_ps( slope, _mm_mul_ps( rise, _mm_set1_ps( inv_dist[k] ) ) );
+        }
+        _mm_storeu_ps( slopes + j, slope );
+    }
+#endif
+
+    for (; j<count; ++j) {
+        float slope = -HUGE_VAL;
+        for (k=0; k<nsteps; ++k) {
+            float this_slope = (data[j + index_off[k]] - data[j]) * inv_dist[k];
+            if (this_slope > slope) {
+                slope = this_slope;
+            }
+        }
+        slopes[j] = slope;
+    }
+}
+
+// Parameters shared by all rows for sky view factor
+typedef struct {
+    const float *data;
+    float       *skyview;
+    int    nrows;
+    int    ncols;
+    int    col_begin;           // first column to compute
+    int    col_end;             // one past last column to compute
+    int    num_angles;
+    int    nsteps;              // ray steps to search
+    double min_slope;           // ignore horizons at or below this slope
+    const double      *dir_x;   // ray step in columns, for each direction
+    const double      *dir_y;   // ray step in rows,    for each direction
+    const double      *dir_d;   // length of ray step,  for each direction
+    const Ray_Stencil *stencils;    // sample offsets for each direction
+    const Elevation_Pyramid
+          *pyramid;             // block maxima & minima of data; NULL to use stencils
+    char  *failed;              // per row: set nonzero if the chunk starting there failed
+} Sky_View_Task;
+
+// Computes sky view factors for rows begin..end-1, columns col_begin..col_end-1.
+// Returns 0 on success, nonzero if memory allocation fails.
+static int sky_view_rows( const Sky_View_Task *task, long begin, long end )
+{
+
+    const float *data  = task->data;
+    int          nrows = task->nrows;
+    int          ncols = task->ncols;
+
+    // scratch space for one row, private to this call
+    double *high_sum   = (double *)malloc( ncols * sizeof( double ) );
+    int    *high_count = (int    *)malloc( ncols * sizeof( int    ) );
+    float  *slopes     = (float  *)malloc( ncols * sizeof( float  ) );
+
+    long i;
+    int  j, a;
+
+    if (!high_sum || !high_count || !slopes) {
+        free( high_sum );
+        free( high_count );
+        free( slopes );
+        return 1;
+    }
+
+    for (i=begin; i<end; i++) {
+        const float *ptr  = data          + (LONG)i * (LONG)ncols;
+        float       *ptr2 = task->skyview + (LONG)i * (LONG)ncols;
+
+        for (j=task->col_begin; j<task->col_end; j++) {
+            high_sum[j]   = 0.0;
+            high_count[j] = 0;
+        }
+
+        for (a=0; a<task->num_angles; a++) {
+            const Ray_Stencil *stencil = &task->stencils[a];
+
+            // columns to compute whose whole stencil stays inside the array
+            // (and off row & column 0)
+            int col_lo = 1 - stencil->min_col_off > 1 ? 1 - stencil->min_col_off : 1;
+            int col_hi = ncols - 1 - stencil->max_col_off;
+            int inside;
+
+            if (col_lo < task->col_begin) {
+                col_lo = task->col_begin;
+            }
+            if (col_hi > task->col_end - 1) {
+                col_hi = task->col_end - 1;
+            }
+            inside = i >= 1 && i + stencil->min_row_off >= 1 &&
+                     i + stencil->max_row_off <= nrows - 1 && col_lo <= col_hi;
+
+            if (task->pyramid) {
+                for (j=task->col_begin; j<task->col_end; j++) {
+                    double high_slope;
+                    double low_slope;   // (not used in sky view factor)
+                    scan_horizon_slopes( data, nrows, ncols, task->pyramid, (int)i, j,
+                                         task->dir_x[a], task->dir_y[a], task->dir_d[a],
+                                         task->nsteps, &high_slope, &low_slope );
+                    slopes[j] = (float)high_slope;
+                }
+            } else if (inside) {
+                for (j=task->col_begin; j<col_lo; j++) {
+                    slopes[j] = stencil_high_slope( data, nrows, ncols, stencil, (int)i, j );
+                }
+                stencil_high_slopes( ptr + col_lo, slopes + col_lo, col_hi - col_lo + 1, stencil );
+                for (j=col_hi+1; j<task->col_end; j++) {
+                    slopes[j] = stencil_high_slope( data, nrows, ncols, stencil, (int)i, j );
+                }
+            } else {
+                for (j=task->col_begin; j<task->col_end; j++) {
+                    slopes[j] = stencil_high_slope( data, nrows, ncols, stencil, (int)i, j );
+                }
+            }
+
+            // sin( atan( slope ) ) without trig
+            for (j=task->col_begin; j<task->col_end; j++) {
+                double slope = slopes[j];
+                if (slope > task->min_slope) {
+                    high_count[j]++;
+                    high_sum[j] += slope / sqrt( 1.0 + slope * slope );
+                }
+            }
+        }
+
+        for (j=task->col_begin; j<task->col_end; j++) {
+            ptr2[j] = high_sum[j] / high_count[j];
+        }
+    }
+
+    free( high_sum );
+    free( high_count );
+    free( slopes );
+
+    return 0;
+}
+
+// Thread_Pool_Task computing sky view factors for rows begin..end-1
+static void sky_view_rows_task( void *state, long begin, long end )
+{
+    const Sky_View_Task *task = (const Sky_View_Task *)state;
+
+    if (sky_view_rows( task, begin, end )) {
+        task->failed[begin] = 1;    // each chunk writes only its own flag
+    }
+}
+
+static int make_stencils( Sky_View_Task *task, Ray_Stencil **stencils_out )
+// Allocates and makes the stencils of all directions for arrays of task->ncols
+// columns, as one block of memory; returns nonzero if allocation fails
+{
+    int  num_angles = task->num_angles;
+    int  nsteps     = task->nsteps;
+    LONG count      = (LONG)num_angles * nsteps;
+
+    Ray_Stencil *stencils = (Ray_Stencil *)malloc(
+        num_angles * sizeof( Ray_Stencil ) +
+        count * (2 * sizeof( int ) + sizeof( LONG ) + sizeof( float )) );
+
+    LONG  *index_off;
+    int   *col_off;
+    int   *row_off;
+    float *inv_dist;
+
+    int a;
+
+    *stencils_out = stencils;
+    if (!stencils) {
+        return 1;
+    }
+
+    // LONG arrays first for alignment
+    index_off = (LONG  *)(stencils + num_angles);
+    col_off   = (int   *)(index_off + count);
+    row_off   = col_off + count;
+    inv_dist  = (float *)(row_off + count);
+
+    for (a=0; a<num_angles; a++) {
+        make_stencil( &stencils[a], task->ncols, task->dir_x[a], task->dir_y[a], task->dir_d[a],
+                      nsteps, col_off + (LONG)a * nsteps, row_off + (LONG)a * nsteps,
+                      index_off + (LONG)a * nsteps, inv_dist + (LONG)a * nsteps );
+    }
+
+    task->stencils = stencils;
+
+    return 0;
+}
+
+// Raster_Tile_Operator computing sky view factors of one tile, with state
+// pointing to a Sky_View_Task for the whole array
+static int sky_view_tile( void *state, const Raster_Tile *tile )
+{
+    Sky_View_Task task = *(const Sky_View_Task *)state;
+
+    Ray_Stencil *stencils;
+
+    int error;
+
+    task.data      = tile->in;
+    task.skyview   = tile->out;
+    task.nrows     = tile->nrows;
+    task.ncols     = tile->ncols;
+    task.col_begin = tile->col_begin;
+    task.col_end   = tile->col_end;
+
+    // sample offsets depend on the width of the tile
+    if (make_stencils( &task, &stencils )) {
+        return 1;
+    }
+
+    error = sky_view_rows( &task, tile->row_begin, tile->row_end );
+
+    free( stencils );
+
+    return error;
+}
+
+int sky_view_factor(
+    const float *data, float *skyview, int nrows, int ncols,
+    double xdim, double ydim, int num_angles, int dist_cutoff )
+{
+    Elevation_Pyramid pyramid = { 0 };
+
+    Sky_View_Task task;
+
+    Ray_Stencil *stencils = NULL;
+
+    char *failed = NULL;    // per row, for the pyramid search
+
+    int nsteps = dist_cutoff + 1;
+
+    double *dir_x  = (double *)malloc( num_angles * sizeof( double ) );
+    double *dir_y  = (double *)malloc( num_angles * sizeof( double ) );
+    double *dir_d  = (double *)malloc( num_angles * sizeof( double ) );
+
+    int error = 0;
+    int a;
+
+    if (!dir_x || !dir_y || !dir_d) {
+        error = 1;
+    }
+
+    // Pyramid only saves time for long searches (see PYRAMID_MIN_DISTANCE)
+    if (!error && dist_cutoff >= PYRAMID_MIN_DISTANCE) {
+        error = build_elevation_pyramid( &pyramid, data, nrows, ncols, 1 );
+    }
+
+    // Direction of each ray, computed once for all pixels
+
+    for (a=0; a<num_angles && !error; a++) {
+        double this_angle = deg2rad(fix_azimuth(a*360/num_angles, xdim, ydim)); // Fix azimuth
+        dir_x[a] = sin(this_angle);
+        dir_y[a] = cos(this_angle);
+        dir_d[a] = sqrt(xdim*xdim*dir_x[a]*dir_x[a]+ydim*ydim*dir_y[a]*dir_y[a]);
+    }
+
+    if (!error) {
+        task.data       = data;
+        task.skyview    = skyview;
+        task.nrows      = nrows;
+        task.ncols      = ncols;
+        task.col_begin  = 0;
+        task.col_end    = ncols;
+        task.num_angles = num_angles;
+        task.nsteps     = nsteps;
+        task.min_slope  = tan( deg2rad(-70) );  // ignore horizons at or below -70 degrees
+        task.dir_x      = dir_x;
+        task.dir_y      = dir_y;
+        task.dir_d      = dir_d;
+        task.stencils   = NULL;
+        task.pyramid    = pyramid.nlevels > 0 ? &pyramid : NULL;
+        task.failed     = NULL;
+
+        if (task.pyramid) {
+            error = make_stencils( &task, &stencils );
+            if (!error) {
+                failed = (char *)calloc( nrows + 1, 1 );
+                task.failed = failed;
+                error = !failed;
+            }
+        }
+    }
+
+    if (!error && task.pyramid) {
+        // CONCURRENCY NOTE: Each row reads only the data array and shared ray
+        // directions, keeps its own scratch space, and writes only its own
+        // sky view factors, so rows are processed in parallel with results
+        // identical to a single thread.
+
+        thread_pool_run( nrows, 1, sky_view_rows_task, &task );
+
+        error = memchr( failed, 1, nrows ) != NULL;
+    } else if (!error) {
+        // Rays reach at most nsteps pixels, so a halo one pixel wider keeps
+        // every tile's rays (and its stops at row & column 0) as for the
+        // whole array, and results are identical.
+
+        error = process_raster_tiles( data, skyview, nrows, ncols,
+                                      SKY_VIEW_TILE_ROWS, SKY_VIEW_TILE_COLS, nsteps + 1,
+                                      sky_view_tile, &task );
+    }
+
+    free_elevation_pyramid( &pyramid );
+    free( dir_x );
+    free( dir_y );
+    free( dir_d );
+    free( stencils );
+    free( failed );
+
+    return error;
+}
+
+// Parameters shared by all rows for multiscale sky view factor
+typedef struct {
+    const float *data;
+    float       *skyview;
+    int    nrows;
+    int    ncols;
+    int    num_angles;
+    double tolerance;           // largest block size per unit distance
+    double min_slope;           // ignore horizons at or below this slope
+    const double *dir_x;        // ray step in columns, for each direction
+    const double *dir_y;        // ray step in rows,    for each direction
+    const double *dir_d;        // length of ray step,  for each direction
+    const double *dir_k;        // ray steps to search, for each direction
+    const Elevation_Pyramid
+          *pyramid;             // block maxima of data
+} Multiscale_Task;
+
+static double multiscale_high_slope(
+    const float *data, int nrows, int ncols, const Elevation_Pyramid *pyramid,
+    int row, int col, double dx, double dy, double step_dist, double max_steps,
+    double tolerance )
+// Marches a ray from the center of pixel (row, col), sampling at step k the
+// maximum of the largest pyramid block no wider than tolerance * k pixels, and
+// stepping one block width at a time. Returns the highest slope found.
+{
+    double base_zval = data[(LONG)row * (LONG)ncols + col];
+    double top_zval  = pyramid->max[pyramid->nlevels][0] - base_zval;
+    double high      = -HUGE_VAL;
+    double k         = 1.0;
+    double size      = 1.0;     // block width at current level, in pixels
+    int    level     = 0;
+
+    while (k <= max_steps) {
+        double x = (double)col + 0.5 + k * dx;
+        double y = (double)row + 0.5 + k * dy;
+        double slope;
+
+        if (x < 0.0 || y < 0.0 || x >= (double)ncols || y >= (double)nrows) {
+            break;  // ray has left the array
+        }
+        if (top_zval <= high * k * step_dist) {
+            break;  // nothing farther can be higher
+        }
+
+        while (level < pyramid->nlevels && 2.0 * size <= tolerance * k) {
+            ++level;
+            size *= 2.0;
+        }
+
+        slope = (PYRAMID_MAX( pyramid, level, (int)y, (int)x ) - base_zval) / (k * step_dist);
+        if (slope > high) {
+            high = slope;
+        }
+
+        k += size;
+    }
+
+    return high;
+}
+
+// Thread_Pool_Task computing multiscale sky view factors for rows begin..end-1
+static void multiscale_rows_task( void *state, long begin, long end )
+{
+    Multiscale_Task *task = (Multiscale_Task *)state;
+
+    long i;
+    int  j, a;
+
+    for (i=begin; i<end; i++) {
+        float *ptr2 = task->skyview + (LONG)i * (LONG)task->ncols;
+
+        for (j=0; j<task->ncols; j++) {
+            double high_sum   = 0.0;
+            int    high_count = 0;
+
+            for (a=0; a<task->num_angles; a++) {
+                double slope = multiscale_high_slope(
+                    task->data, task->nrows, task->ncols, task->pyramid, (int)i, j,
+                    task->dir_x[a], task->dir_y[a], task->dir_d[a], task->dir_k[a],
+                    task->tolerance );
+
+                // sin( atan( slope ) ) without trig
+                if (slope > task->min_slope) {
+                    high_count++;
+                    high_sum += slope / sqrt( 1.0 + slope * slope );
+                }
+            }
+
+            ptr2[j] = high_sum / high_count;
+        }
+    }
+}
+
+int multiscale_sky_view_factor(
+    const float *data, float *skyview, int nrows, int ncols,
+    double xdim, double ydim, int num_angles, double max_dist, double tolerance )
+{
+    Elevation_Pyramid pyramid = { 0 };
+
+    Multiscale_Task task;
+
+    double *dir_x = (double *)malloc( num_angles * sizeof( double ) );
+    double *dir_y = (double *)malloc( num_angles * sizeof( double ) );
+    double *dir_d = (double *)malloc( num_angles * sizeof( double ) );
+    double *dir_k = (double *)malloc( num_angles * sizeof( double ) );
+
+    int error = 0;
+    int a;
+
+    if (!dir_x || !dir_y || !dir_d || !dir_k) {
+        error = 1;
+    }
+
+    if (!error) {
+        error = build_elevation_pyramid( &pyramid, data, nrows, ncols, 0 );
+    }
+
+    // Direction of each ray, as for sky_view_factor()
+
+    for (a=0; a<num_angles && !error; a++) {
+        double this_angle = deg2rad(fix_azimuth(a*360/num_angles, xdim, ydim)); // Fix azimuth
+        dir_x[a] = sin(this_angle);
+        dir_y[a] = cos(this_angle);
+        dir_d[a] = sqrt(xdim*xdim*dir_x[a]*dir_x[a]+ydim*ydim*dir_y[a]*dir_y[a]);
+
+        // steps are at most one pixel long, so this reaches any edge
+        dir_k[a] = (double)nrows + (double)ncols;
+        if (max_dist > 0.0 && max_dist / dir_d[a] < dir_k[a]) {
+            dir_k[a] = max_dist / dir_d[a];
+        }
+    }
+
+    if (!error) {
+        task.data       = data;
+        task.skyview    = skyview;
+        task.nrows      = nrows;
+        task.ncols      = ncols;
+        task.num_angles = num_angles;
+        task.tolerance  = tolerance;
+        task.min_slope  = tan( deg2rad(-70) );  // ignore horizons at or below -70 degrees
+        task.dir_x      = dir_x;
+        task.dir_y      = dir_y;
+        task.dir_d      = dir_d;
+        task.dir_k      = dir_k;
+        task.pyramid    = &pyramid;
+
+        // CONCURRENCY NOTE: Each row reads only the data array, the pyramid, and
+        // shared ray directions, and writes only its own sky view factors, so
+        // rows are processed in parallel with results identical to a single thread.
+
+        thread_pool_run( nrows, 1, multiscale_rows_task, &task );
+    }
+
+    free_elevation_pyramid( &pyramid );
+    free( dir_x );
+    free( dir_y );
+    free( dir_d );
+    free( dir_k );
+
+    return error;
+}
+
+// Parameters shared by all sweep lines for one azimuth
+typedef struct {
+    const float *data;
+    float       *slopes;    // output: horizon slope of each pixel
+    int    nmajor;          // number of pixels along major axis
+    int    nminor;          // number of pixels along minor axis
+    LONG   major_stride;    // array index increment per pixel along major axis
+    LONG   minor_stride;    // array index increment per pixel along minor axis
+    int    first_line;      // number of first sweep line
+    int    look_dir;        // +1 or -1: direction of azimuth along major axis
+    double slope;           // minor pixels per major pixel along azimuth
+    double step_dist;       // distance per pixel along major axis
+    int    window;          // number of pixels searched ahead of each point
+    int    levels;          // number of jump pointer levels for window
+    char  *failed;          // per line: set nonzero if the chunk starting there failed
+} Sweep_Task;
+
+static INLINE int steeper( const double *z, int k, int a, int b )
+// true if point a (ahead of point k) is at a higher elevation angle from k than point b
+{
+    return (z[a] - z[k]) * (double)(k - b) > (z[b] - z[k]) * (double)(k - a);
+}
+
+static void build_suffix_hulls(
+    const double *z, int *stack, int *jump, int window, int levels, int first, int last )
+// For each point q of block first..last-1, finds the next vertex after q of the
+// upper convex hull of points q..last-1, as jump[q-first], and the (2^j)th next
+// vertex as jump[j*window+q-first]; -1 if there is none
+{
+    int top = 0;
+    int q, j;
+
+    for (q=last-1; q>=first; --q) {
+        while (top >= 2) {
+            int t = stack[top-1];
+            int s = stack[top-2];
+            if ((z[t] - z[q]) * (double)(s - q) > (z[s] - z[q]) * (double)(t - q)) {
+                break;  // t is above the line from q to s
+            }
+            --top;
+        }
+        jump[q-first] = top ? stack[top-1] : -1;
+        stack[top++] = q;
+
+        for (j=1; j<levels; ++j) {
+            int mid = jump[(j-1)*window+q-first];
+            jump[j*window+q-first] = mid < 0 ? -1 : jump[(j-1)*window+mid-first];
+        }
+    }
+}
+
+static int suffix_tangent(
+    const double *z, const int *jump, int window, int levels, int first, int start, int k )
+// Finds the point of block first..first+window-1 at the highest elevation angle from
+// point k (beyond the block), among points start..first+window-1, using the hulls
+// from build_suffix_hulls(). Angles from k rise then fall along the hull, so the
+// last vertex followed by a steeper one is found by binary lifting.
+{
+    int u = start;
+    int next = jump[u-first];
+    int j;
+
+    if (next < 0 || !steeper( z, k, next, u )) {
+        return u;
+    }
+
+    for (j=levels-1; j>=0; --j) {
+        int v = jump[j*window+u-first];
+        if (v >= 0) {
+            int w = jump[v-first];
+            if (w >= 0 && steeper( z, k, w, v )) {
+                u = v;
+            }
+        }
+    }
+
+    return jump[u-first];
+}
+
+// Thread_Pool_Task computing horizons for sweep lines first_line+begin..first_line+end-1
+static void sweep_lines_task( void *state, long begin, long end )
+{
+    const Sweep_Task *task = (const Sweep_Task *)state;
+
+    int window = task->window;
+    int levels = task->levels;
+
+    LONG   *index = (LONG   *)malloc( task->nmajor * sizeof( LONG   ) );
+    double *z     = (double *)malloc( task->nmajor * sizeof( double ) );
+    int    *hull  = (int    *)malloc( task->nmajor * sizeof( int    ) );
+    int    *jump  = (int    *)malloc( window < task->nmajor ?
+                                          (LONG)levels * window * sizeof( int ) : sizeof( int ) );
+
+    long line;
+
+    if (!index || !z || !hull || !jump) {
+        free( index );
+        free( z );
+        free( hull );
+        free( jump );
+        task->failed[begin] = 1;    // each chunk writes only its own flag
+        return;
+    }
+
+    // Sweep line number "line" passes through minor = line + floor( slope * major + 0.5 ),
+    // as for cast shadows; distances are measured along the major axis.
+
+    for (line=task->first_line+begin; line<task->first_line+end; ++line) {
+        int length = 0;
+        int major  = task->look_dir > 0 ? task->nmajor - 1 : 0;    // start at far end
+        int first, k;
+
+        for (; major>=0 && major<task->nmajor; major-=task->look_dir) {
+            int minor = line + (int)floor( task->slope * (double)major + 0.5 );
+            if (minor >= 0 && minor < task->nminor) {
+                index[length] = (LONG)major * task->major_stride + (LONG)minor * task->minor_stride;
+                z[length] = task->data[index[length]];
+                ++length;
+            } else if (length) {
+                break;  // line has left the array
+            }
+        }
+
+        // The line is split into blocks of window points. The points within the
+        // window ahead of point k are those of its own block before it, plus a
+        // suffix of the previous block.
+        //
+        // Within a block, the horizon is the steepest point of the upper convex
+        // hull of the points before k. Points below the hull can never be on the
+        // horizon of a later point of the block either, so each point is pushed
+        // and popped at most once. The hulls of all suffixes of the previous
+        // block are kept as a tree of next-vertex links, searched in O(log window).
+
+        for (first=0; first<length; first+=window) {
+            int last = first + window < length ? first + window : length;
+            int top  = 0;
+
+            for (k=first; k<last; ++k) {
+                double best = -HUGE_VAL;
+
+                while (top >= 2) {
+                    int t = hull[top-1];
+                    int s = hull[top-2];
+                    if ((z[t] - z[k]) * (double)(k - s) > (z[s] - z[k]) * (double)(k - t)) {
+                        break;  // t is above the line from this point to s
+                    }
+                    --top;
+                }
+                if (top) {
+                    int t = hull[top-1];
+                    best = (z[t] - z[k]) / (double)(k - t);
+                }
+                hull[top++] = k;
+
+                if (first > 0) {
+                    int t = suffix_tangent( z, jump, window, levels, first - window, k - window, k );
+                    double s = (z[t] - z[k]) / (double)(k - t);
+                    if (s > best) {
+                        best = s;
+                    }
+                }
+
+                task->slopes[index[k]] = (float)(best / task->step_dist);
+            }
+
+            if (last < length) {
+                build_suffix_hulls( z, hull, jump, window, levels, first, last );
+            }
+        }
+    }
+
+    free( index );
+    free( z );
+    free( hull );
+    free( jump );
+}
+
+static int sweep_direction(
+    const float *data, float *slopes, int nrows, int ncols,
+    double dx, double dy, double max_dist )
+// As sweep_horizons(), for the direction of dx columns and dy rows per unit distance
+{
+    Sweep_Task task;
+
+    int    major_is_col = fabs( dx ) >= fabs( dy );
+    double step         = major_is_col ? dx : dy;
+    double minor_step   = major_is_col ? dy : dx;
+
+    int last_line;
+    int shift_end;
+    int error;
+
+    task.data         = data;
+    task.slopes       = slopes;
+    task.nmajor       = major_is_col ? ncols : nrows;
+    task.nminor       = major_is_col ? nrows : ncols;
+    task.major_stride = major_is_col ? 1 : ncols;
+    task.minor_stride = major_is_col ? ncols : 1;
+    task.look_dir     = step > 0.0 ? 1 : -1;
+    task.slope        = fabs( minor_step / step ) < 1e-12 ? 0.0 : minor_step / step;
+    task.step_dist    = 1.0 / fabs( step );
+
+    // window is at least one pixel, and at most the whole line (no distance limit)
+    task.window = task.nmajor;
+    if (max_dist > 0.0 && max_dist < task.step_dist * (double)task.nmajor) {
+        task.window = (int)floor( max_dist / task.step_dist );
+        if (task.window < 1) {
+            task.window = 1;
+        }
+    }
+    task.levels = 1;
+    while (task.levels < 31 && (1 << task.levels) < task.window) {
+        ++task.levels;
+    }
+
+    shift_end = (int)floor( task.slope * (double)(task.nmajor - 1) + 0.5 );
+    task.first_line = -(shift_end > 0 ? shift_end : 0);
+    last_line = task.nminor - 1 - (shift_end < 0 ? shift_end : 0);
+
+    task.failed = (char *)calloc( last_line - task.first_line + 1, 1 );
+    if (!task.failed) {
+        return 1;
+    }
+
+    // CONCURRENCY NOTE: Each sweep line writes only its own pixels, so lines
+    // are processed in parallel with results independent of the thread count.
+
+    thread_pool_run( last_line - task.first_line + 1, 16, sweep_lines_task, &task );
+
+    error = memchr( task.failed, 1, last_line - task.first_line + 1 ) != NULL;
+
+    free( task.failed );
+
+    return error;
+}
+
+int sweep_horizons(
+    const float *data, float *slopes, int nrows, int ncols,
+    double xdim, double ydim, double azimuth, double max_dist )
+{
+    double az = deg2rad( azimuth );
+
+    // Pixel steps per unit distance toward azimuth (rows increase southward)
+    return sweep_direction( data, slopes, nrows, ncols,
+                            sin( az ) / fabs( xdim ), -cos( az ) / fabs( ydim ), max_dist );
+}
+
+int sweep_sky_view_factor(
+    const float *data, float *skyview, int nrows, int ncols,
+    double xdim, double ydim, int num_angles, double max_dist )
+{
+    LONG size = (LONG)nrows * (LONG)ncols;
+
+    double min_slope = tan( deg2rad(-70) );     // ignore horizons at or below -70 degrees
+
+    double *high_sum   = (double *)malloc( size * sizeof( double ) );
+    int    *high_count = (int    *)malloc( size * sizeof( int    ) );
+    float  *slopes     = (float  *)malloc( size * sizeof( float  ) );
+
+    int  error = 0;
+    int  a;
+    LONG n;
+
+    if (!high_sum || !high_count || !slopes) {
+        error = 1;
+    }
+
+    for (n=0; n<size && !error; ++n) {
+        high_sum[n]   = 0.0;
+        high_count[n] = 0;
+    }
+
+    // Same directions as sky_view_factor(): azimuths corrected for the pixel
+    // aspect ratio by fix_azimuth(), stepping +row at azimuth 0
+
+    for (a=0; a<num_angles && !error; a++) {
+        double this_angle = deg2rad(fix_azimuth(a*360/num_angles, xdim, ydim));
+        double dir_x = sin(this_angle);
+        double dir_y = cos(this_angle);
+        double dir_d = sqrt(xdim*xdim*dir_x*dir_x+ydim*ydim*dir_y*dir_y);
+
+        error = sweep_direction(
+            data, slopes, nrows, ncols, dir_x / dir_d, dir_y / dir_d, max_dist );
+
+        // sin( atan( slope ) ) without trig
+        for (n=0; n<size && !error; ++n) {
+            double slope = slopes[n];
+            if (slope > min_slope) {
+                high_count[n]++;
+                high_sum[n] += slope / sqrt( 1.0 + slope * slope );
+            }
+        }
+    }
+
+    for (n=0; n<size && !error; ++n) {
+        skyview[n] = high_sum[n] / high_count[n];
+    }
+
+    free( high_sum );
+    free( high_count );
+    free( slopes );
+
+    return error;
+}
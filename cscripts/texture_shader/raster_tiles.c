@@ -0,0 +1,182 @@
+/*
+ * raster_tiles.c
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "raster_tiles.h"
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // for ptrdiff_t
+
+#define LONG ptrdiff_t
+
+// Parameters shared by all tiles
+typedef struct {
+    const float *data;
+    float       *result;
+    int    nrows;
+    int    ncols;
+    int    tile_nrows;
+    int    tile_ncols;
+    int    halo;
+    int    tiles_per_row;       // number of tiles across the raster
+    Raster_Tile_Operator op;
+    void  *state;
+    char  *failed;              // per tile: set nonzero if the chunk starting there failed
+} Tiles_Task;
+
+// Thread_Pool_Task processing tiles begin..end-1 (numbered across, then down)
+static void tiles_task( void *state, long begin, long end )
+{
+    Tiles_Task *task = (Tiles_Task *)state;
+
+    // scratch space for the largest tile and halo, private to this call
+    LONG max_rows = task->tile_nrows + 2 * (LONG)task->halo;
+    LONG max_cols = task->tile_ncols + 2 * (LONG)task->halo;
+    LONG size     = (max_rows < task->nrows ? max_rows : task->nrows) *
+                    (max_cols < task->ncols ? max_cols : task->ncols);
+
+    float *in  = (float *)malloc( size * sizeof( float ) );
+    float *out = (float *)malloc( size * sizeof( float ) );
+
+    long n;
+    int  i;
+
+    if (!in || !out) {
+        free( in );
+        free( out );
+        task->failed[begin] = 1;    // each chunk writes only its own flag
+        return;
+    }
+
+    for (n=begin; n<end; ++n) {
+        Raster_Tile tile;
+
+        int first_row = (int)(n / task->tiles_per_row) * task->tile_nrows;
+        int first_col = (int)(n % task->tiles_per_row) * task->tile_ncols;
+        int last_row  = first_row + task->tile_nrows;   // one past end
+        int last_col  = first_col + task->tile_ncols;   // one past end
+
+        if (last_row > task->nrows) {
+            last_row = task->nrows;
+        }
+        if (last_col > task->ncols) {
+            last_col = task->ncols;
+        }
+
+        // extend by halo, clipped to the raster
+        tile.row0  = first_row > task->halo ? first_row - task->halo : 0;
+        tile.col0  = first_col > task->halo ? first_col - task->halo : 0;
+        tile.nrows = (task->nrows - last_row > task->halo ? last_row + task->halo : task->nrows) - tile.row0;
+        tile.ncols = (task->ncols - last_col > task->halo ? last_col + task->halo : task->ncols) - tile.col0;
+
+        tile.row_begin = first_row - tile.row0;
+        tile.row_end   = last_row  - tile.row0;
+        tile.col_begin = first_col - tile.col0;
+        tile.col_end   = last_col  - tile.col0;
+        tile.in        = in;
+        tile.out       = out;
+
+        for (i=0; i<tile.nrows; ++i) {
+            memcpy( in + (LONG)i * tile.ncols,
+                    task->data + (LONG)(tile.row0 + i) * task->ncols + tile.col0,
+                    tile.ncols * sizeof( float ) );
+        }
+
+        if (task->op( task->state, &tile )) {
+            task->failed[begin] = 1;
+            break;
+        }
+
+        for (i=tile.row_begin; i<tile.row_end; ++i) {
+            memcpy( task->result + (LONG)(tile.row0 + i) * task->ncols + first_col,
+                    out + (LONG)i * tile.ncols + tile.col_begin,
+                    (last_col - first_col) * sizeof( float ) );
+        }
+    }
+
+    free( in );
+    free( out );
+}
+
+int process_raster_tiles(
+    const float *data, float *result, int nrows, int ncols,
+    int tile_nrows, int tile_ncols, int halo, Raster_Tile_Operator op, void *state )
+{
+    Tiles_Task task;
+
+    long num_tiles;
+    int  tiles_per_col;
+    int  error;
+
+    // no tile need be larger than the raster
+    if (tile_nrows > nrows) {
+        tile_nrows = nrows;
+    }
+    if (tile_ncols > ncols) {
+        tile_ncols = ncols;
+    }
+
+    task.data          = data;
+    task.result        = result;
+    task.nrows         = nrows;
+    task.ncols         = ncols;
+    task.tile_nrows    = tile_nrows;
+    task.tile_ncols    = tile_ncols;
+    task.halo          = halo;
+    task.tiles_per_row = (ncols + tile_ncols - 1) / tile_ncols;
+    task.op            = op;
+    task.state         = state;
+
+    tiles_per_col = (nrows + tile_nrows - 1) / tile_nrows;
+    num_tiles     = (long)tiles_per_col * task.tiles_per_row;
+
+    task.failed = (char *)calloc( num_tiles + 1, 1 );
+    if (!task.failed) {
+        return 1;
+    }
+
+    // CONCURRENCY NOTE: Each tile reads only the data array and its own
+    // scratch space, and writes only its own part of the result array, so
+    // tiles are processed in parallel with results identical to a single
+    // thread. The operator runs within a pool thread, so any parallel loops
+    // of its own run on that thread alone.
+
+    thread_pool_run( num_tiles, 1, tiles_task, &task );
+
+    error = memchr( task.failed, 1, num_tiles ) != NULL;
+
+    free( task.failed );
+
+    return error;
+}
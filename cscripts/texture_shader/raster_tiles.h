@@ -0,0 +1,93 @@
+/*
+ * raster_tiles.h
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Processing of a raster in rectangular tiles, each extended by a halo of
+// surrounding pixels as wide as the reach of a local operator (one whose result
+// at each pixel depends only on data within that distance). Each tile and its
+// halo is copied into a compact array, so the operator works within a small
+// region of memory however wide the raster is, and tiles run in parallel.
+//
+
+#ifndef RASTER_TILES_H
+#define RASTER_TILES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One tile of a raster, as passed to a Raster_Tile_Operator. The in and out
+// arrays cover the tile and its halo, clipped to the edges of the raster, so
+// an operator may treat them as a whole raster in which only rows
+// row_begin..row_end-1 and columns col_begin..col_end-1 need results.
+typedef struct {
+    const float *in;    // input  values of tile and halo (row-major order)
+    float       *out;   // output values of tile and halo (row-major order)
+    int  nrows;         // number of rows    in in & out arrays
+    int  ncols;         // number of columns in in & out arrays
+    int  row_begin;     // first row    of tile proper in in & out arrays
+    int  row_end;       // one past last row    of tile proper
+    int  col_begin;     // first column of tile proper in in & out arrays
+    int  col_end;       // one past last column of tile proper
+    int  row0;          // row    of whole raster at row    0 of in & out arrays
+    int  col0;          // column of whole raster at column 0 of in & out arrays
+} Raster_Tile;
+
+// Function to compute the results of one tile; returns 0 on success, nonzero
+// on error. Called from several threads at once, with different tiles.
+typedef int (*Raster_Tile_Operator)(
+    void              *state,   // copy of state pointer passed to process_raster_tiles()
+    const Raster_Tile *tile );  // tile to process
+
+// Computes result from data one tile at a time, each tile of at most
+// tile_nrows by tile_ncols pixels with a halo of halo pixels on every side.
+// Results are independent of the thread count, and identical to processing
+// the raster as a single tile if the operator's reach is within the halo.
+// Runs on the threads of thread_pool.h.
+// Returns 0 on success, nonzero if a memory allocation error occurred or
+// the operator returned an error.
+int process_raster_tiles(
+    const float *data,  // input:  array of values (row-major order)
+    float *result,      // output: array of results (row-major order)
+    int    nrows,       // input:  number of rows    in data & result arrays
+    int    ncols,       // input:  number of columns in data & result arrays
+    int    tile_nrows,  // input:  number of rows    per tile (not counting halo)
+    int    tile_ncols,  // input:  number of columns per tile (not counting halo)
+    int    halo,        // input:  width of halo around each tile (in pixels)
+    Raster_Tile_Operator
+           op,          // input:  function to compute results of a tile
+    void  *state        // input:  pointer passed to op()
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
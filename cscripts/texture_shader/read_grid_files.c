@@ -34,13 +34,29 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "read_grid_files.h"
+#include "thread_pool.h"
 
 #include <stddef.h> // for ptrdiff_t
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include <math.h>
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define GRID_SSE2 1
+#else
+#   define GRID_SSE2 0
+#endif
+
+#if !defined( _WIN32 ) && !defined( NO_MMAP )
+#   define USE_MMAP
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
 // For a 64-bit compile we need LONG to be 64 bits, even if the compiler uses an LLP64 model
 #define LONG ptrdiff_t
 
@@ -149,16 +165,17 @@ static void read_hdr_file(
     FILE *in_hdr_file, int *nrows, int *ncols,
     double *xmin, double *xmax, double *ymin, double *ymax,
     float *nodata, int *big_endian, int *skipbytes, int *rowpad,
-    char **software );
+    int *nbits, int *is_signed, char **software );
 
+// nbits = 32 for floats, or 8 or 16 for integers (signed if is_signed is nonzero)
 static float *read_flt_file(
     FILE *in_flt_file, int nrows, int ncols,
     float nodata, int big_endian, int skipbytes, int rowpad,
-    int *has_nulls, int *all_ints );
+    int nbits, int is_signed, int *has_nulls, int *all_ints );
 
 float *read_flt_hdr_files(
     // returns allocated array of data values;
-    // NOTE: caller is responsible to free this pointer!
+    // NOTE: caller is responsible to free this pointer with free_flt_data()!
     FILE *in_flt_file,  // .flt file - should be opened in BINARY mode
     FILE *in_hdr_file,  // .hdr file - should be opened in BINARY mode
     int *nrows,         // number of rows in data array
@@ -178,18 +195,20 @@ float *read_flt_hdr_files(
     int big_endian;
     int skipbytes;
     int rowpad;
+    int nbits;
+    int is_signed;
 
     // Read and validate .hdr file:
 
     read_hdr_file(
         in_hdr_file, nrows, ncols, xmin, xmax, ymin, ymax,
-        &nodata, &big_endian, &skipbytes, &rowpad, software );
+        &nodata, &big_endian, &skipbytes, &rowpad, &nbits, &is_signed, software );
 
     // Read data from .flt file:
 
     return read_flt_file(
         in_flt_file, *nrows, *ncols, nodata, big_endian, skipbytes, rowpad,
-        has_nulls, all_ints );
+        nbits, is_signed, has_nulls, all_ints );
 }
 
 #define MAXLINE 80
@@ -198,7 +217,7 @@ static void read_hdr_file(
     FILE *in_hdr_file, int *nrows, int *ncols,
     double *xmin, double *xmax, double *ymin, double *ymax,
     float *nodata, int *big_endian, int *skipbytes, int *rowpad,
-    char **software )
+    int *nbits, int *is_signed, char **software )
 {
     char line   [MAXLINE+3];    // add 3 for possible "\r\n\0" terminators
     char keyword[MAXLINE+3];
@@ -219,6 +238,9 @@ static void read_hdr_file(
     int ycoord_type = 0;
     int bandrow  = 0;
     int totalrow = 0;
+    int pixeltype   = 0;  // 1 = signed int, 2 = unsigned int, 3 = float, 0 = unspecified
+    int number_bits = 0;  // bits per value from NUMBERTYPE, or 0 if unspecified
+    int number_sign = 0;  // nonzero if NUMBERTYPE is a signed integer
 
     // Read .hdr file:
 
@@ -227,6 +249,8 @@ static void read_hdr_file(
     *nrows = 0;
     *nodata = -3.40282347e+38;
     *skipbytes = 0;
+    *nbits = 0;
+    *is_signed = 0;
     if (software) {
         *software = 0;
     }
@@ -290,12 +314,12 @@ static void read_hdr_file(
                     bad_value_exit( line, "1" );
                 }
             } else if (strcmp( keyword, "nbits" ) == 0) {
-                read_int( line, pos, &intval );
-                if (intval == 8 ||
-                    intval == 16 ||
-                    intval != 32)
+                read_int( line, pos, nbits );
+                if (*nbits != 8 &&
+                    *nbits != 16 &&
+                    *nbits != 32)
                 {
-                    bad_value_exit( line, "32" );
+                    bad_value_exit( line, "8, 16, or 32" );
                 }
             } else if (strcmp( keyword, "skipbytes" ) == 0) {
                 read_int( line, pos, skipbytes );
@@ -347,22 +371,28 @@ static void read_hdr_file(
                 if (strcmp( strval, "1_byte_integer" ) == 0 ||
                     strcmp( strval, "byte" ) == 0)
                 {
-                    bad_value_exit( line, NULL );
+                    number_bits = 8;
+                    number_sign = 0;
                 } else if (strcmp( strval, "2_byte_integer" ) == 0) {
-                    bad_value_exit( line, NULL );
-                } else if (strcmp( strval, "4_byte_float" ) != 0) {
+                    number_bits = 16;
+                    number_sign = 1;
+                } else if (strcmp( strval, "4_byte_float" ) == 0) {
+                    number_bits = 32;
+                } else {
                     bad_value_exit( line, NULL );
                 }
             } else if (strcmp( keyword, "pixeltype" ) == 0) {
                 read_string( line, pos, strval );
                 if (strcmp( strval, "signedint" ) == 0) {
-                    bad_value_exit( line, NULL );
+                    pixeltype = 1;
                 } else if (strcmp( strval, "unsignedint" ) == 0) {
-                    bad_value_exit( line, NULL );
+                    pixeltype = 2;
                 } else if
-                    (strcmp( strval, "float" ) != 0 &&
-                     strcmp( strval, "floatingpoint" ) != 0)
+                    (strcmp( strval, "float" ) == 0 ||
+                     strcmp( strval, "floatingpoint" ) == 0)
                 {
+                    pixeltype = 3;
+                } else {
                     bad_value_exit( line, NULL );
                 }
             } else if (strcmp( keyword, "offset" ) == 0) {  // OFFSET ignored
@@ -410,14 +440,34 @@ static void read_hdr_file(
         error_exit( "Input .hdr file does not specify NROWS." );
     }
     
-    if (bandrow && bandrow != 4 * (*ncols)) {
+    // Data type: 32-bit float unless NBITS or NUMBERTYPE says otherwise;
+    // integers are unsigned unless PIXELTYPE or NUMBERTYPE says otherwise
+
+    if (!*nbits) {
+        *nbits = number_bits ? number_bits : 32;
+    } else if (number_bits && number_bits != *nbits) {
+        error_exit( "Input .hdr file has NBITS inconsistent with NUMBERTYPE." );
+    }
+
+    if (*nbits == 32) {
+        if (pixeltype == 1 || pixeltype == 2) {
+            error_exit( "Input .hdr file specifies 32-bit integers (only 32-bit floats supported)." );
+        }
+    } else {
+        if (pixeltype == 3) {
+            error_exit( "Input .hdr file specifies floats with NBITS other than 32." );
+        }
+        *is_signed = pixeltype == 1 || (pixeltype == 0 && number_sign);
+    }
+
+    if (bandrow && bandrow != (*nbits / 8) * (*ncols)) {
         prefix_error();
         fprintf( stderr, "Input .hdr file contains unsupported value for BANDROWBYTES\n" );
-        fprintf( stderr, "(expected 4 x NCOLS).\n" );
+        fprintf( stderr, "(expected NBITS / 8 x NCOLS).\n" );
         exit( EXIT_FAILURE );
     }
     
-    bandrow = 4 * (*ncols);
+    bandrow = (*nbits / 8) * (*ncols);
     
     if (totalrow) {
         *rowpad = totalrow - bandrow;
@@ -428,7 +478,7 @@ static void read_hdr_file(
     if (*rowpad < 0) {
         prefix_error();
         fprintf( stderr, "Input .hdr file contains bad value for TOTALROWBYTES\n" );
-        fprintf( stderr, "(expected at least 4 x NCOLS).\n" );
+        fprintf( stderr, "(expected at least NBITS / 8 x NCOLS).\n" );
         exit( EXIT_FAILURE );
     }
     
@@ -534,28 +584,378 @@ void copy_prj_file( FILE *in_prj_file, FILE *out_prj_file )
     }
 }
 
-static float *read_flt_file(
-    FILE *in_flt_file, int nrows, int ncols,
-    float nodata, int big_endian, int skipbytes, int rowpad,
-    int *has_nulls, int *all_ints )
+static float void_value = 0.0f;  // stored for nodata points; see keep_flt_voids()
+
+void keep_flt_voids( int keep )
+{
+    void_value = keep ? (float)NAN : 0.0f;
+}
+
+static void scan_row(
+    float *ptr, int ncols, float nodata, int reverse_bytes,
+    int *has_nans, int *has_nulls, int *all_ints )
+// Reverses the byte order of one row of data if reverse_bytes is nonzero,
+// checks it for NaNs, sets nodata values to void_value, and clears *all_ints
+// if any other value is not an integer - all in one pass. If nodata is NaN (as from
+// GDAL_NODATA "nan"), NaNs are the nodata values.
 {
     union {
         float f;
         char c[4];
     } pun;
 
+    char temp;
+    int  j = 0;
+
+    int nan_nodata = flt_isnan( nodata );
+
+#if GRID_SSE2
+    const __m128  nodata4 = _mm_set1_ps( nodata );
+    const __m128  lowest4 = _mm_set1_ps( -1.0e+38f );
+    const __m128  big4    = _mm_set1_ps( 8388608.0f );  // 2^23: larger floats are integers
+    const __m128  abs4    = _mm_castsi128_ps( _mm_set1_epi32( 0x7FFFFFFF ) );
+    const __m128  void4   = _mm_set1_ps( void_value );
+
+    int nans  = 0;
+    int nulls = 0;
+    int fracs = 0;
+
+    for (; j+4<=ncols; j+=4) {
+        __m128 x = _mm_loadu_ps( ptr + j );
+        __m128 null, whole;
+
+        if (reverse_bytes) {
+            // swap bytes within 16-bit halves, then swap the halves
+            __m128i v = _mm_castps_si128( x );
+            v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+            v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+            v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+            x = _mm_castsi128_ps( v );
+        }
+
+        null = _mm_or_ps( _mm_cmpeq_ps( x, nodata4 ), _mm_cmplt_ps( x, lowest4 ) );
+        if (nan_nodata) {
+            null = _mm_or_ps( null, _mm_cmpunord_ps( x, x ) );
+        } else {
+            nans |= _mm_movemask_ps( _mm_cmpunord_ps( x, x ) );
+        }
+        nulls |= _mm_movemask_ps( null );
+        x = _mm_andnot_ps( null, x );
+
+        // integer if it survives truncation to int (or is too large to have a fraction)
+        whole = _mm_or_ps( _mm_cmpeq_ps( _mm_cvtepi32_ps( _mm_cvttps_epi32( x ) ), x ),
+                           _mm_cmpge_ps( _mm_and_ps( x, abs4 ), big4 ) );
+        fracs |= _mm_movemask_ps( whole ) ^ 0xF;
+
+        // voids were zeroed for the integer test; now store void_value there
+        _mm_storeu_ps( ptr + j, _mm_or_ps( x, _mm_and_ps( null, void4 ) ) );
+    }
+
+    if (nans) {
+        *has_nans = 1;
+    }
+    if (nulls) {
+        *has_nulls = 1;
+    }
+    if (fracs) {
+        *all_ints = 0;
+    }
+#endif
+
+    for (; j<ncols; ++j) {
+        if (reverse_bytes) {
+            pun.f = ptr[j];
+            temp = pun.c[0];
+            pun.c[0] = pun.c[3];
+            pun.c[3] = temp;
+            temp = pun.c[1];
+            pun.c[1] = pun.c[2];
+            pun.c[2] = temp;
+            ptr[j] = pun.f;
+        }
+        if (flt_isnan( ptr[j] ) && !nan_nodata) {
+            *has_nans = 1;
+        }
+        if (ptr[j] == nodata || ptr[j] < -1.0e+38 || (nan_nodata && flt_isnan( ptr[j] ))) {
+            ptr[j] = void_value;
+            *has_nulls = 1;
+        } else if (*all_ints && ptr[j] != floor( ptr[j] )) {
+            *all_ints = 0;
+        }
+    }
+}
+
+#if GRID_SSE2
+static void store_int16s( float *ptr, __m128i v, int is_signed )
+// Stores eight 16-bit integers as floats
+{
+    __m128i lo, hi;
+
+    if (is_signed) {
+        lo = _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 );
+        hi = _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 );
+    } else {
+        lo = _mm_unpacklo_epi16( v, _mm_setzero_si128() );
+        hi = _mm_unpackhi_epi16( v, _mm_setzero_si128() );
+    }
+    _mm_storeu_ps( ptr,     _mm_cvtepi32_ps( lo ) );
+    _mm_storeu_ps( ptr + 4, _mm_cvtepi32_ps( hi ) );
+}
+#endif
+
+static void convert_row(
+    const void *raw, float *ptr, int ncols, int nbits, int is_signed, int reverse_bytes )
+// Converts one row of 8- or 16-bit integers to floats, reversing the byte
+// order of 16-bit values first if reverse_bytes is nonzero
+{
+    int j = 0;
+
+    if (nbits == 8) {
+        const unsigned char *src = (const unsigned char *)raw;
+
+#if GRID_SSE2
+        for (; j+16<=ncols; j+=16) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)(src + j) );
+            __m128i lo, hi;
+            if (is_signed) {
+                lo = _mm_srai_epi16( _mm_unpacklo_epi8( v, v ), 8 );
+                hi = _mm_srai_epi16( _mm_unpackhi_epi8( v, v ), 8 );
+            } else {
+                lo = _mm_unpacklo_epi8( v, _mm_setzero_si128() );
+                hi = _mm_unpackhi_epi8( v, _mm_setzero_si128() );
+            }
+            store_int16s( ptr + j,     lo, 1 );   // all values now fit in signed 16 bits
+            store_int16s( ptr + j + 8, hi, 1 );
+        }
+#endif
+
+        for (; j<ncols; ++j) {
+            ptr[j] = is_signed ? (float)(signed char)src[j] : (float)src[j];
+        }
+    } else {
+        const unsigned short *src = (const unsigned short *)raw;
+
+#if GRID_SSE2
+        for (; j+8<=ncols; j+=8) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)(src + j) );
+            if (reverse_bytes) {
+                v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+            }
+            store_int16s( ptr + j, v, is_signed );
+        }
+#endif
+
+        for (; j<ncols; ++j) {
+            unsigned short value = src[j];
+            if (reverse_bytes) {
+                value = (unsigned short)((value << 8) | (value >> 8));
+            }
+            ptr[j] = is_signed ? (float)(short)value : (float)value;
+        }
+    }
+}
+
+static void nan_exit()
+{
+    prefix_error();
+    fprintf( stderr, "Input .flt file contains NaNs - probably bad data" );
+    fprintf( stderr, "(or wrong .hdr file).\n" );
+    exit( EXIT_FAILURE );
+}
+
+// Flags found by one chunk of scan_rows_task()
+#define SCAN_NANS   1   // some value is NaN (other than nodata)
+#define SCAN_NULLS  2   // some value is nodata
+#define SCAN_FRACS  4   // some other value is not an integer
+
+// Parameters shared by all rows for scan_row()
+typedef struct {
+    float *data;
+    int    ncols;
+    float  nodata;
+    int    reverse_bytes;
+    char  *flags;       // per row: SCAN_ flags of the chunk starting there
+} Scan_Task;
+
+// Thread_Pool_Task scanning rows begin..end-1
+static void scan_rows_task( void *state, long begin, long end )
+{
+    const Scan_Task *task = (const Scan_Task *)state;
+
+    int has_nans  = 0;
+    int has_nulls = 0;
+    int all_ints  = 1;
+
+    long i;
+
+    for (i=begin; i<end; ++i) {
+        scan_row( task->data + (LONG)i * task->ncols, task->ncols, task->nodata, task->reverse_bytes,
+                  &has_nans, &has_nulls, &all_ints );
+    }
+
+    // each chunk writes only its own flags
+    task->flags[begin] = (char)((has_nans  ? SCAN_NANS  : 0) |
+                                (has_nulls ? SCAN_NULLS : 0) |
+                                (all_ints  ? 0 : SCAN_FRACS));
+}
+
+static void scan_rows(
+    float *data, int nrows, int ncols, float nodata, int reverse_bytes,
+    int *has_nulls, int *all_ints )
+// Applies scan_row() to every row in parallel, and exits if any has NaNs
+{
+    Scan_Task task;
+
+    int  flags = 0;
+    long i;
+
+    task.data          = data;
+    task.ncols         = ncols;
+    task.nodata        = nodata;
+    task.reverse_bytes = reverse_bytes;
+    task.flags         = (char *)calloc( nrows + 1, 1 );
+
+    if (!task.flags) {
+        error_exit( "Memory allocation error occurred while reading input data." );
+    }
+
+    // CONCURRENCY NOTE: Each row is scanned and changed only by one thread,
+    // and each chunk of rows records its flags separately, so rows are
+    // processed in parallel with results identical to a single thread.
+    // Scanning in parallel also pages a mapped file in from several threads.
+
+    thread_pool_run( nrows, 64, scan_rows_task, &task );
+
+    for (i=0; i<nrows; ++i) {
+        flags |= task.flags[i];
+    }
+
+    free( task.flags );
+
+    if (flags & SCAN_NANS) {
+        nan_exit();
+    }
+
+    *has_nulls = (flags & SCAN_NULLS) != 0;
+    *all_ints  = (flags & SCAN_FRACS) == 0;
+}
+
+#ifdef USE_MMAP
+
+// A file mapping holding an array returned by read_flt_file()
+typedef struct Flt_Mapping {
+    float              *data;   // start of data array within mapping
+    void               *base;   // start of mapping
+    size_t              length; // length of mapping in bytes
+    struct Flt_Mapping *next;
+} Flt_Mapping;
+
+static Flt_Mapping *flt_mappings = NULL;
+
+static float *map_flt_file(
+    FILE *in_flt_file, int nrows, int ncols, float nodata, int reverse_bytes, LONG skipbytes,
+    int exact_size, int *has_nulls, int *all_ints )
+// Maps a .flt file without row padding into memory, privately (so that changes
+// to the data, such as replacing nodata values or reversing byte order, copy
+// only the pages changed and never reach the file). Returns NULL if the file
+// can't be mapped, for the caller to read it instead. If exact_size is nonzero,
+// warns if the file extends past the data.
+{
+    LONG  size = (LONG)nrows * (LONG)ncols * (LONG)sizeof( float );
+    long  start;
+    char  *base;
+
+    Flt_Mapping *mapping;
+    struct stat  info;
+
+    start = ftell( in_flt_file );
+    if (start < 0 || fstat( fileno( in_flt_file ), &info ) != 0 ||
+        (start + skipbytes) % sizeof( float ) != 0 ||
+        (LONG)info.st_size < start + skipbytes + size)
+    {
+        return NULL;    // size errors are reported when reading
+    }
+
+    mapping = (Flt_Mapping *)malloc( sizeof( Flt_Mapping ) );
+    if (!mapping) {
+        error_exit( "Insufficient memory for input .flt data." );
+    }
+
+    mapping->length = (size_t)(start + skipbytes + size);
+    base = (char *)mmap( NULL, mapping->length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                         fileno( in_flt_file ), 0 );
+    if (base == (char *)MAP_FAILED) {
+        free( mapping );
+        return NULL;
+    }
+
+    mapping->base = base;
+    mapping->data = (float *)(base + start + skipbytes);
+    mapping->next = flt_mappings;
+    flt_mappings  = mapping;
+
+    scan_rows( mapping->data, nrows, ncols, nodata, reverse_bytes, has_nulls, all_ints );
+
+    if (exact_size && (LONG)info.st_size > start + skipbytes + size) {
+        fprintf( stderr, "*** WARNING: " );
+        fprintf( stderr, "Input .flt file size too large - does not match .hdr info.\n" );
+    }
+
+    return mapping->data;
+}
+
+#endif
+
+void free_flt_data( float *data )
+{
+#ifdef USE_MMAP
+    Flt_Mapping **link;
+
+    for (link=&flt_mappings; *link; link=&(*link)->next) {
+        if ((*link)->data == data) {
+            Flt_Mapping *mapping = *link;
+            *link = mapping->next;
+            munmap( mapping->base, mapping->length );
+            free( mapping );
+            return;
+        }
+    }
+#endif
+
+    free( data );
+}
+
+static float *read_flt_file(
+    FILE *in_flt_file, int nrows, int ncols,
+    float nodata, int big_endian, int skipbytes, int rowpad,
+    int nbits, int is_signed, int *has_nulls, int *all_ints )
+{
     float *data;
     float *ptr;
-    int i, j;
+    void  *raw = NULL;  // one row of integers, before conversion to floats
+    int bytes = nbits / 8;
+    int i;
     int count;
     int error;
     char c;
     int reverse_bytes = ( am_big_endian() != big_endian );
-    char temp;
+    int has_nans = 0;
     
     *has_nulls = 0;
     *all_ints  = 1;
 
+#ifdef USE_MMAP
+    // Float data without row padding is used in place from the file
+    // (byte-swapped in parallel if needed)
+    if (rowpad == 0 && nbits == 32) {
+        data = map_flt_file( in_flt_file, nrows, ncols, nodata, reverse_bytes, skipbytes,
+                             1, has_nulls, all_ints );
+        if (data) {
+            return data;
+        }
+    }
+#endif
+
     // Read data from .flt file:
 
     data = (float *)malloc( (LONG)nrows * (LONG)ncols * sizeof( float ) );
@@ -564,13 +964,20 @@ static float *read_flt_file(
         error_exit( "Insufficient memory for input .flt data." );
     }
 
+    if (nbits != 32) {
+        raw = malloc( (size_t)ncols * bytes );
+        if (!raw) {
+            error_exit( "Insufficient memory for input .flt data." );
+        }
+    }
+
     error = fseek( in_flt_file, skipbytes, SEEK_CUR );
     if (error) {
         error_exit( "Read error occurred on input .flt file." );
     }
 
     for (i=0, ptr=data; i<nrows; ++i, ptr+=ncols) {
-        count = fread( ptr, sizeof( float ), ncols, in_flt_file );
+        count = fread( raw ? raw : (void *)ptr, bytes, ncols, in_flt_file );
         if (count < ncols) {
             if (feof( in_flt_file )) {
                 error_exit( "Input .flt file size too small - does not match .hdr info." );
@@ -578,33 +985,16 @@ static float *read_flt_file(
                 error_exit( "Read error occurred on input .flt file." );
             }
         }
-        
-        if (reverse_bytes) {
-            for (j=0; j<ncols; ++j) {
-                pun.f = ptr[j];
-                temp = pun.c[0];
-                pun.c[0] = pun.c[3];
-                pun.c[3] = temp;
-                temp = pun.c[1];
-                pun.c[1] = pun.c[2];
-                pun.c[2] = temp;
-                ptr[j] = pun.f;
-            }
-        }
 
-        for (j=0; j<ncols; ++j) {
-            if (flt_isnan( ptr[j] )) {
-                prefix_error();
-                fprintf( stderr, "Input .flt file contains NaNs - probably bad data" );
-                fprintf( stderr, "(or wrong .hdr file).\n" );
-                exit( EXIT_FAILURE );
-            }
-            if (ptr[j] == nodata || ptr[j] < -1.0e+38) {
-                ptr[j] = 0.0;
-                *has_nulls = 1;
-            } else if (*all_ints && ptr[j] != floor( ptr[j] )) {
-                *all_ints = 0;
-            }
+
+        if (raw) {
+            convert_row( raw, ptr, ncols, nbits, is_signed, reverse_bytes );
+            scan_row( ptr, ncols, nodata, 0, &has_nans, has_nulls, all_ints );
+        } else {
+            scan_row( ptr, ncols, nodata, reverse_bytes, &has_nans, has_nulls, all_ints );
+        }
+        if (has_nans) {
+            nan_exit();
         }
 
         error = fseek( in_flt_file, rowpad, SEEK_CUR );
@@ -619,5 +1009,768 @@ static float *read_flt_file(
         fprintf( stderr, "Input .flt file size too large - does not match .hdr info.\n" );
     }
     
+    free( raw );
+
+    return data;
+}
+
+// A block of consecutive rows read by a Flt_Reader
+typedef struct {
+    float *data;
+    int    capacity;    // number of rows allocated
+    int    first_row;   // first row held, or -1 if none
+    int    rows;        // number of rows held
+    int    has_nulls;
+    int    all_ints;
+} Flt_Block;
+
+struct Flt_Reader {
+    FILE  *file;
+    long   start;           // file position of first row
+    int    file_row;        // row at current file position
+    int    nrows;
+    int    ncols;
+    float  nodata;
+    int    reverse_bytes;
+    int    rowpad;
+    int    nbits;
+    int    is_signed;
+    void  *raw;             // one row of integers, before conversion to floats
+    int    next_row;        // first row not yet returned
+    int    front;           // index of block returned last; the other is read ahead
+    int    has_nulls;       // for rows returned so far
+    int    all_ints;        // for rows returned so far
+    int    too_large;       // nonzero if the file extends past the data
+    const char *error;      // message from a failed read ahead, or NULL
+    Flt_Block blocks[2];
+    Thread_Pool_Background *read_ahead;     // job filling the other block, or NULL
+};
+
+static const char *read_flt_block( Flt_Reader *reader, Flt_Block *block )
+// Reads rows first_row..first_row+rows-1 of block from the file. Returns NULL,
+// or an error message for the caller to report - this may run on a background
+// thread, so it must not exit.
+{
+    LONG row_bytes = (LONG)reader->ncols * (reader->nbits / 8) + reader->rowpad;
+
+    float *ptr;
+    int    has_nans = 0;
+    int    count;
+    int    i;
+    char   c;
+
+    if (block->rows > block->capacity) {
+        free( block->data );
+        block->data = (float *)malloc( (LONG)block->rows * reader->ncols * sizeof( float ) );
+        if (!block->data) {
+            block->capacity = 0;
+            return "Insufficient memory for input .flt data.";
+        }
+        block->capacity = block->rows;
+    }
+
+    if (reader->file_row != block->first_row) {
+        if (fseek( reader->file, (long)(reader->start + block->first_row * row_bytes), SEEK_SET )) {
+            return "Read error occurred on input .flt file.";
+        }
+    }
+
+    block->has_nulls = 0;
+    block->all_ints  = 1;
+
+    for (i=0, ptr=block->data; i<block->rows; ++i, ptr+=reader->ncols) {
+        count = fread( reader->raw ? reader->raw : (void *)ptr,
+                       reader->nbits / 8, reader->ncols, reader->file );
+        if (count < reader->ncols) {
+            reader->file_row = -1;
+            if (feof( reader->file )) {
+                return "Input .flt file size too small - does not match .hdr info.";
+            } else {
+                return "Read error occurred on input .flt file.";
+            }
+        }
+
+        if (reader->raw) {
+            convert_row( reader->raw, ptr, reader->ncols, reader->nbits, reader->is_signed,
+                         reader->reverse_bytes );
+            scan_row( ptr, reader->ncols, reader->nodata, 0,
+                      &has_nans, &block->has_nulls, &block->all_ints );
+        } else {
+            scan_row( ptr, reader->ncols, reader->nodata, reader->reverse_bytes,
+                      &has_nans, &block->has_nulls, &block->all_ints );
+        }
+        if (has_nans) {
+            reader->file_row = -1;
+            return "Input .flt file contains NaNs - probably bad data (or wrong .hdr file).";
+        }
+
+        if (fseek( reader->file, reader->rowpad, SEEK_CUR )) {
+            reader->file_row = -1;
+            return "Read error occurred on input .flt file.";
+        }
+    }
+
+    reader->file_row = block->first_row + block->rows;
+
+    if (reader->file_row == reader->nrows) {
+        fread( &c, 1, 1, reader->file );
+        if (!feof( reader->file )) {
+            reader->too_large = 1;  // warned by the caller
+        }
+        reader->file_row = -1;
+    }
+
+    return NULL;
+}
+
+// Thread_Pool_Job reading the block after the one returned last
+static void read_ahead_job( void *state )
+{
+    Flt_Reader *reader = (Flt_Reader *)state;
+
+    reader->error = read_flt_block( reader, &reader->blocks[1 - reader->front] );
+}
+
+Flt_Reader *open_flt_reader(
+    FILE *in_flt_file, FILE *in_hdr_file, int *nrows, int *ncols,
+    double *xmin, double *xmax, double *ymin, double *ymax, char **software )
+{
+    Flt_Reader *reader = (Flt_Reader *)malloc( sizeof( Flt_Reader ) );
+
+    int big_endian;
+    int skipbytes;
+    int k;
+
+    if (!reader) {
+        error_exit( "Insufficient memory for input .flt data." );
+    }
+
+    // Read and validate .hdr file:
+
+    read_hdr_file(
+        in_hdr_file, nrows, ncols, xmin, xmax, ymin, ymax,
+        &reader->nodata, &big_endian, &skipbytes, &reader->rowpad,
+        &reader->nbits, &reader->is_signed, software );
+
+    if (fseek( in_flt_file, skipbytes, SEEK_CUR )) {
+        error_exit( "Read error occurred on input .flt file." );
+    }
+
+    reader->file          = in_flt_file;
+    reader->start         = ftell( in_flt_file );
+    reader->file_row      = 0;
+    reader->nrows         = *nrows;
+    reader->ncols         = *ncols;
+    reader->reverse_bytes = ( am_big_endian() != big_endian );
+    reader->raw           = NULL;
+    reader->next_row      = 0;
+    reader->front         = 0;
+    reader->has_nulls     = 0;
+    reader->all_ints      = 1;
+    reader->too_large     = 0;
+    reader->error         = NULL;
+    reader->read_ahead    = NULL;
+
+    for (k=0; k<2; ++k) {
+        reader->blocks[k].data      = NULL;
+        reader->blocks[k].capacity  = 0;
+        reader->blocks[k].first_row = -1;
+        reader->blocks[k].rows      = 0;
+    }
+
+    if (reader->nbits != 32) {
+        reader->raw = malloc( (size_t)reader->ncols * (reader->nbits / 8) );
+        if (!reader->raw) {
+            error_exit( "Insufficient memory for input .flt data." );
+        }
+    }
+
+    return reader;
+}
+
+const float *next_flt_rows( Flt_Reader *reader, int n, int *count )
+{
+    int remaining = reader->nrows - reader->next_row;
+    int rows      = remaining < n ? remaining : n;
+
+    Flt_Block *block;
+
+    // errors of the read-ahead job are reported here, on the caller's thread
+    thread_pool_join( reader->read_ahead );
+    reader->read_ahead = NULL;
+    if (reader->error) {
+        error_exit( reader->error );
+    }
+
+    if (rows <= 0) {
+        *count = 0;
+        return NULL;
+    }
+
+    block = &reader->blocks[1 - reader->front];
+    if (block->first_row != reader->next_row || block->rows != rows) {
+        // nothing read ahead, or a different number of rows was requested
+        block->first_row = reader->next_row;
+        block->rows      = rows;
+        reader->error    = read_flt_block( reader, block );
+        if (reader->error) {
+            error_exit( reader->error );
+        }
+    }
+
+    if (reader->too_large) {
+        fprintf( stderr, "*** WARNING: " );
+        fprintf( stderr, "Input .flt file size too large - does not match .hdr info.\n" );
+        reader->too_large = 0;
+    }
+
+    reader->front     = 1 - reader->front;
+    reader->next_row += rows;
+    if (block->has_nulls) {
+        reader->has_nulls = 1;
+    }
+    if (!block->all_ints) {
+        reader->all_ints = 0;
+    }
+
+    // CONCURRENCY NOTE: The next block of the same size is read into the other
+    // buffer while the caller works on this one; only the read-ahead job
+    // touches the file and the other buffer until it is joined above.
+
+    if (reader->next_row < reader->nrows) {
+        Flt_Block *next = &reader->blocks[1 - reader->front];
+
+        remaining       = reader->nrows - reader->next_row;
+        next->first_row = reader->next_row;
+        next->rows      = remaining < n ? remaining : n;
+
+        reader->read_ahead = thread_pool_start( read_ahead_job, reader );
+    }
+
+    *count = rows;
+    return block->data;
+}
+
+void flt_reader_flags( const Flt_Reader *reader, int *has_nulls, int *all_ints )
+{
+    *has_nulls = reader->has_nulls;
+    *all_ints  = reader->all_ints;
+}
+
+void close_flt_reader( Flt_Reader *reader )
+{
+    thread_pool_join( reader->read_ahead );
+
+    free( reader->blocks[0].data );
+    free( reader->blocks[1].data );
+    free( reader->raw );
+    free( reader );
+}
+
+// TIFF tags used by read_tif_file()
+#define TIF_IMAGE_WIDTH         256
+#define TIF_IMAGE_LENGTH        257
+#define TIF_BITS_PER_SAMPLE     258
+#define TIF_COMPRESSION         259
+#define TIF_STRIP_OFFSETS       273
+#define TIF_SAMPLES_PER_PIXEL   277
+#define TIF_ROWS_PER_STRIP      278
+#define TIF_STRIP_BYTE_COUNTS   279
+#define TIF_PLANAR_CONFIG       284
+#define TIF_TILE_WIDTH          322
+#define TIF_TILE_LENGTH         323
+#define TIF_TILE_OFFSETS        324
+#define TIF_SAMPLE_FORMAT       339
+#define TIF_MODEL_PIXEL_SCALE   33550
+#define TIF_MODEL_TIEPOINT      33922
+#define TIF_GEO_KEY_DIRECTORY   34735
+#define TIF_GDAL_NODATA         42113
+
+// TIFF field types used by read_tif_file()
+#define TIF_BYTE    1
+#define TIF_ASCII   2
+#define TIF_SHORT   3
+#define TIF_LONG    4
+#define TIF_DOUBLE 12
+#define TIF_LONG8  16
+
+// GeoTIFF key giving the raster type, and its value for point samples
+#define GT_RASTER_TYPE_KEY      1025
+#define RASTER_PIXEL_IS_POINT   2
+
+// An open TIFF file being read
+typedef struct {
+    FILE *file;
+    int   big_endian;   // byte order of file
+    int   big_tiff;     // BigTIFF (64-bit offsets) rather than classic TIFF
+} Tif_File;
+
+// One entry of a TIFF image file directory
+typedef struct {
+    unsigned      tag;
+    unsigned      type;
+    LONG          count;
+    unsigned char value[8]; // values themselves if they fit, else their file offset
+} Tif_Entry;
+
+static void tif_unsupported_exit( const char *what )
+{
+    prefix_error();
+    fprintf( stderr, "Input .tif file has unsupported %s.\n", what );
+    exit( EXIT_FAILURE );
+}
+
+static unsigned long long tif_uint( const Tif_File *tif, const unsigned char *bytes, int size )
+// Decodes an unsigned integer of size bytes in the byte order of the file
+{
+    unsigned long long value = 0;
+    int k;
+
+    for (k=0; k<size; ++k) {
+        value = (value << 8) | bytes[tif->big_endian ? k : size-1-k];
+    }
+
+    return value;
+}
+
+static void tif_read( const Tif_File *tif, unsigned long long offset, void *buf, size_t size )
+{
+    if (offset > (unsigned long long)LONG_MAX) {
+        error_exit( "Input .tif file is too large to read on this platform." );
+    }
+    if (fseek( tif->file, (long)offset, SEEK_SET ) != 0 ||
+        fread( buf, 1, size, tif->file ) != size)
+    {
+        if (feof( tif->file )) {
+            error_exit( "Input .tif file is truncated." );
+        } else {
+            error_exit( "Read error occurred on input .tif file." );
+        }
+    }
+}
+
+static int tif_type_size( unsigned type )
+// Returns size in bytes of one value of a TIFF field type, or 0 if unknown
+{
+    switch (type) {
+        case 1: case 2: case 6: case 7:             // BYTE, ASCII, SBYTE, UNDEFINED
+            return 1;
+        case 3: case 8:                             // SHORT, SSHORT
+            return 2;
+        case 4: case 9: case 11: case 13:           // LONG, SLONG, FLOAT, IFD
+            return 4;
+        case 5: case 10: case 12: case 16: case 17: case 18:
+            return 8;                               // RATIONALs, DOUBLE, LONG8, SLONG8, IFD8
+        default:
+            return 0;
+    }
+}
+
+static unsigned char *tif_entry_bytes( const Tif_File *tif, const Tif_Entry *entry )
+// Returns allocated copy of the raw bytes of an entry's values
+// NOTE: caller is responsible to free this pointer!
+{
+    size_t size  = (size_t)entry->count * tif_type_size( entry->type );
+    int    field = tif->big_tiff ? 8 : 4;
+
+    unsigned char *bytes = (unsigned char *)malloc( size + 1 );
+
+    if (!bytes) {
+        error_exit( "Insufficient memory for input .tif data." );
+    }
+
+    if (size <= (size_t)field) {
+        memcpy( bytes, entry->value, size );
+    } else {
+        tif_read( tif, tif_uint( tif, entry->value, field ), bytes, size );
+    }
+    bytes[size] = '\0';     // terminates ASCII values
+
+    return bytes;
+}
+
+static unsigned long long *tif_uints( const Tif_File *tif, const Tif_Entry *entry )
+// Returns allocated array of the values of an entry with unsigned integer type
+// NOTE: caller is responsible to free this pointer!
+{
+    int size = tif_type_size( entry->type );
+
+    unsigned char      *bytes;
+    unsigned long long *values;
+    LONG k;
+
+    if (entry->type != TIF_BYTE && entry->type != TIF_SHORT &&
+        entry->type != TIF_LONG && entry->type != TIF_LONG8)
+    {
+        tif_unsupported_exit( "field type" );
+    }
+
+    bytes  = tif_entry_bytes( tif, entry );
+    values = (unsigned long long *)malloc( entry->count * sizeof( unsigned long long ) );
+    if (!values) {
+        error_exit( "Insufficient memory for input .tif data." );
+    }
+
+    for (k=0; k<entry->count; ++k) {
+        values[k] = tif_uint( tif, bytes + k * size, size );
+    }
+
+    free( bytes );
+
+    return values;
+}
+
+static unsigned long long tif_first_uint( const Tif_File *tif, const Tif_Entry *entry )
+{
+    unsigned long long *values = tif_uints( tif, entry );
+    unsigned long long  value  = values[0];
+
+    free( values );
+
+    return value;
+}
+
+static double *tif_doubles( const Tif_File *tif, const Tif_Entry *entry )
+// Returns allocated array of the values of an entry with DOUBLE type
+// NOTE: caller is responsible to free this pointer!
+{
+    unsigned char *bytes;
+    double        *values;
+    LONG k;
+
+    if (entry->type != TIF_DOUBLE) {
+        tif_unsupported_exit( "field type" );
+    }
+
+    bytes  = tif_entry_bytes( tif, entry );
+    values = (double *)malloc( entry->count * sizeof( double ) );
+    if (!values) {
+        error_exit( "Insufficient memory for input .tif data." );
+    }
+
+    for (k=0; k<entry->count; ++k) {
+        unsigned long long bits = tif_uint( tif, bytes + 8 * k, 8 );
+        memcpy( values + k, &bits, sizeof( double ) );
+    }
+
+    free( bytes );
+
+    return values;
+}
+
+static const Tif_Entry *tif_find( const Tif_Entry *entries, LONG nentries, unsigned tag )
+// Returns the entry with the given tag, or NULL if absent
+{
+    LONG k;
+
+    for (k=0; k<nentries; ++k) {
+        if (entries[k].tag == tag) {
+            return entries + k;
+        }
+    }
+
+    return NULL;
+}
+
+static unsigned long long tif_get_uint(
+    const Tif_File *tif, const Tif_Entry *entries, LONG nentries, unsigned tag,
+    unsigned long long default_value )
+{
+    const Tif_Entry *entry = tif_find( entries, nentries, tag );
+
+    return entry ? tif_first_uint( tif, entry ) : default_value;
+}
+
+static Tif_Entry *read_tif_directory( Tif_File *tif, LONG *nentries )
+// Reads the TIFF header and the entries of the first image file directory
+// NOTE: caller is responsible to free the returned pointer!
+{
+    unsigned char  header[16];
+    unsigned char *raw;
+
+    unsigned long long offset;
+
+    Tif_Entry *entries;
+
+    int  entry_size;
+    int  count_size;
+    LONG k;
+
+    if (fread( header, 1, 8, tif->file ) != 8) {
+        error_exit( "Input .tif file is not a TIFF file." );
+    }
+
+    if (header[0] == 'I' && header[1] == 'I') {
+        tif->big_endian = 0;
+    } else if (header[0] == 'M' && header[1] == 'M') {
+        tif->big_endian = 1;
+    } else {
+        error_exit( "Input .tif file is not a TIFF file." );
+    }
+
+    switch (tif_uint( tif, header+2, 2 )) {
+        case 42:
+            tif->big_tiff = 0;
+            offset = tif_uint( tif, header+4, 4 );
+            break;
+        case 43:
+            tif->big_tiff = 1;
+            if (fread( header+8, 1, 8, tif->file ) != 8 || tif_uint( tif, header+4, 2 ) != 8) {
+                error_exit( "Input .tif file is not a TIFF file." );
+            }
+            offset = tif_uint( tif, header+8, 8 );
+            break;
+        default:
+            error_exit( "Input .tif file is not a TIFF file." );
+            return NULL;
+    }
+
+    entry_size = tif->big_tiff ? 20 : 12;
+    count_size = tif->big_tiff ?  8 :  2;
+
+    tif_read( tif, offset, header, count_size );
+    *nentries = (LONG)tif_uint( tif, header, count_size );
+    if (*nentries <= 0 || *nentries > 65535) {
+        error_exit( "Input .tif file has a bad image file directory." );
+    }
+
+    raw     = (unsigned char *)malloc( *nentries * entry_size );
+    entries = (Tif_Entry *)malloc( *nentries * sizeof( Tif_Entry ) );
+    if (!raw || !entries) {
+        error_exit( "Insufficient memory for input .tif data." );
+    }
+
+    tif_read( tif, offset + count_size, raw, *nentries * entry_size );
+
+    for (k=0; k<*nentries; ++k) {
+        const unsigned char *ptr = raw + k * entry_size;
+
+        unsigned long long count;
+
+        entries[k].tag  = (unsigned)tif_uint( tif, ptr,   2 );
+        entries[k].type = (unsigned)tif_uint( tif, ptr+2, 2 );
+        count = tif_uint( tif, ptr+4, tif->big_tiff ? 8 : 4 );
+
+        // values beyond the types listed (or absurdly many of them) are only
+        // a problem if the entry is used
+        if (!tif_type_size( entries[k].type ) || count == 0 || count > 0x7FFFFFFF) {
+            entries[k].tag = 0;
+        }
+        entries[k].count = (LONG)count;
+
+        memset( entries[k].value, 0, sizeof( entries[k].value ) );
+        memcpy( entries[k].value, ptr + (tif->big_tiff ? 12 : 8), tif->big_tiff ? 8 : 4 );
+    }
+
+    free( raw );
+
+    return entries;
+}
+
+float *read_tif_file(
+    FILE *in_tif_file, int *nrows, int *ncols,
+    double *xmin, double *xmax, double *ymin, double *ymax,
+    int *has_nulls, int *all_ints )
+{
+    Tif_File   tif;
+    Tif_Entry *entries;
+    LONG       nentries;
+
+    const Tif_Entry *entry;
+
+    unsigned long long  width, height;
+    unsigned long long *offsets;
+
+    int    nbits, format;
+    int    tiled;
+    LONG   block_cols, block_rows;  // size of strips or tiles
+    LONG   blocks_across, blocks_down;
+    LONG   block_bytes;
+    LONG   b, i;
+    double *scale;
+    double *tiepoint;
+    double  shift = 0.0;    // half a pixel if tiepoint is at a pixel center
+    float   nodata = -3.40282347e+38f;
+    int     reverse_bytes;
+
+    float         *data;
+    unsigned char *raw;
+
+    tif.file = in_tif_file;
+
+    entries = read_tif_directory( &tif, &nentries );
+
+    // Validate image format:
+
+    width  = tif_get_uint( &tif, entries, nentries, TIF_IMAGE_WIDTH,  0 );
+    height = tif_get_uint( &tif, entries, nentries, TIF_IMAGE_LENGTH, 0 );
+    if (width == 0 || height == 0) {
+        error_exit( "Input .tif file is missing image dimensions." );
+    }
+    if (width > 0x7FFFFFFF || height > 0x7FFFFFFF) {
+        tif_unsupported_exit( "image dimensions" );
+    }
+    *ncols = (int)width;
+    *nrows = (int)height;
+
+    if (tif_get_uint( &tif, entries, nentries, TIF_COMPRESSION, 1 ) != 1) {
+        error_exit( "Input .tif file is compressed - only uncompressed files are supported." );
+    }
+    if (tif_get_uint( &tif, entries, nentries, TIF_SAMPLES_PER_PIXEL, 1 ) != 1) {
+        error_exit( "Input .tif file has more than one band - only single-band files are supported." );
+    }
+
+    nbits  = (int)tif_get_uint( &tif, entries, nentries, TIF_BITS_PER_SAMPLE, 1 );
+    format = (int)tif_get_uint( &tif, entries, nentries, TIF_SAMPLE_FORMAT,   1 );
+    if (!(format == 3 && nbits == 32) && !((format == 1 || format == 2) && (nbits == 8 || nbits == 16))) {
+        tif_unsupported_exit( "data type (expected 32-bit float, or 8- or 16-bit integer)" );
+    }
+
+    // Strips are treated as tiles spanning the full width of the image
+
+    tiled = tif_find( entries, nentries, TIF_TILE_WIDTH ) != NULL;
+    if (tiled) {
+        block_cols = (LONG)tif_get_uint( &tif, entries, nentries, TIF_TILE_WIDTH,  0 );
+        block_rows = (LONG)tif_get_uint( &tif, entries, nentries, TIF_TILE_LENGTH, 0 );
+        entry = tif_find( entries, nentries, TIF_TILE_OFFSETS );
+    } else {
+        block_cols = *ncols;
+        block_rows = (LONG)tif_get_uint( &tif, entries, nentries, TIF_ROWS_PER_STRIP, height );
+        if (block_rows > *nrows) {
+            block_rows = *nrows;
+        }
+        entry = tif_find( entries, nentries, TIF_STRIP_OFFSETS );
+    }
+    blocks_across = block_cols > 0 ? (*ncols + block_cols - 1) / block_cols : 0;
+    blocks_down   = block_rows > 0 ? (*nrows + block_rows - 1) / block_rows : 0;
+    if (!entry || blocks_across == 0 || blocks_down == 0 ||
+        entry->count != blocks_across * blocks_down)
+    {
+        error_exit( "Input .tif file has bad strip or tile layout." );
+    }
+    offsets = tif_uints( &tif, entry );
+    block_bytes = block_rows * block_cols * (nbits / 8);
+
+    // Read georeferencing:
+
+    entry = tif_find( entries, nentries, TIF_MODEL_PIXEL_SCALE );
+    if (!entry || entry->count < 2 || !tif_find( entries, nentries, TIF_MODEL_TIEPOINT ) ||
+        tif_find( entries, nentries, TIF_MODEL_TIEPOINT )->count < 6)
+    {
+        error_exit( "Input .tif file is not georeferenced (needs ModelPixelScale and ModelTiepoint)." );
+    }
+    scale    = tif_doubles( &tif, entry );
+    tiepoint = tif_doubles( &tif, tif_find( entries, nentries, TIF_MODEL_TIEPOINT ) );
+    if (scale[0] <= 0.0 || scale[1] <= 0.0) {
+        tif_unsupported_exit( "pixel scale (expected north-up image)" );
+    }
+
+    entry = tif_find( entries, nentries, TIF_GEO_KEY_DIRECTORY );
+    if (entry) {
+        unsigned long long *keys = tif_uints( &tif, entry );
+        LONG k;
+        for (k=4; k+4<=entry->count && k<4+4*(LONG)keys[3]; k+=4) {
+            if (keys[k] == GT_RASTER_TYPE_KEY && keys[k+1] == 0 &&
+                keys[k+3] == RASTER_PIXEL_IS_POINT)
+            {
+                shift = 0.5;
+            }
+        }
+        free( keys );
+    }
+
+    // tiepoint maps raster point (I,J) to model point (X,Y)
+    *xmin = tiepoint[3] - (tiepoint[0] + shift) * scale[0];
+    *ymax = tiepoint[4] + (tiepoint[1] + shift) * scale[1];
+    *xmax = *xmin + *ncols * scale[0];
+    *ymin = *ymax - *nrows * scale[1];
+
+    free( scale );
+    free( tiepoint );
+
+    entry = tif_find( entries, nentries, TIF_GDAL_NODATA );
+    if (entry && entry->type == TIF_ASCII) {
+        char *text = (char *)tif_entry_bytes( &tif, entry );
+        char *end;
+        double value = strtod( text, &end );
+        if (end != text) {
+            nodata = (float)value;
+        }
+        free( text );
+    }
+
+    free( entries );
+
+    reverse_bytes = ( am_big_endian() != tif.big_endian );
+
+    *has_nulls = 0;
+    *all_ints  = 1;
+
+#ifdef USE_MMAP
+    // Float strips laid out back to back are the same as a .flt file without
+    // row padding, and are used in place from the file
+    if (!tiled && nbits == 32) {
+        int contiguous = offsets[0] <= (unsigned long long)LONG_MAX;
+        for (b=1; b<blocks_down; ++b) {
+            if (offsets[b] != offsets[b-1] + block_bytes) {
+                contiguous = 0;
+            }
+        }
+        if (contiguous &&
+            fseek( in_tif_file, 0, SEEK_SET ) == 0)
+        {
+            data = map_flt_file( in_tif_file, *nrows, *ncols, nodata, reverse_bytes,
+                                 (LONG)offsets[0], 0, has_nulls, all_ints );
+            if (data) {
+                free( offsets );
+                return data;
+            }
+        }
+    }
+#endif
+
+    // Read each strip or tile into place (strips a row at a time, with float
+    // rows read directly into the array):
+
+    data = (float *)malloc( (LONG)*nrows * (LONG)*ncols * sizeof( float ) );
+    raw  = (unsigned char *)malloc( tiled ? block_bytes : (LONG)*ncols * (nbits / 8) );
+    if (!data || !raw) {
+        error_exit( "Insufficient memory for input .tif data." );
+    }
+
+    for (b=0; b<blocks_across*blocks_down; ++b) {
+        LONG row0 = (b / blocks_across) * block_rows;
+        LONG col0 = (b % blocks_across) * block_cols;
+        LONG rows = *nrows - row0 < block_rows ? *nrows - row0 : block_rows;
+        LONG cols = *ncols - col0 < block_cols ? *ncols - col0 : block_cols;
+        LONG row_bytes = block_cols * (nbits / 8);
+
+        if (tiled) {
+            tif_read( &tif, offsets[b], raw, rows * row_bytes );
+        }
+
+        for (i=0; i<rows; ++i) {
+            float *dst = data + (row0 + i) * (LONG)*ncols + col0;
+            const unsigned char *src = raw + i * row_bytes;
+
+            if (!tiled) {
+                src = raw;
+                tif_read( &tif, offsets[b] + i * row_bytes,
+                          nbits == 32 ? (void *)dst : (void *)raw, row_bytes );
+            }
+
+            if (nbits != 32) {
+                convert_row( src, dst, (int)cols, nbits, format == 2, reverse_bytes );
+            } else if (tiled) {
+                memcpy( dst, src, cols * sizeof( float ) );
+            }
+        }
+    }
+
+    free( raw );
+    free( offsets );
+
+    scan_rows( data, *nrows, *ncols, nodata, nbits == 32 ? reverse_bytes : 0, has_nulls, all_ints );
+
     return data;
 }
@@ -39,7 +39,7 @@ extern "C" {
 
 float *read_flt_hdr_files(
     // returns allocated array of data values;
-    // NOTE: caller is responsible to free this pointer!
+    // NOTE: caller is responsible to free this pointer with free_flt_data()!
     FILE *in_flt_file,  // .flt file - should be opened in BINARY mode
     FILE *in_hdr_file,  // .hdr file - should be opened in BINARY mode
     int *nrows,         // number of rows in data array
@@ -55,6 +55,65 @@ float *read_flt_hdr_files(
                         // caller is responsible to free *software pointer!
 );
 
+float *read_tif_file(
+    // returns allocated array of data values from an uncompressed, single-band
+    // GeoTIFF (classic or BigTIFF, stripped or tiled) of 32-bit floats or
+    // 8- or 16-bit integers, with nodata values (from the GDAL_NODATA tag) set to 0
+    // (or NaN - see keep_flt_voids());
+    // NOTE: caller is responsible to free this pointer with free_flt_data()!
+    FILE *in_tif_file,  // .tif file - should be opened in BINARY mode
+    int *nrows,         // number of rows in data array
+    int *ncols,         // number of cols in data array
+    double *xmin,       // min X coordinate (longitude or easting)  - left   edge of left   pixels
+    double *xmax,       // max X coordinate (longitude or easting)  - right  edge of right  pixels
+    double *ymin,       // min Y coordinate (latitude  or northing) - bottom edge of bottom pixels
+    double *ymax,       // max Y coordinate (latitude  or northing) - top    edge of top    pixels
+    int *has_nulls,
+    int *all_ints
+);
+
+// Sets whether later reads store nodata (void) points as NaN, if keep is
+// nonzero, rather than as 0 (the default).
+void keep_flt_voids( int keep );
+
+// Frees an array returned by read_flt_hdr_files() or read_tif_file(), which
+// may be a private mapping of the input file rather than allocated memory.
+void free_flt_data( float *data );
+
+// Streaming reader of a .flt file, for row-local processing in constant memory
+typedef struct Flt_Reader Flt_Reader;
+
+// Reads and validates the .hdr file, and returns a reader of the rows of the
+// .flt file (from top to bottom) to pass to next_flt_rows().
+// NOTE: caller is responsible to close the reader with close_flt_reader(),
+// and to keep in_flt_file open until then!
+Flt_Reader *open_flt_reader(
+    FILE *in_flt_file,  // .flt file - should be opened in BINARY mode
+    FILE *in_hdr_file,  // .hdr file - should be opened in BINARY mode
+    int *nrows,         // number of rows in data array
+    int *ncols,         // number of cols in data array
+    double *xmin,       // min X coordinate (longitude or easting)  - left   edge of left   pixels
+    double *xmax,       // max X coordinate (longitude or easting)  - right  edge of right  pixels
+    double *ymin,       // min Y coordinate (latitude  or northing) - bottom edge of bottom pixels
+    double *ymax,       // max Y coordinate (latitude  or northing) - top    edge of top    pixels
+    char * (*software)  // as for read_flt_hdr_files()
+);
+
+// Returns the next n rows of data (fewer at the end of the file, with *count
+// set to the number returned, or NULL at the end), with nodata values set to 0
+// (or NaN) as by read_flt_hdr_files(). The rows remain valid until the next call.
+// Meanwhile, the following n rows are read ahead on a background thread, so
+// that reading overlaps the caller's work when n is the same on each call;
+// errors in reading ahead are reported (as by read_flt_hdr_files()) by the
+// next call, on the caller's thread.
+const float *next_flt_rows( Flt_Reader *reader, int n, int *count );
+
+// Returns the has_nulls and all_ints flags of read_flt_hdr_files(), for the
+// rows returned so far.
+void flt_reader_flags( const Flt_Reader *reader, int *has_nulls, int *all_ints );
+
+void close_flt_reader( Flt_Reader *reader );
+
 // Copies input .prj file to output .prj file, and changes any "ZUNITS" line to "ZUNITS NO"
 void copy_prj_file( FILE *in_prj_file, FILE *out_prj_file );
 
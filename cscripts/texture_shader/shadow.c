@@ -43,6 +43,11 @@
 #include <math.h>
 #include <assert.h>
 #include "terrain_filter.h"
+#include "tool_support.h"
+#include "horizon_scan.h"
+#include "cast_shadows.h"
+#include "horizon_map.h"
+#include "thread_pool.h"
 
 #define LONG ptrdiff_t
 
@@ -61,38 +66,6 @@ static const char sw_format[] = "%s v%s %s";
 
 static const char *command_name;
 
-static const char *get_command_name( const char *argv[] )
-{
-    const char *colon;
-    const char *slash;
-    const char *result;
-
-    colon = strchr( argv[0], ':' );
-    if (colon) {
-        ++colon;
-    } else {
-        colon = argv[0];
-    }
-    slash = strrchr( colon, '/' );
-    if (slash) {
-        ++slash;
-    } else {
-        slash = colon;
-    }
-    result = strrchr( slash, '\\' );
-    if (result) {
-        ++result;
-    } else {
-        result = slash;
-    }
-    return result;
-}
-
-static void prefix_error()
-{
-    fprintf( stderr, "\n*** ERROR: " );
-}
-
 static void usage_exit( const char *message )
 {
     if (message) {
@@ -104,7 +77,9 @@ static void usage_exit( const char *message )
     fprintf( stderr, "          %s 120 22 rainier_elev -mercator -32.5 45\n", command_name );
     fprintf( stderr, "\n" );
     fprintf( stderr, "Requires both .flt and .hdr files as input  " );
-    fprintf( stderr, "(e.g., rainier_elev.flt and rainier_elev.hdr).\n" );
+    fprintf( stderr, "(e.g., rainier_elev.flt and rainier_elev.hdr),\n" );
+    fprintf( stderr, "integer .bil and .hdr files (e.g., rainier_elev.bil),\n" );
+    fprintf( stderr, "or an uncompressed GeoTIFF file (e.g., rainier_elev.tif).\n" );
     fprintf( stderr, "Writes   both .flt and .hdr files as output " );
     fprintf( stderr, "(e.g., rainier_tex.flt  and rainier_tex.hdr).\n" );
     fprintf( stderr, "Also reads & writes optional .prj file if present " );
@@ -112,157 +87,29 @@ static void usage_exit( const char *message )
     fprintf( stderr, "Input and output filenames must not be the same.\n" );
     fprintf( stderr, "NOTE: Output files will be overwritten if they already exist.\n" );
     fprintf( stderr, "\n" );
-    fprintf( stderr, "Available option:\n" );
+    fprintf( stderr, "Available options:\n" );
     fprintf( stderr, "    -mercator lat1 lat2    " );
     fprintf( stderr, "input is in normal Mercator projection (not UTM)\n" );
     fprintf( stderr, "Values lat1 and lat2 must be in decimal degrees.\n" );
+    fprintf( stderr, "    -threads n             " );
+    fprintf( stderr, "use n threads (default 0 = one per processor)\n" );
+    fprintf( stderr, "    -sun az elev           " );
+    fprintf( stderr, "add another sun position (may be repeated)\n" );
+    fprintf( stderr, "    -weight w              " );
+    fprintf( stderr, "weight of preceding sun position for -composite (default 1)\n" );
+    fprintf( stderr, "    -composite             " );
+    fprintf( stderr, "write weighted average of shadows for all sun positions\n" );
+    fprintf( stderr, "Without -composite, shadows for multiple sun positions are written\n" );
+    fprintf( stderr, "to separate files (e.g., shadow_1.flt, shadow_2.flt, ...).\n" );
+    fprintf( stderr, "    -horizon n             " );
+    fprintf( stderr, "look up horizon angles for n azimuths, cached in elev_file.hzn\n" );
+    fprintf( stderr, "With -horizon, output is the angle (degrees) of the horizon above the sun.\n" );
+    fprintf( stderr, "    -nearest               " );
+    fprintf( stderr, "with -horizon, use nearest azimuth instead of interpolating\n" );
     fprintf( stderr, "\n" );
     exit( EXIT_FAILURE );
 }
 
-static void get_filenames(
-    const char *arg, char **data_name, char **hdr_name, char **prj_name, char *ext )
-// NOTE: caller is responsible to free pointers *data_name, *hdr_name, and *prj_name!
-{
-    const char *dot;
-
-    size_t len = strlen( arg );
-
-    *data_name = (char *)malloc( len+5 );   // add 5 for ".", extension, and null terminator
-    *hdr_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-    *prj_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-
-    dot = strrchr( arg, '.' );
-
-    if (dot++ && !strpbrk( dot, "/\\" ) && strlen( dot ) <= 4) {
-        // filename has extension (of up to 4 characters)
-        strncpy( ext, dot, strlen( ext ) );
-        if (strcmp( dot, "flt" ) != 0 && strcmp( dot, "FLT" ) != 0)
-        {
-            usage_exit( "Filenames must have .flt extension (if any)." );
-        }
-        strcpy ( *data_name, arg );
-        strncpy( *hdr_name, arg, len-3 );
-        strncpy( *prj_name, arg, len-3 );
-        strcpy ( *hdr_name+len-3, "hdr" );
-        strcpy ( *prj_name+len-3, "prj" );
-    } else {
-        // filename does not have extension
-        strncpy( *data_name, arg, len );
-        (*data_name)[len] = '.';
-        strncpy( *data_name+len+1, ext, 3 );    // max 3 chars default extension
-        (*data_name)[len+4] = '\0';
-        strncpy( *hdr_name, arg, len );
-        strncpy( *prj_name, arg, len );
-        strcpy ( *hdr_name+len, ".hdr" );
-        strcpy ( *prj_name+len, ".prj" );
-    }
-}
-
-static int print_progress( float portion, float steps_done, int total_steps, void *state )
-{
-    int *last_count = (int *)state;
-    int  this_count = (int)steps_done;
-
-    if (this_count > *last_count) {
-        printf( "Processing phase %d...\n", this_count + 1 );
-        fflush( stdout );
-        *last_count = this_count;
-    }
-
-    return 0;
-}
-
-// Returns -1 for geographic coordinates, +1 for projected coordinates, 0 if unable to determine
-static int determine_projection(
-    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim )
-{
-    // Determine projection type:
-
-    if  ( (ydim <    0.02 && xdim <   0.02) &&
-          (xmin > -180.01 && xmax < 180.01) &&
-          (ymin >  -90.01 && ymax <  90.01) )
-    {
-        return -1;  // lat/lon (geographic) coordinates
-    } else if
-        // Kyle Bradley December 2020 : dim check interferes with along-topo grid in km/km units
-        // ( (ydim >    0.09 && xdim >   0.09) &&
-        ( (xmin < -181.00 || xmax > 181.00) &&
-          (ymin <  -91.00 || ymax >  91.00) )
-    {
-        return +1;  // projected into linear coordinates (easting/northing)
-    }
-
-    return 0;   // unable to determine correct projection type
-}
-
-static void check_aspect(
-    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim,
-    int proj_type )
-{
-    // Check pixel aspect ratio and size of map extent:
-
-    const double max_meters = 1000000.0;        // = 1000 kilometers
-    const double distortion_limit = 15.0/16.0;  // must be < 1
-
-    double xsize, ysize;
-    double xres,  yres;
-    double aspect;
-    double ynarrow;
-    double min_aspect;
-
-    if (proj_type < 0) {
-        geographic_scale( 0.5 * (ymin + ymax), &xsize, &ysize );
-
-        xres = xsize * xdim;
-        yres = ysize * ydim;
-
-        // printf( "Assuming pixel aspect ratio of %5.3f based on latitude range.\n", xres / yres );
-        // fflush( stdout );
-
-        aspect = xsize / ysize;
-        ynarrow = ymax >= -ymin ? ymax : ymin;
-        min_aspect = geographic_aspect( ynarrow );
-        if (min_aspect < aspect * distortion_limit ) {
-            fprintf( stderr, "*** WARNING: " );
-            fprintf( stderr, "Map area too large.\n" );
-            fprintf( stderr, "***          " );
-            fprintf( stderr, "(Small-scale maps require data to be in Mercator projection.)\n" );
-            fprintf( stderr, "***          " );
-            fprintf( stderr, "This will degrade the quality of the result.\n" );
-        }
-    } else {
-        // printf( "Assuming pixel aspect ratio of %5.3f.\n", xdim / ydim );
-        // fflush( stdout );
-
-        if (proj_type != 2) {
-            if (ymax - ymin > max_meters || xmax - xmin > max_meters) {
-                fprintf( stderr, "*** WARNING: " );
-                fprintf( stderr, "Map area too large. (Small-scale maps require -mercator option.)\n" );
-                fprintf( stderr, "***          " );
-                fprintf( stderr, "This will degrade the quality of the result.\n" );
-            }
-        }
-    }
-}
-
-// Turn a geographic azimuth (xdim,ydim) into a grid-coordinate azimuth (xinc=yinc)
-// az is in degrees, returns azimuth in degrees
-
-static double fix_azimuth(double az, double xdim, double ydim )
-{
-  double val;
-  val=rad2deg(atan(ydim/xdim*tan(deg2rad(az))));
-  if (az>90) {
-    val=val+180;
-  }
-  if (az>270) {
-    val=val+180;
-  }
-  return val;
-}
-
-
 // Main terrain_filter function:
 //
 // int cast_shadows(
@@ -359,17 +206,22 @@ int main( int argc, const char *argv[] )
     char *in_dat_name;
     char *in_hdr_name;
     char *in_prj_name;
+    char *cache_name;
     char *out_dat_name;
     char *out_hdr_name;
     char *out_prj_name;
+    char *layer_name;
+    char **out_dat_names;
+    char **out_hdr_names;
+    char **out_prj_names;
 
     double detail;
 
     FILE *in_dat_file;
     FILE *in_hdr_file;
     FILE *in_prj_file;
-    FILE *out_dat_file;
-    FILE *out_hdr_file;
+    FILE **out_dat_files;
+    FILE **out_hdr_files;
     FILE *out_prj_file;
 
     int nrows;
@@ -386,6 +238,7 @@ int main( int argc, const char *argv[] )
     enum Terrain_Coord_Type coord_type;
 
     int proj_type;
+    int in_is_tif;
     int has_nulls;
     int all_ints;
 
@@ -394,8 +247,23 @@ int main( int argc, const char *argv[] )
     double center_lat;
     double temp;
 
-    double sun_az;
-    double sun_el;
+    double *sun_az;
+    double *sun_el;
+    double *sun_weight;
+    double total_weight;
+    int    nsuns;
+    int    noutputs;
+    int    composite = 0;
+    struct Shadow_Sun *suns;
+    float **shadows;
+    LONG   k;
+    int    s;
+
+    long nsectors = 0;      // no horizon map unless -horizon option used
+    int  interpolate = 1;
+    Horizon_Map horizons;
+    double xsize, ysize;
+    long nthreads;
     // float *ptr;
 
     int error;
@@ -413,20 +281,32 @@ int main( int argc, const char *argv[] )
         usage_exit( "Not enough command-line parameters." );
     }
 
+    // each sun position takes at least 3 arguments, so argc bounds the number of suns
+    sun_az     = (double *)malloc( argc * sizeof( double ) );
+    sun_el     = (double *)malloc( argc * sizeof( double ) );
+    sun_weight = (double *)malloc( argc * sizeof( double ) );
+    if (!sun_az || !sun_el || !sun_weight) {
+        prefix_error();
+        fprintf( stderr, "Memory allocation error occurred.\n" );
+        exit( EXIT_FAILURE );
+    }
+
     argnum = 1;
 
     thisarg = argv[argnum++];
     // read decimal number
-    sun_az = strtod( thisarg, &endptr );
+    sun_az[0] = strtod( thisarg, &endptr );
     if (endptr == thisarg || *endptr != '\0') {
         usage_exit( "First parameter (sun_az) must be a number." );
     }
     thisarg = argv[argnum++];
     // read decimal number
-    sun_el = strtod( thisarg, &endptr );
+    sun_el[0] = strtod( thisarg, &endptr );
     if (endptr == thisarg || *endptr != '\0') {
         usage_exit( "Second parameter (sun_el) must be a number." );
     }
+    sun_weight[0] = 1.0;
+    nsuns = 1;
 
     software = (char *)malloc( strlen(sw_format) + strlen(sw_name) + strlen(sw_version) + strlen(sw_date) );
     if (!software) {
@@ -439,13 +319,17 @@ int main( int argc, const char *argv[] )
     // Validate filenames and open files:
 
     strncpy( extension, "flt", 4 );
-    get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension );
+    if (get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension,
+                       &in_is_tif ))
+    {
+        usage_exit( "Input filename must have .flt, .bil, or .tif extension (if any)." );
+    }
 
     strncpy( extension, "flt", 4 );
-    get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension );
-
-    if (!strcmp( in_hdr_name, out_hdr_name )) {
-        usage_exit( "Input and outfile filenames must not be the same." );
+    if (get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension,
+                       NULL ))
+    {
+        usage_exit( "Output filename must have .flt extension (if any)." );
     }
 
     while (argnum < argc) {
@@ -481,6 +365,54 @@ int main( int argc, const char *argv[] )
             if (lat1 <= -90.0 || lat2 >= 90.0) {
                 usage_exit( "Mercator latitude limits must be between -90 and +90 (exclusive)." );
             }
+        } else if (strcmp( thisarg, "sun" ) == 0) {
+            if (argnum+1 >= argc) {
+                usage_exit( "Option -sun must be followed by numeric azimuth and elevation values." );
+            }
+            thisarg = argv[argnum++];
+            sun_az[nsuns] = strtod( thisarg, &endptr );
+            if (endptr == thisarg || *endptr != '\0') {
+                usage_exit( "Option -sun must be followed by numeric azimuth and elevation values." );
+            }
+            thisarg = argv[argnum++];
+            sun_el[nsuns] = strtod( thisarg, &endptr );
+            if (endptr == thisarg || *endptr != '\0') {
+                usage_exit( "Option -sun must be followed by numeric azimuth and elevation values." );
+            }
+            sun_weight[nsuns] = 1.0;
+            ++nsuns;
+        } else if (strcmp( thisarg, "weight" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -weight must be followed by a non-negative number." );
+            }
+            thisarg = argv[argnum++];
+            sun_weight[nsuns-1] = strtod( thisarg, &endptr );
+            if (endptr == thisarg || *endptr != '\0' || sun_weight[nsuns-1] < 0.0) {
+                usage_exit( "Option -weight must be followed by a non-negative number." );
+            }
+        } else if (strcmp( thisarg, "composite" ) == 0) {
+            composite = 1;
+        } else if (strcmp( thisarg, "horizon" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -horizon must be followed by a number of azimuths." );
+            }
+            thisarg = argv[argnum++];
+            nsectors = strtol( thisarg, &endptr, 10 );
+            if (endptr == thisarg || *endptr != '\0' || nsectors < 1 || nsectors > 3600) {
+                usage_exit( "Option -horizon must be followed by a number of azimuths (1 to 3600)." );
+            }
+        } else if (strcmp( thisarg, "nearest" ) == 0) {
+            interpolate = 0;
+        } else if (strcmp( thisarg, "threads" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -threads must be followed by a number of threads." );
+            }
+            thisarg = argv[argnum++];
+            nthreads = strtol( thisarg, &endptr, 10 );
+            if (endptr == thisarg || *endptr != '\0' || nthreads < 0) {
+                usage_exit( "Option -threads must be followed by a number of threads." );
+            }
+            thread_pool_set_threads( (int)nthreads );
         } else if (strncmp( thisarg, "cellreg", 4 ) == 0 ||
                    strncmp( thisarg, "corner",  6 ) == 0)
         {
@@ -500,8 +432,63 @@ int main( int argc, const char *argv[] )
         }
     }
 
-    in_hdr_file = fopen( in_hdr_name, "rb" );   // use binary mode for compatibility
-    if (!in_hdr_file) {
+    total_weight = 0.0;
+    for (s=0; s<nsuns; ++s) {
+        total_weight += sun_weight[s];
+    }
+    if (composite && total_weight <= 0.0) {
+        usage_exit( "Option -composite requires a nonzero weight for some sun position." );
+    }
+
+    // One output for each sun position, unless combined by -composite
+
+    noutputs = composite ? 1 : nsuns;
+
+    out_dat_names = (char **)malloc( noutputs * sizeof( char * ) );
+    out_hdr_names = (char **)malloc( noutputs * sizeof( char * ) );
+    out_prj_names = (char **)malloc( noutputs * sizeof( char * ) );
+    out_dat_files = (FILE **)malloc( noutputs * sizeof( FILE * ) );
+    out_hdr_files = (FILE **)malloc( noutputs * sizeof( FILE * ) );
+    if (!out_dat_names || !out_hdr_names || !out_prj_names || !out_dat_files || !out_hdr_files) {
+        prefix_error();
+        fprintf( stderr, "Memory allocation error occurred.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    if (noutputs == 1) {
+        out_dat_names[0] = out_dat_name;
+        out_hdr_names[0] = out_hdr_name;
+        out_prj_names[0] = out_prj_name;
+    } else {
+        // insert layer number before ".flt" extension
+        layer_name = (char *)malloc( strlen( out_dat_name ) + 16 );  // assume this malloc succeeds
+        for (s=0; s<noutputs; ++s) {
+            sprintf( layer_name, "%.*s_%d", (int)strlen( out_dat_name ) - 4, out_dat_name, s+1 );
+            strncpy( extension, "flt", 4 );
+            get_filenames(
+                layer_name, &out_dat_names[s], &out_hdr_names[s], &out_prj_names[s], extension,
+                NULL );
+        }
+        free( layer_name );
+        free( out_dat_name );
+        free( out_hdr_name );
+        free( out_prj_name );
+    }
+
+    for (s=0; s<noutputs; ++s) {
+        if (!strcmp( in_hdr_name, out_hdr_names[s] )) {
+            usage_exit( "Input and outfile filenames must not be the same." );
+        }
+    }
+
+    // horizon cache file is named like .hdr file, with extension .hzn
+    cache_name = (char *)malloc( strlen( in_hdr_name ) + 1 );   // assume this malloc succeeds
+    strcpy( cache_name, in_hdr_name );
+    strcpy( cache_name + strlen( cache_name ) - 3, "hzn" );
+
+    // a GeoTIFF input file carries its own header
+    in_hdr_file = in_is_tif ? NULL : fopen( in_hdr_name, "rb" );  // use binary mode for compatibility
+    if (!in_is_tif && !in_hdr_file) {
         prefix_error();
         fprintf( stderr, "Could not open input file '%s'.\n", in_hdr_name );
         usage_exit( 0 );
@@ -517,45 +504,55 @@ int main( int argc, const char *argv[] )
     free( in_dat_name );
     free( in_hdr_name );
 
-    out_hdr_file = fopen( out_hdr_name, "wb" ); // use binary mode for compatibility
-    if (!out_hdr_file) {
-        prefix_error();
-        fprintf( stderr, "Could not open output file '%s'.\n", out_hdr_name );
-        usage_exit( 0 );
-    }
+    for (s=0; s<noutputs; ++s) {
+        out_hdr_files[s] = fopen( out_hdr_names[s], "wb" ); // use binary mode for compatibility
+        if (!out_hdr_files[s]) {
+            prefix_error();
+            fprintf( stderr, "Could not open output file '%s'.\n", out_hdr_names[s] );
+            usage_exit( 0 );
+        }
 
-    out_dat_file = fopen( out_dat_name, "wb" );
-    if (!out_dat_file) {
-        prefix_error();
-        fprintf( stderr, "Could not open output file '%s'.\n", out_dat_name );
-        usage_exit( 0 );
+        out_dat_files[s] = fopen( out_dat_names[s], "wb" );
+        if (!out_dat_files[s]) {
+            prefix_error();
+            fprintf( stderr, "Could not open output file '%s'.\n", out_dat_names[s] );
+            usage_exit( 0 );
+        }
+
+        free( out_dat_names[s] );
+        free( out_hdr_names[s] );
     }
 
-    free( out_dat_name );
-    free( out_hdr_name );
+    free( out_dat_names );
+    free( out_hdr_names );
 
-    // Read .flt and .hdr files:
+    // Read .flt and .hdr (or .tif) files:
 
     // printf( "Reading input files...\n" );
     fflush( stdout );
 
-    data = read_flt_hdr_files(
-        in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
-        &has_nulls, &all_ints, 0 );
+    if (in_is_tif) {
+        data = read_tif_file(
+            in_dat_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax, &has_nulls, &all_ints );
+    } else {
+        data = read_flt_hdr_files(
+            in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
+            &has_nulls, &all_ints, 0 );
+        fclose( in_hdr_file );
+    }
 
     fclose( in_dat_file );
-    fclose( in_hdr_file );
 
     if (has_nulls) {
         fprintf( stderr, "*** WARNING: " );
-        fprintf( stderr, "Input .flt file contains void (NODATA) points.\n" );
+        fprintf( stderr, "Input file contains void (NODATA) points.\n" );
         fprintf( stderr, "***          " );
         fprintf( stderr, "Assuming these are ocean points - setting these elevations to 0.\n" );
     }
 
     if (all_ints && detail > 0.0) {
         fprintf( stderr, "*** WARNING: " );
-        fprintf( stderr, "Input .flt file appears to contain only integer values.\n" );
+        fprintf( stderr, "Input file appears to contain only integer values.\n" );
         fprintf( stderr, "***          " );
         fprintf( stderr, "This may degrade the quality of the result.\n" );
     }
@@ -598,102 +595,85 @@ int main( int argc, const char *argv[] )
     }
 
     // check pixel aspect ratio and size of map extent
-    check_aspect( xmin, xmax, ymin, ymax, xdim, ydim, proj_type );
+    check_aspect( xmin, xmax, ymin, ymax, xdim, ydim, proj_type, 0 );
 
     // printf(
     //     "Processing %d column x %d row array using sun_az = %f, sun_el = %f...\n",
     //     ncols, nrows, sun_az, sun_el );
     fflush( stdout );
 
-    float *shadowarray2 = (float *)malloc( (LONG)nrows * (LONG)ncols * sizeof( float ) );
-    float z_max=-999999;
-
-    // Find maximum value to limit shadow search
-    float *ptr;
-    //
-    for (int i=0; i<nrows; ++i) {
-      ptr = data + (LONG)i * (LONG)ncols;
-      for (int j=0; j<ncols; ++j) {
-          if (ptr[j] > z_max) {
-            z_max = ptr[j];
-          }
-      }
-      ptr+=(LONG)ncols;
+    shadows = (float **)malloc( nsuns * sizeof( float * ) );
+    suns = (struct Shadow_Sun *)malloc( nsuns * sizeof( struct Shadow_Sun ) );
+
+    if (!shadows || !suns) {
+        prefix_error();
+        fprintf( stderr, "Memory allocation error occurred.\n" );
+        exit( EXIT_FAILURE );
     }
 
-    double zval;
-    double x;
-    double y;
-    int lit;
-    int x_int;
-    int y_int;
-    int xp_int;
-    int yp_int;
-    int i_smooth=4;
-
-    double const_deg_m=111132;
-
-    double csa=cos(deg2rad(sun_az));
-    double ssa=sin(deg2rad(sun_az));
-
-    double num_az= deg2rad(fix_azimuth(sun_az, xdim, ydim));
-    // fprintf(stderr, "xdim=%f, ydim=%f, sun_az=%f, fixed sun look angle=%f\n", xdim, ydim, sun_az, fix_azimuth(sun_az+180, xdim, ydim));
-    double num_el= deg2rad(sun_el);
-    double sun_x = sin(num_az)*cos(num_el);
-    double sun_y = -cos(num_az)*cos(num_el);
-    double sun_z = sin(num_el)*sqrt(ydim*ydim*csa*csa+xdim*xdim*ssa*ssa);
-    double xp;
-    double yp;
-
-    // fprintf(stderr, "zmax=%f, xdim=%f, ydim=%f, sun_x=%f, sun_y=%f, sun_z=%f\n", z_max, xdim, ydim, sun_x, sun_y, sun_z);
-
-    double val;
-    double this_z;
-    float *ptr2;
-    float *ptr3;
-    int j;
-    int i;
-    int runcount;
-    int i_set;
-    int j_set;
-
-    // Shadow algorithm
-
-    for(int i=0;i<nrows;i++) {
-      ptr = data + (LONG)i * (LONG)ncols;
-      ptr2 = shadowarray2 + (LONG)i * (LONG)ncols;
-      for(int j=0;j<ncols;j++) {
-        x=j;
-        y=i;
-        zval=ptr[j];   // dataarray[row][column]
-        lit=0;
-        x_int=x;
-        y_int=y;
-
-        while(x_int > 0 && x_int < ncols && y_int > 0 && y_int < nrows && zval <= z_max) {
-          ptr3 = data + (LONG)y_int * (LONG)ncols;
-          if (zval < ptr3[x_int]) {
-            lit=lit+(ptr3[x_int]-zval);  // Sum the height above the sun line
-          }
-          x=x+sun_x;
-          y=y+sun_y;
-          zval=zval+sun_z;
-          x_int=(int) x;
-          y_int=(int) y;
+    for (s=0; s<nsuns; ++s) {
+        shadows[s] = (float *)malloc( (LONG)nrows * (LONG)ncols * sizeof( float ) );
+
+        if (!shadows[s]) {
+            prefix_error();
+            fprintf( stderr, "Memory allocation error occurred.\n" );
+            exit( EXIT_FAILURE );
         }
-        if (lit==0) {
-          ptr2[j]=0;
+
+        double csa=cos(deg2rad(sun_az[s]));
+        double ssa=sin(deg2rad(sun_az[s]));
+
+        double num_az= deg2rad(fix_azimuth(sun_az[s], xdim, ydim));
+        // fprintf(stderr, "xdim=%f, ydim=%f, sun_az=%f, fixed sun look angle=%f\n", xdim, ydim, sun_az[s], fix_azimuth(sun_az[s]+180, xdim, ydim));
+        double num_el= deg2rad(sun_el[s]);
+        suns[s].x = sin(num_az)*cos(num_el);
+        suns[s].y = -cos(num_az)*cos(num_el);
+        suns[s].z = sin(num_el)*sqrt(ydim*ydim*csa*csa+xdim*xdim*ssa*ssa);
+
+        // fprintf(stderr, "xdim=%f, ydim=%f, sun_x=%f, sun_y=%f, sun_z=%f\n", xdim, ydim, suns[s].x, suns[s].y, suns[s].z);
+    }
+
+    if (nsectors) {
+        // Look up shadows from horizon angles
+
+        // horizon map distances must be in the same units as elevations
+        if (coord_type == TERRAIN_DEGREES) {
+            geographic_scale( center_lat, &xsize, &ysize );
         } else {
-          ptr2[j]=log(lit);  // Use the natural logarithm of the total shading volume
+            xsize = ysize = 1.0;
+        }
+        get_horizon_map( &horizons, cache_name, data, nrows, ncols,
+                         xdim * xsize, ydim * ysize, (int)nsectors );
+
+        for (s=0; s<nsuns; ++s) {
+            horizon_shadows( &horizons, shadows[s], sun_az[s], sun_el[s], interpolate );
+        }
+
+        free_horizon_map( &horizons );
+    } else {
+        // Shadow algorithm - all sun positions share the input data in one pass
+
+        error = cast_shadows_batch( data, shadows, nrows, ncols, suns, nsuns );
+
+        if (error) {
+            assert( error == SHADOW_MALLOC_ERROR );
+            prefix_error();
+            fprintf( stderr, "Memory allocation error occurred during processing of data.\n" );
+            exit( EXIT_FAILURE );
         }
-      }
     }
 
-    if (error) {
-        assert( error == TERRAIN_FILTER_MALLOC_ERROR );
-        prefix_error();
-        fprintf( stderr, "Memory allocation error occurred during processing of data.\n" );
-        exit( EXIT_FAILURE );
+    free( cache_name );
+
+    if (composite) {
+        // replace first layer with weighted average of all layers
+        for (k=0; k<(LONG)nrows*(LONG)ncols; ++k) {
+            double sum = 0.0;
+            for (s=0; s<nsuns; ++s) {
+                sum += sun_weight[s] * shadows[s][k];
+            }
+            shadows[0][k] = (float)(sum / total_weight);
+        }
     }
 
     // if (lat1 != lat2) {
@@ -705,34 +685,52 @@ int main( int argc, const char *argv[] )
     // printf( "Writing output files...\n" );
     fflush( stdout );
 
-    write_flt_hdr_files(
-        out_dat_file, out_hdr_file, nrows, ncols, xmin, xmax, ymin, ymax, shadowarray2, software );
+    for (s=0; s<noutputs; ++s) {
+        write_flt_hdr_files(
+            out_dat_files[s], out_hdr_files[s], nrows, ncols, xmin, xmax, ymin, ymax,
+            shadows[s], software );
 
-    fclose( out_dat_file );
-    fclose( out_hdr_file );
+        fclose( out_dat_files[s] );
+        fclose( out_hdr_files[s] );
+    }
 
-    free( data );
+    for (s=0; s<nsuns; ++s) {
+        free( shadows[s] );
+    }
+
+    free( shadows );
+    free( suns );
+    free( sun_az );
+    free( sun_el );
+    free( sun_weight );
+    free( out_dat_files );
+    free( out_hdr_files );
+    free_flt_data( data );
     free( software );
 
     // Copy optional .prj file:
 
-    in_prj_file = fopen( in_prj_name, "rb" );   // use binary mode for compatibility
-    if (in_prj_file) {
-        out_prj_file = fopen( out_prj_name, "wb" ); // use binary mode for compatibility
-        if (!out_prj_file) {
-            fprintf( stderr, "*** WARNING: " );
-            fprintf( stderr, "Could not open output file '%s'.\n", out_prj_name );
-        } else {
-            // copy file and change any "ZUNITS" line to "ZUNITS NO"
-            copy_prj_file( in_prj_file, out_prj_file );
+    for (s=0; s<noutputs; ++s) {
+        in_prj_file = fopen( in_prj_name, "rb" );   // use binary mode for compatibility
+        if (in_prj_file) {
+            out_prj_file = fopen( out_prj_names[s], "wb" ); // use binary mode for compatibility
+            if (!out_prj_file) {
+                fprintf( stderr, "*** WARNING: " );
+                fprintf( stderr, "Could not open output file '%s'.\n", out_prj_names[s] );
+            } else {
+                // copy file and change any "ZUNITS" line to "ZUNITS NO"
+                copy_prj_file( in_prj_file, out_prj_file );
 
-            fclose( out_prj_file );
+                fclose( out_prj_file );
+            }
+            fclose( in_prj_file );
         }
-        fclose( in_prj_file );
+
+        free( out_prj_names[s] );
     }
 
     free( in_prj_name );
-    free( out_prj_name );
+    free( out_prj_names );
 
     // printf( "DONE.\n" );
 
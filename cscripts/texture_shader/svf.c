@@ -43,6 +43,10 @@
 #include <math.h>
 #include <assert.h>
 #include "terrain_filter.h"
+#include "tool_support.h"
+#include "horizon_scan.h"
+#include "horizon_map.h"
+#include "thread_pool.h"
 
 #define LONG ptrdiff_t
 
@@ -61,38 +65,6 @@ static const char sw_format[] = "%s v%s %s";
 
 static const char *command_name;
 
-static const char *get_command_name( const char *argv[] )
-{
-    const char *colon;
-    const char *slash;
-    const char *result;
-
-    colon = strchr( argv[0], ':' );
-    if (colon) {
-        ++colon;
-    } else {
-        colon = argv[0];
-    }
-    slash = strrchr( colon, '/' );
-    if (slash) {
-        ++slash;
-    } else {
-        slash = colon;
-    }
-    result = strrchr( slash, '\\' );
-    if (result) {
-        ++result;
-    } else {
-        result = slash;
-    }
-    return result;
-}
-
-static void prefix_error()
-{
-    fprintf( stderr, "\n*** ERROR: " );
-}
-
 static void usage_exit( const char *message )
 {
     if (message) {
@@ -104,7 +76,9 @@ static void usage_exit( const char *message )
     fprintf( stderr, "          %s 120 22 rainier_elev -mercator -32.5 45\n", command_name );
     fprintf( stderr, "\n" );
     fprintf( stderr, "Requires both .flt and .hdr files as input  " );
-    fprintf( stderr, "(e.g., rainier_elev.flt and rainier_elev.hdr).\n" );
+    fprintf( stderr, "(e.g., rainier_elev.flt and rainier_elev.hdr),\n" );
+    fprintf( stderr, "integer .bil and .hdr files (e.g., rainier_elev.bil),\n" );
+    fprintf( stderr, "or an uncompressed GeoTIFF file (e.g., rainier_elev.tif).\n" );
     fprintf( stderr, "Writes   both .flt and .hdr files as output " );
     fprintf( stderr, "(e.g., rainier_tex.flt  and rainier_tex.hdr).\n" );
     fprintf( stderr, "Also reads & writes optional .prj file if present " );
@@ -112,153 +86,25 @@ static void usage_exit( const char *message )
     fprintf( stderr, "Input and output filenames must not be the same.\n" );
     fprintf( stderr, "NOTE: Output files will be overwritten if they already exist.\n" );
     fprintf( stderr, "\n" );
-    fprintf( stderr, "Available option:\n" );
+    fprintf( stderr, "Available options:\n" );
     fprintf( stderr, "    -mercator lat1 lat2    " );
     fprintf( stderr, "input is in normal Mercator projection (not UTM)\n" );
     fprintf( stderr, "Values lat1 and lat2 must be in decimal degrees.\n" );
+    fprintf( stderr, "    -horizon               " );
+    fprintf( stderr, "look up horizon angles, cached in elev_file.hzn\n" );
+    fprintf( stderr, "With -horizon, horizons are searched to the edge of the data.\n" );
+    fprintf( stderr, "    -radius r              " );
+    fprintf( stderr, "search horizons up to r meters away (0 = edge of data)\n" );
+    fprintf( stderr, "Without -radius or -horizon, horizons are searched 10 pixels away.\n" );
+    fprintf( stderr, "    -multiscale t          " );
+    fprintf( stderr, "sample terrain d away in blocks up to t*d wide (e.g., 0.1)\n" );
+    fprintf( stderr, "With -multiscale, horizons are searched to -radius or the edge of the data.\n" );
+    fprintf( stderr, "    -threads n             " );
+    fprintf( stderr, "use n threads (default 0 = one per processor)\n" );
     fprintf( stderr, "\n" );
     exit( EXIT_FAILURE );
 }
 
-static void get_filenames(
-    const char *arg, char **data_name, char **hdr_name, char **prj_name, char *ext )
-// NOTE: caller is responsible to free pointers *data_name, *hdr_name, and *prj_name!
-{
-    const char *dot;
-
-    size_t len = strlen( arg );
-
-    *data_name = (char *)malloc( len+5 );   // add 5 for ".", extension, and null terminator
-    *hdr_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-    *prj_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-
-    dot = strrchr( arg, '.' );
-
-    if (dot++ && !strpbrk( dot, "/\\" ) && strlen( dot ) <= 4) {
-        // filename has extension (of up to 4 characters)
-        strncpy( ext, dot, strlen( ext ) );
-        if (strcmp( dot, "flt" ) != 0 && strcmp( dot, "FLT" ) != 0)
-        {
-            usage_exit( "Filenames must have .flt extension (if any)." );
-        }
-        strcpy ( *data_name, arg );
-        strncpy( *hdr_name, arg, len-3 );
-        strncpy( *prj_name, arg, len-3 );
-        strcpy ( *hdr_name+len-3, "hdr" );
-        strcpy ( *prj_name+len-3, "prj" );
-    } else {
-        // filename does not have extension
-        strncpy( *data_name, arg, len );
-        (*data_name)[len] = '.';
-        strncpy( *data_name+len+1, ext, 3 );    // max 3 chars default extension
-        (*data_name)[len+4] = '\0';
-        strncpy( *hdr_name, arg, len );
-        strncpy( *prj_name, arg, len );
-        strcpy ( *hdr_name+len, ".hdr" );
-        strcpy ( *prj_name+len, ".prj" );
-    }
-}
-
-static int print_progress( float portion, float steps_done, int total_steps, void *state )
-{
-    int *last_count = (int *)state;
-    int  this_count = (int)steps_done;
-
-    if (this_count > *last_count) {
-        printf( "Processing phase %d...\n", this_count + 1 );
-        fflush( stdout );
-        *last_count = this_count;
-    }
-
-    return 0;
-}
-
-// Returns -1 for geographic coordinates, +1 for projected coordinates, 0 if unable to determine
-static int determine_projection(
-    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim )
-{
-    // Determine projection type:
-
-    if  ( (ydim <    0.02 && xdim <   0.02) &&
-          (xmin > -180.01 && xmax < 180.01) &&
-          (ymin >  -90.01 && ymax <  90.01) )
-    {
-        return -1;  // lat/lon (geographic) coordinates
-    } else if
-        // Kyle Bradley December 2020 : dim check interferes with along-topo grid in km/km units
-        // ( (ydim >    0.09 && xdim >   0.09) &&
-        ( (xmin < -181.00 || xmax > 181.00) &&
-          (ymin <  -91.00 || ymax >  91.00) )
-    {
-        return +1;  // projected into linear coordinates (easting/northing)
-    }
-
-    return 0;   // unable to determine correct projection type
-}
-
-static void check_aspect(
-    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim,
-    int proj_type )
-{
-    // Check pixel aspect ratio and size of map extent:
-
-    const double max_meters = 1000000.0;        // = 1000 kilometers
-    const double distortion_limit = 15.0/16.0;  // must be < 1
-
-    double xsize, ysize;
-    double xres,  yres;
-    double aspect;
-    double ynarrow;
-    double min_aspect;
-
-    if (proj_type < 0) {
-        geographic_scale( 0.5 * (ymin + ymax), &xsize, &ysize );
-
-        xres = xsize * xdim;
-        yres = ysize * ydim;
-
-        printf( "Assuming pixel aspect ratio of %5.3f based on latitude range.\n", xres / yres );
-        fflush( stdout );
-
-        aspect = xsize / ysize;
-        ynarrow = ymax >= -ymin ? ymax : ymin;
-        min_aspect = geographic_aspect( ynarrow );
-        if (min_aspect < aspect * distortion_limit ) {
-            fprintf( stderr, "*** WARNING: " );
-            fprintf( stderr, "Map area too large.\n" );
-            fprintf( stderr, "***          " );
-            fprintf( stderr, "(Small-scale maps require data to be in Mercator projection.)\n" );
-            fprintf( stderr, "***          " );
-            fprintf( stderr, "This will degrade the quality of the result.\n" );
-        }
-    } else {
-        printf( "Assuming pixel aspect ratio of %5.3f.\n", xdim / ydim );
-        fflush( stdout );
-
-        if (proj_type != 2) {
-            if (ymax - ymin > max_meters || xmax - xmin > max_meters) {
-                fprintf( stderr, "*** WARNING: " );
-                fprintf( stderr, "Map area too large. (Small-scale maps require -mercator option.)\n" );
-                fprintf( stderr, "***          " );
-                fprintf( stderr, "This will degrade the quality of the result.\n" );
-            }
-        }
-    }
-}
-
-static double fix_azimuth(double az, double xdim, double ydim )
-{
-  double val;
-  val=rad2deg(atan(ydim/xdim*tan(deg2rad(az))));
-  if (az>90) {
-    val=val+180;
-  }
-  if (az>270) {
-    val=val+180;
-  }
-  return val;
-}
-
 #ifndef NOMAIN
 
 int main( int argc, const char *argv[] )
@@ -278,6 +124,7 @@ int main( int argc, const char *argv[] )
     char *in_dat_name;
     char *in_hdr_name;
     char *in_prj_name;
+    char *cache_name;
     char *out_dat_name;
     char *out_hdr_name;
     char *out_prj_name;
@@ -305,6 +152,7 @@ int main( int argc, const char *argv[] )
     enum Terrain_Coord_Type coord_type;
 
     int proj_type;
+    int in_is_tif;
     int has_nulls;
     int all_ints;
 
@@ -312,6 +160,12 @@ int main( int argc, const char *argv[] )
     double lat2 = 0.0;  // default unless -merc option used
     double center_lat;
     double temp;
+    int use_horizon = 0;    // search horizons by marching unless -horizon option used
+    double radius = -1.0;   // search distance in meters; default 10 pixels unless -radius used
+    double tolerance = 0.0; // sample full resolution unless -multiscale option used
+    long nthreads;
+    Horizon_Map horizons;
+    double xsize, ysize;
     // float *ptr;
 
     int error;
@@ -329,12 +183,6 @@ int main( int argc, const char *argv[] )
         usage_exit( "Not enough command-line parameters." );
     }
 
-    int i;
-    int j;
-    int num_x;  /* number of longitude cells (columns) */
-    int num_y;  /* number of latitude cells (rows) */
-    char c;
-
     argnum = 1;
     thisarg = argv[argnum++];
     // read decimal number
@@ -354,10 +202,18 @@ int main( int argc, const char *argv[] )
     // Validate filenames and open files:
 
     strncpy( extension, "flt", 4 );
-    get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension );
+    if (get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension,
+                       &in_is_tif ))
+    {
+        usage_exit( "Input filename must have .flt, .bil, or .tif extension (if any)." );
+    }
 
     strncpy( extension, "flt", 4 );
-    get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension );
+    if (get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension,
+                       NULL ))
+    {
+        usage_exit( "Output filename must have .flt extension (if any)." );
+    }
 
     if (!strcmp( in_hdr_name, out_hdr_name )) {
         usage_exit( "Input and outfile filenames must not be the same." );
@@ -396,6 +252,36 @@ int main( int argc, const char *argv[] )
             if (lat1 <= -90.0 || lat2 >= 90.0) {
                 usage_exit( "Mercator latitude limits must be between -90 and +90 (exclusive)." );
             }
+        } else if (strcmp( thisarg, "horizon" ) == 0) {
+            use_horizon = 1;
+        } else if (strcmp( thisarg, "radius" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -radius must be followed by a distance in meters." );
+            }
+            thisarg = argv[argnum++];
+            radius = strtod( thisarg, &endptr );
+            if (endptr == thisarg || *endptr != '\0' || radius < 0.0) {
+                usage_exit( "Option -radius must be followed by a distance in meters." );
+            }
+        } else if (strcmp( thisarg, "multiscale" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -multiscale must be followed by a positive tolerance." );
+            }
+            thisarg = argv[argnum++];
+            tolerance = strtod( thisarg, &endptr );
+            if (endptr == thisarg || *endptr != '\0' || tolerance <= 0.0) {
+                usage_exit( "Option -multiscale must be followed by a positive tolerance." );
+            }
+        } else if (strcmp( thisarg, "threads" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -threads must be followed by a number of threads." );
+            }
+            thisarg = argv[argnum++];
+            nthreads = strtol( thisarg, &endptr, 10 );
+            if (endptr == thisarg || *endptr != '\0' || nthreads < 0) {
+                usage_exit( "Option -threads must be followed by a number of threads." );
+            }
+            thread_pool_set_threads( (int)nthreads );
         } else if (strncmp( thisarg, "cellreg", 4 ) == 0 ||
                    strncmp( thisarg, "corner",  6 ) == 0)
         {
@@ -415,8 +301,14 @@ int main( int argc, const char *argv[] )
         }
     }
 
-    in_hdr_file = fopen( in_hdr_name, "rb" );   // use binary mode for compatibility
-    if (!in_hdr_file) {
+    // horizon cache file is named like .hdr file, with extension .hzn
+    cache_name = (char *)malloc( strlen( in_hdr_name ) + 1 );   // assume this malloc succeeds
+    strcpy( cache_name, in_hdr_name );
+    strcpy( cache_name + strlen( cache_name ) - 3, "hzn" );
+
+    // a GeoTIFF input file carries its own header
+    in_hdr_file = in_is_tif ? NULL : fopen( in_hdr_name, "rb" );  // use binary mode for compatibility
+    if (!in_is_tif && !in_hdr_file) {
         prefix_error();
         fprintf( stderr, "Could not open input file '%s'.\n", in_hdr_name );
         usage_exit( 0 );
@@ -449,28 +341,33 @@ int main( int argc, const char *argv[] )
     free( out_dat_name );
     free( out_hdr_name );
 
-    // Read .flt and .hdr files:
+    // Read .flt and .hdr (or .tif) files:
 
     printf( "Reading input files...\n" );
     fflush( stdout );
 
-    data = read_flt_hdr_files(
-        in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
-        &has_nulls, &all_ints, 0 );
+    if (in_is_tif) {
+        data = read_tif_file(
+            in_dat_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax, &has_nulls, &all_ints );
+    } else {
+        data = read_flt_hdr_files(
+            in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
+            &has_nulls, &all_ints, 0 );
+        fclose( in_hdr_file );
+    }
 
     fclose( in_dat_file );
-    fclose( in_hdr_file );
 
     if (has_nulls) {
         fprintf( stderr, "*** WARNING: " );
-        fprintf( stderr, "Input .flt file contains void (NODATA) points.\n" );
+        fprintf( stderr, "Input file contains void (NODATA) points.\n" );
         fprintf( stderr, "***          " );
         fprintf( stderr, "Assuming these are ocean points - setting these elevations to 0.\n" );
     }
 
     if (all_ints && detail > 0.0) {
         fprintf( stderr, "*** WARNING: " );
-        fprintf( stderr, "Input .flt file appears to contain only integer values.\n" );
+        fprintf( stderr, "Input file appears to contain only integer values.\n" );
         fprintf( stderr, "***          " );
         fprintf( stderr, "This may degrade the quality of the result.\n" );
     }
@@ -516,120 +413,62 @@ int main( int argc, const char *argv[] )
     }
 
     // check pixel aspect ratio and size of map extent
-    check_aspect( xmin, xmax, ymin, ymax, xdim, ydim, proj_type );
+    check_aspect( xmin, xmax, ymin, ymax, xdim, ydim, proj_type, 1 );
+
+    int dist_cutoff=10;
 
     float *skyview = (float *)malloc( (LONG)nrows * (LONG)ncols * sizeof( float ) );
 
-    float z_max=-999999;
+    if (!skyview) {
+        prefix_error();
+        fprintf( stderr, "Memory allocation error occurred.\n" );
+        exit( EXIT_FAILURE );
+    }
 
-    float *ptr;
-    float *ptr2;
-    float *ptr3;
+    // horizon distances must be in the same units as elevations
+    if (coord_type == TERRAIN_DEGREES) {
+        geographic_scale( center_lat, &xsize, &ysize );
+    } else {
+        xsize = ysize = 1.0;
+    }
 
-    double zval;
-    int lit;
-    int xp_int;
-    int yp_int;
-    int i_smooth=4;
+    if (use_horizon) {
+        get_horizon_map(
+            &horizons, cache_name, data, nrows, ncols, xdim * xsize, ydim * ysize, num_angles );
 
-    double const_deg_m=111132;
+        horizon_sky_view( &horizons, skyview );
 
-    double xp;
-    double yp;
+        free_horizon_map( &horizons );
+    } else if (tolerance > 0.0) {
+        error = multiscale_sky_view_factor(
+            data, skyview, nrows, ncols, xdim * xsize, ydim * ysize, num_angles,
+            radius > 0.0 ? radius : 0.0, tolerance );
 
-    int dist_cutoff=10;
-    double high_angles[num_angles];
-    double low_angles[num_angles];
-    double min_skyview=1;
-    double max_skyview=-1;
-    int a;
-    double this_angle;
-    double base_zval;
-    double this_zval;
-    double last_high_el;
-    double last_low_el;
-
-    double this_el;
-    double ang_x;
-    double ang_y;
-    int d_run;
-    double low_sum;
-    double high_sum;
-    double x;
-    double y;
-    int x_int;
-    int y_int;
-    int high_angle_count;
-    int low_angle_count;
-    double ang_d;
-
-    for(i=0;i<nrows;i++) {
-      ptr = data + (LONG)i * (LONG)ncols;
-      ptr2 = skyview + (LONG)i * (LONG)ncols;
-      for(j=0;j<ncols;j++) {
-        for(a=0;a<num_angles;a++) {
-          this_angle=deg2rad(fix_azimuth(a*360/num_angles, xdim, ydim)); // Fix azimuth
-          x=j;
-          y=i;
-          base_zval=ptr[j];
-          last_low_el=deg2rad(90);
-          last_high_el=deg2rad(-90);
-          x_int=x;
-          y_int=y;
-          d_run=0;
-          ang_x=sin(this_angle);
-          ang_y=cos(this_angle);
-          ang_d=sqrt(xdim*xdim*ang_x*ang_x+ydim*ydim*ang_y*ang_y);
-
-
-          while(x_int > 0 && x_int < ncols && y_int > 0 && y_int < nrows && d_run <= dist_cutoff) {
-            d_run++;
-            x=x+ang_x;
-            y=y+ang_y;
-            x_int=(int) x;
-            y_int=(int) y;
-            if (x_int < 0 || y_int < 0 || x_int >= ncols | y_int >= nrows) {
-              break;
-            }
-            ptr3 = data + (LONG)y_int * (LONG)ncols;
+        if (error) {
+            prefix_error();
+            fprintf( stderr, "Memory allocation error occurred during processing of data.\n" );
+            exit( EXIT_FAILURE );
+        }
+    } else if (radius >= 0.0) {
+        error = sweep_sky_view_factor(
+            data, skyview, nrows, ncols, xdim * xsize, ydim * ysize, num_angles, radius );
 
-            this_zval=ptr3[x_int];
-            this_el=atan((this_zval-base_zval)/(d_run*ang_d));
-            if (this_el > last_high_el) {
-              last_high_el = this_el;
-            }
-            if (this_el < last_low_el) {
-              last_low_el = this_el;
-            }
-          }
-          high_angles[a]=last_high_el;
-          low_angles[a]=last_low_el;
+        if (error) {
+            prefix_error();
+            fprintf( stderr, "Memory allocation error occurred during processing of data.\n" );
+            exit( EXIT_FAILURE );
         }
-        high_sum=0;
-        low_sum=0;
-        high_angle_count=0;
-        low_angle_count=0;
-        for(int k=0;k<num_angles;k++) {
-          if (high_angles[k] > deg2rad(-70)) {
-            high_angle_count++;
-            high_sum=high_sum+sin(high_angles[k]);
-          }
-          if (low_angles[k] < deg2rad(70)) {
-            low_angle_count++;
-            low_sum=low_sum+sin(low_angles[k]);
-          }
+    } else {
+        error = sky_view_factor( data, skyview, nrows, ncols, xdim, ydim, num_angles, dist_cutoff );
+
+        if (error) {
+            prefix_error();
+            fprintf( stderr, "Memory allocation error occurred during processing of data.\n" );
+            exit( EXIT_FAILURE );
         }
-        // skyview[i][j]=((high_sum)/high_angle_count + (low_sum)/low_angle_count)/2;
-        ptr2[j]=((high_sum)/high_angle_count);
-      }
     }
 
-    if (error) {
-        assert( error == TERRAIN_FILTER_MALLOC_ERROR );
-        prefix_error();
-        fprintf( stderr, "Memory allocation error occurred during processing of data.\n" );
-        exit( EXIT_FAILURE );
-    }
+    free( cache_name );
 
     // if (lat1 != lat2) {
     //     fix_mercator( data, detail, nrows, ncols, lat1, lat2 );
@@ -646,7 +485,7 @@ int main( int argc, const char *argv[] )
     fclose( out_dat_file );
     fclose( out_hdr_file );
 
-    free( data );
+    free_flt_data( data );
     free( software );
 
     // Copy optional .prj file:
@@ -42,6 +42,7 @@
 #include <stddef.h> // for ptrdiff_t
 #include <stdlib.h>
 #include <math.h>
+#include <assert.h>
 
 // For a 64-bit compile we need LONG to be 64 bits, even if the compiler uses an LLP64 model
 #define LONG ptrdiff_t
@@ -118,6 +119,53 @@ void terrain_image_data(
     }
 }
 
+void terrain_image_bytes(
+    const float *data,  // input: array of data to convert (row-major order)
+    unsigned char *image,
+                        // output: array of image pixels (row-major order)
+    int    nrows,       // input: number of rows    in data array
+    int    ncols,       // input: number of columns in data array
+    double vertical_enhancement,
+                        // input: as for terrain_image_data()
+    int    image_min,   // input: minimum value for output pixels (0 to 255)
+    int    image_max,   // input: maximum value for output pixels (0 to 255)
+    int    nodata       // input: value for void data points (0 to 255)
+)
+// Converts output of terrain_filter() to 8-bit grayscale image pixels;
+// selects tone curve based on vertical_enhancement parameter.
+{
+    int i, j;
+    const float   *ptr;
+    unsigned char *pixels;
+
+    double factor;
+    double half_span, image_mean;
+
+    // Transform data values using the requested vertical enhancement:
+
+    factor = pow( 2.0, vertical_enhancement * 0.5 - 1.0 );
+
+    half_span  = 0.5 * (image_max - image_min);
+    image_mean = 0.5 * (image_max + image_min) + 0.5;   // plus 0.5 to round
+
+    // CONCURRENCY NOTE: The iterations of the loops below will be
+    // independent and can be executed in parallel, if each thread has
+    // its own "ptr" and "pixels" variables initialized as for "ptr" in
+    // terrain_image_data().
+    for (i=0, ptr=data, pixels=image; i<nrows; ++i, ptr+=ncols, pixels+=ncols) {
+        for (j=0; j<ncols; ++j) {
+            if (flt_isnan( ptr[j] )) {
+                pixels[j] = (unsigned char)nodata;
+            } else {
+                // same mapping as terrain_image_data(), then truncation
+                // (tanh() is within [-1,1], so the result is in range)
+                double z = tanh( ptr[j] * factor );
+                pixels[j] = (unsigned char)(z * half_span + image_mean);
+            }
+        }
+    }
+}
+
 
 static double conformal_lat( double lat )
 {
@@ -586,50 +634,44 @@ static void cleanup_operator(
 }
 
 
-static void two_dcts(
+// Performs count DCTs on consecutive rows of length elements starting at ptr,
+// where count is at most plan->ndata. Any unused plan buffers are filled with
+// copies of the first row, so fewer rows take the same time as plan->ndata rows;
+// it is therefore preferred to pass count == plan->ndata whenever possible.
+static void multiple_dcts(
     float *ptr,
     int    length,
+    int    count,
     const struct Dct_Plan *plan
 )
 {
-    int j;
-    float *ptr2 = ptr + length;
+    int j, k;
+    int stride = plan->stride;
 
-    for (j=0; j<length; ++j) {
-        plan->in_data[0][j] = (double)ptr[j];
-    }
-    for (j=0; j<length; ++j) {
-        plan->in_data[1][j] = (double)ptr2[j];
-    }
+    assert( count >= 1 && count <= plan->ndata );
 
-    perform_dcts( plan );
-
-    for (j=0; j<length; ++j) {
-        ptr[j] = (float)plan->out_data[0][j];
-    }
-    for (j=0; j<length; ++j) {
-        ptr2[j] = (float)plan->out_data[1][j];
+    for (k=0; k<count; ++k) {
+        const float *row = ptr + (LONG)k * (LONG)length;
+        double *buf = plan->in_data[k];
+        for (j=0; j<length; ++j) {
+            buf[j*stride] = (double)row[j];
+        }
     }
-}
-
-// Note: single_dct() takes the same time as two_dcts() but does half the work,
-// so it is preferred to use two_dcts() whenever possible.
-static void single_dct(
-    float *ptr,
-    int    length,
-    const struct Dct_Plan *plan
-)
-{
-    int j;
-
-    for (j=0; j<length; ++j) {
-        plan->in_data[0][j] = plan->in_data[1][j] = (double)ptr[j];
+    for (k=count; k<plan->ndata; ++k) {
+        double *buf = plan->in_data[k];
+        for (j=0; j<length; ++j) {
+            buf[j*stride] = (double)ptr[j];
+        }
     }
 
     perform_dcts( plan );
 
-    for (j=0; j<length; ++j) {
-        ptr[j] = (float)plan->out_data[0][j];
+    for (k=0; k<count; ++k) {
+        float *row = ptr + (LONG)k * (LONG)length;
+        const double *buf = plan->out_data[k];
+        for (j=0; j<length; ++j) {
+            row[j] = (float)buf[j*stride];
+        }
     }
 }
 
@@ -787,7 +829,7 @@ int terrain_filter(
 
     int type_fwd, type_bwd;
 
-    int i, j;
+    int i, j, count;
     float *ptr;
 
     float data_min, data_max;
@@ -878,18 +920,15 @@ int terrain_filter(
             return TERRAIN_FILTER_MALLOC_ERROR;
         }
 
-        for (i=0; i<nrows-1; i+=2) {
+        for (i=0; i<nrows; i+=count) {
             float *ptr = data + (LONG)i * (LONG)ncols;
-            two_dcts( ptr, ncols, &dct_plan );
-            if (progress && update_progress( &progress_info, i+2, nrows ))
+            count = nrows - i < dct_plan.ndata ? nrows - i : dct_plan.ndata;
+            multiple_dcts( ptr, ncols, count, &dct_plan );
+            if (progress && update_progress( &progress_info, i+count, nrows ))
             {
                 return TERRAIN_FILTER_CANCELED;
             }
         }
-        if (nrows & 1) {
-            float *ptr = data + (LONG)(nrows - 1) * (LONG)ncols;
-            single_dct( ptr, ncols, &dct_plan );
-        }
 
         cleanup_dcts( &dct_plan );
     }
@@ -927,28 +966,25 @@ int terrain_filter(
             return TERRAIN_FILTER_MALLOC_ERROR;
         }
 
-        for (i=0; i<ncols-1; i+=2) {
+        assert( fwd_plan.ndata == bwd_plan.ndata );
+
+        for (i=0; i<ncols; i+=count) {
             float *ptr = data + (LONG)i * (LONG)nrows;
+            int k;
 
-            two_dcts( ptr, nrows, &fwd_plan );
-            apply_operator( data, i,   nrows, info );
-            apply_operator( data, i+1, nrows, info );
-            two_dcts( ptr, nrows, &bwd_plan );
+            count = ncols - i < fwd_plan.ndata ? ncols - i : fwd_plan.ndata;
+            multiple_dcts( ptr, nrows, count, &fwd_plan );
+            for (k=0; k<count; ++k) {
+                apply_operator( data, i+k, nrows, info );
+            }
+            multiple_dcts( ptr, nrows, count, &bwd_plan );
 
-            if (progress && update_progress( &progress_info, i+2, ncols ))
+            if (progress && update_progress( &progress_info, i+count, ncols ))
             {
                 return TERRAIN_FILTER_CANCELED;
             }
         }
 
-        if (ncols & 1) {
-            float *ptr = data + (LONG)(ncols - 1) * (LONG)nrows;
-
-            single_dct( ptr, nrows, &fwd_plan );
-            apply_operator( data, ncols-1, nrows, info );
-            single_dct( ptr, nrows, &bwd_plan );
-        }
-
         cleanup_dcts( &bwd_plan );
         cleanup_dcts( &fwd_plan );
     }
@@ -988,18 +1024,15 @@ int terrain_filter(
             return TERRAIN_FILTER_MALLOC_ERROR;
         }
 
-        for (i=0; i<nrows-1; i+=2) {
+        for (i=0; i<nrows; i+=count) {
             float *ptr = data + (LONG)i * (LONG)ncols;
-            two_dcts( ptr, ncols, &dct_plan );
-            if (progress && update_progress( &progress_info, i+2, nrows ))
+            count = nrows - i < dct_plan.ndata ? nrows - i : dct_plan.ndata;
+            multiple_dcts( ptr, ncols, count, &dct_plan );
+            if (progress && update_progress( &progress_info, i+count, nrows ))
             {
                 return TERRAIN_FILTER_CANCELED;
             }
         }
-        if (nrows & 1) {
-            float *ptr = data + (LONG)(nrows - 1) * (LONG)ncols;
-            single_dct( ptr, ncols, &dct_plan );
-        }
 
         cleanup_dcts( &dct_plan );
     }
@@ -159,6 +159,22 @@ void terrain_image_data(
     double image_max    // input: maximum value for output pixels
 );
 
+// Converts output of terrain_filter() to 8-bit grayscale image pixels, with
+// the same tone curve as terrain_image_data(), rounding to the nearest value.
+// Void (NaN) data points are set to the nodata value.
+void terrain_image_bytes(
+    const float *data,  // input: array of data to convert (row-major order)
+    unsigned char *image,
+                        // output: array of image pixels (row-major order)
+    int    nrows,       // input: number of rows    in data array
+    int    ncols,       // input: number of columns in data array
+    double vertical_enhancement,
+                        // input: as for terrain_image_data()
+    int    image_min,   // input: minimum value for output pixels (0 to 255)
+    int    image_max,   // input: maximum value for output pixels (0 to 255)
+    int    nodata       // input: value for void data points (0 to 255)
+);
+
 
 // MISCELLANEOUS UTILITY FUNCTIONS:
 // ===============================
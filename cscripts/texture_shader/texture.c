@@ -34,6 +34,7 @@
 #include "read_grid_files.h"
 #include "write_grid_files.h"
 #include "terrain_filter.h"
+#include "tool_support.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -52,38 +53,6 @@ static const char sw_format[] = "%s v%s %s";
 
 static const char *command_name;
 
-static const char *get_command_name( const char *argv[] )
-{
-    const char *colon;
-    const char *slash;
-    const char *result;
-
-    colon = strchr( argv[0], ':' );
-    if (colon) {
-        ++colon;
-    } else {
-        colon = argv[0];
-    }
-    slash = strrchr( colon, '/' );
-    if (slash) {
-        ++slash;
-    } else {
-        slash = colon;
-    }
-    result = strrchr( slash, '\\' );
-    if (result) {
-        ++result;
-    } else {
-        result = slash;
-    }
-    return result;
-}
-
-static void prefix_error()
-{
-    fprintf( stderr, "\n*** ERROR: " );
-}
-
 static void usage_exit( const char *message )
 {
     if (message) {
@@ -101,7 +70,9 @@ static void usage_exit( const char *message )
     fprintf( stderr, "(Either decimal or fraction is accepted.)\n" );
     fprintf( stderr, "\n" );
     fprintf( stderr, "Requires both .flt and .hdr files as input  " );
-    fprintf( stderr, "(e.g., rainier_elev.flt and rainier_elev.hdr).\n" );
+    fprintf( stderr, "(e.g., rainier_elev.flt and rainier_elev.hdr),\n" );
+    fprintf( stderr, "integer .bil and .hdr files (e.g., rainier_elev.bil),\n" );
+    fprintf( stderr, "or an uncompressed GeoTIFF file (e.g., rainier_elev.tif).\n" );
     fprintf( stderr, "Writes   both .flt and .hdr files as output " );
     fprintf( stderr, "(e.g., rainier_tex.flt  and rainier_tex.hdr).\n" );
     fprintf( stderr, "Also reads & writes optional .prj file if present " );
@@ -117,132 +88,6 @@ static void usage_exit( const char *message )
     exit( EXIT_FAILURE );
 }
 
-static void get_filenames(
-    const char *arg, char **data_name, char **hdr_name, char **prj_name, char *ext )
-// NOTE: caller is responsible to free pointers *data_name, *hdr_name, and *prj_name!
-{
-    const char *dot;
-
-    size_t len = strlen( arg );
-
-    *data_name = (char *)malloc( len+5 );   // add 5 for ".", extension, and null terminator
-    *hdr_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-    *prj_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-
-    dot = strrchr( arg, '.' );
-
-    if (dot++ && !strpbrk( dot, "/\\" ) && strlen( dot ) <= 4) {
-        // filename has extension (of up to 4 characters)
-        strncpy( ext, dot, strlen( ext ) );
-        if (strcmp( dot, "flt" ) != 0 && strcmp( dot, "FLT" ) != 0)
-        {
-            usage_exit( "Filenames must have .flt extension (if any)." );
-        }
-        strcpy ( *data_name, arg );
-        strncpy( *hdr_name, arg, len-3 );
-        strncpy( *prj_name, arg, len-3 );
-        strcpy ( *hdr_name+len-3, "hdr" );
-        strcpy ( *prj_name+len-3, "prj" );
-    } else {
-        // filename does not have extension
-        strncpy( *data_name, arg, len );
-        (*data_name)[len] = '.';
-        strncpy( *data_name+len+1, ext, 3 );    // max 3 chars default extension
-        (*data_name)[len+4] = '\0';
-        strncpy( *hdr_name, arg, len );
-        strncpy( *prj_name, arg, len );
-        strcpy ( *hdr_name+len, ".hdr" );
-        strcpy ( *prj_name+len, ".prj" );
-    }
-}
-
-static int print_progress( float portion, float steps_done, int total_steps, void *state )
-{
-    int *last_count = (int *)state;
-    int  this_count = (int)steps_done;
-
-    if (this_count > *last_count) {
-        printf( "Processing phase %d...\n", this_count + 1 );
-        fflush( stdout );
-        *last_count = this_count;
-    }
-
-    return 0;
-}
-
-// Returns -1 for geographic coordinates, +1 for projected coordinates, 0 if unable to determine
-static int determine_projection(
-    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim )
-{
-    // Determine projection type:
-
-    if  ( (ydim <    0.02 && xdim <   0.02) &&
-          (xmin > -180.01 && xmax < 180.01) &&
-          (ymin >  -90.01 && ymax <  90.01) )
-    {
-        return -1;  // lat/lon (geographic) coordinates
-    } else if
-        // Kyle Bradley December 2020 : dim check interferes with along-topo grid in km/km units
-        // ( (ydim >    0.09 && xdim >   0.09) &&
-        ( (xmin < -181.00 || xmax > 181.00) &&
-          (ymin <  -91.00 || ymax >  91.00) )
-    {
-        return +1;  // projected into linear coordinates (easting/northing)
-    }
-
-    return 0;   // unable to determine correct projection type
-}
-
-static void check_aspect(
-    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim,
-    int proj_type )
-{
-    // Check pixel aspect ratio and size of map extent:
-
-    const double max_meters = 1000000.0;        // = 1000 kilometers
-    const double distortion_limit = 15.0/16.0;  // must be < 1
-
-    double xsize, ysize;
-    double xres,  yres;
-    double aspect;
-    double ynarrow;
-    double min_aspect;
-
-    if (proj_type < 0) {
-        geographic_scale( 0.5 * (ymin + ymax), &xsize, &ysize );
-
-        xres = xsize * xdim;
-        yres = ysize * ydim;
-
-        printf( "Assuming pixel aspect ratio of %5.3f based on latitude range.\n", xres / yres );
-        fflush( stdout );
-
-        aspect = xsize / ysize;
-        ynarrow = ymax >= -ymin ? ymax : ymin;
-        min_aspect = geographic_aspect( ynarrow );
-        if (min_aspect < aspect * distortion_limit ) {
-            fprintf( stderr, "*** WARNING: " );
-            fprintf( stderr, "Map area too large.\n" );
-            fprintf( stderr, "***          " );
-            fprintf( stderr, "(Small-scale maps require data to be in Mercator projection.)\n" );
-            fprintf( stderr, "***          " );
-            fprintf( stderr, "This will degrade the quality of the result.\n" );
-        }
-    } else {
-        printf( "Assuming pixel aspect ratio of %5.3f.\n", xdim / ydim );
-        fflush( stdout );
-
-        if (proj_type != 2) {
-            if (ymax - ymin > max_meters || xmax - xmin > max_meters) {
-                fprintf( stderr, "*** WARNING: " );
-                fprintf( stderr, "Map area too large. (Small-scale maps require -mercator option.)\n" );
-                fprintf( stderr, "***          " );
-                fprintf( stderr, "This will degrade the quality of the result.\n" );
-            }
-        }
-    }
-}
-
 #ifndef NOMAIN
 
 int main( int argc, const char *argv[] )
@@ -289,6 +134,7 @@ int main( int argc, const char *argv[] )
     enum Terrain_Coord_Type coord_type;
 
     int proj_type;
+    int in_is_tif;
     int has_nulls;
     int all_ints;
 
@@ -341,10 +187,18 @@ int main( int argc, const char *argv[] )
     // Validate filenames and open files:
 
     strncpy( extension, "flt", 4 );
-    get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension );
+    if (get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension,
+                       &in_is_tif ))
+    {
+        usage_exit( "Input filename must have .flt, .bil, or .tif extension (if any)." );
+    }
 
     strncpy( extension, "flt", 4 );
-    get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension );
+    if (get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension,
+                       NULL ))
+    {
+        usage_exit( "Output filename must have .flt extension (if any)." );
+    }
 
     if (!strcmp( in_hdr_name, out_hdr_name )) {
         usage_exit( "Input and outfile filenames must not be the same." );
@@ -402,8 +256,9 @@ int main( int argc, const char *argv[] )
         }
     }
 
-    in_hdr_file = fopen( in_hdr_name, "rb" );   // use binary mode for compatibility
-    if (!in_hdr_file) {
+    // a GeoTIFF input file carries its own header
+    in_hdr_file = in_is_tif ? NULL : fopen( in_hdr_name, "rb" );  // use binary mode for compatibility
+    if (!in_is_tif && !in_hdr_file) {
         prefix_error();
         fprintf( stderr, "Could not open input file '%s'.\n", in_hdr_name );
         usage_exit( 0 );
@@ -436,28 +291,33 @@ int main( int argc, const char *argv[] )
     free( out_dat_name );
     free( out_hdr_name );
 
-    // Read .flt and .hdr files:
+    // Read .flt and .hdr (or .tif) files:
 
     printf( "Reading input files...\n" );
     fflush( stdout );
 
-    data = read_flt_hdr_files(
-        in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
-        &has_nulls, &all_ints, 0 );
+    if (in_is_tif) {
+        data = read_tif_file(
+            in_dat_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax, &has_nulls, &all_ints );
+    } else {
+        data = read_flt_hdr_files(
+            in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
+            &has_nulls, &all_ints, 0 );
+        fclose( in_hdr_file );
+    }
 
     fclose( in_dat_file );
-    fclose( in_hdr_file );
 
     if (has_nulls) {
         fprintf( stderr, "*** WARNING: " );
-        fprintf( stderr, "Input .flt file contains void (NODATA) points.\n" );
+        fprintf( stderr, "Input file contains void (NODATA) points.\n" );
         fprintf( stderr, "***          " );
         fprintf( stderr, "Assuming these are ocean points - setting these elevations to 0.\n" );
     }
 
     if (all_ints && detail > 0.0) {
         fprintf( stderr, "*** WARNING: " );
-        fprintf( stderr, "Input .flt file appears to contain only integer values.\n" );
+        fprintf( stderr, "Input file appears to contain only integer values.\n" );
         fprintf( stderr, "***          " );
         fprintf( stderr, "This may degrade the quality of the result.\n" );
     }
@@ -503,7 +363,7 @@ int main( int argc, const char *argv[] )
     }
 
     // check pixel aspect ratio and size of map extent
-    check_aspect( xmin, xmax, ymin, ymax, xdim, ydim, proj_type );
+    check_aspect( xmin, xmax, ymin, ymax, xdim, ydim, proj_type, 1 );
 
     if (detail <= 0.0 || detail > 2.0) {
         fprintf( stderr, "*** WARNING: " );
@@ -540,7 +400,7 @@ int main( int argc, const char *argv[] )
     fclose( out_dat_file );
     fclose( out_hdr_file );
 
-    free( data );
+    free_flt_data( data );
     free( software );
 
     // Copy optional .prj file:
@@ -34,6 +34,8 @@
 #include "read_grid_files.h"
 #include "write_grid_files.h"
 #include "terrain_filter.h"
+#include "thread_pool.h"
+#include "tool_support.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -50,38 +52,6 @@ static const char sw_format[] = "%s%s%s v%s %s";
 
 static const char *command_name;
 
-static const char *get_command_name( const char *argv[] )
-{
-    const char *colon;
-    const char *slash;
-    const char *result;
-    
-    colon = strchr( argv[0], ':' );
-    if (colon) {
-        ++colon;
-    } else {
-        colon = argv[0];
-    }
-    slash = strrchr( colon, '/' );
-    if (slash) {
-        ++slash;
-    } else {
-        slash = colon;
-    }
-    result = strrchr( slash, '\\' );
-    if (result) {
-        ++result;
-    } else {
-        result = slash;
-    }
-    return result;
-}
-
-static void prefix_error()
-{
-    fprintf( stderr, "\n*** ERROR: " );
-}
-
 static void usage_exit( const char *message )
 {
     if (message) {
@@ -89,7 +59,7 @@ static void usage_exit( const char *message )
         fprintf( stderr, "%s\n", message );
     }
     fprintf( stderr, "\n" );
-    fprintf( stderr, "USAGE:    %s contrast texture_file output_file\n",   command_name );
+    fprintf( stderr, "USAGE:    %s contrast texture_file output_file [options]\n", command_name );
     fprintf( stderr, "Examples: %s 2.5 rainier_tex.flt rainier_img.tif\n", command_name );
     fprintf( stderr, "          %s  -1 rainier_tex rainier_img\n",         command_name );
     fprintf( stderr, "\n" );
@@ -104,57 +74,34 @@ static void usage_exit( const char *message )
     fprintf( stderr, "Input and output filenames must not be the same.\n" );
     fprintf( stderr, "NOTE: Output files will be overwritten if they already exist.\n" );
     fprintf( stderr, "\n" );
+    fprintf( stderr, "Available options:\n" );
+    fprintf( stderr, "    -compress              " );
+    fprintf( stderr, "write LZW-compressed tiles, if smaller (slower to write)\n" );
+    fprintf( stderr, "    -overviews             " );
+    fprintf( stderr, "with -compress, add overviews at 1/2, 1/4, ... resolution\n" );
+    fprintf( stderr, "                           " );
+    fprintf( stderr, "(tiled, but uncompressed if LZW would not be smaller)\n" );
+    fprintf( stderr, "    -8bit                  " );
+    fprintf( stderr, "write 8-bit pixels (0 to 255) instead of 16-bit (0 to 65535)\n" );
+    fprintf( stderr, "    -nodata n              " );
+    fprintf( stderr, "with -8bit, reserve value n (0 or 255) for void pixels\n" );
+    fprintf( stderr, "    -epsg n                " );
+    fprintf( stderr, "record coordinate system EPSG:n (e.g., 3395) in GeoTIFF tags\n" );
+    fprintf( stderr, "                           " );
+    fprintf( stderr, "(default 4326 for lat/lon input, otherwise unspecified;\n" );
+    fprintf( stderr, "                           " );
+    fprintf( stderr, "codes 4000 to 4999 are geographic, all others projected)\n" );
+    fprintf( stderr, "    -threads n             " );
+    fprintf( stderr, "use n threads (default 0 = one per processor)\n" );
+    fprintf( stderr, "\n" );
     exit( EXIT_FAILURE );
 }
 
-static void get_filenames(
-    const char *arg, char **data_name, char **hdr_name, char **prj_name, char *ext, char *hdr )
-// NOTE: caller is responsible to free pointers *data_name, *hdr_name, and *prj_name!
-{
-    const char *dot;
-
-    size_t len = strlen( arg );
-
-    *data_name = (char *)malloc( len+5 );   // add 5 for ".", extension, and null terminator
-    *hdr_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-    *prj_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
-
-    dot = strrchr( arg, '.' );
-
-    if (dot++ && !strpbrk( dot, "/\\" ) && strlen( dot ) <= 4) {
-        // filename has extension (of up to 4 characters)
-        strncpy( ext, dot, strlen( ext ) );
-        if (strcmp( dot, "flt" ) != 0 && strcmp( dot, "FLT" ) != 0 &&
-            strcmp( dot, "tif" ) != 0 && strcmp( dot, "TIF" ) != 0)
-        {
-            usage_exit( "Filenames must have .flt or .tif extension (if any)." );
-        }
-        strcpy ( *data_name, arg );
-        strncpy( *hdr_name, arg, len-3 );
-        strncpy( *hdr_name+len-3, hdr, 3 );
-        (*hdr_name)[len] = '\0';
-        strncpy( *prj_name, arg, len-3 );
-        strcpy ( *prj_name+len-3, "prj" );
-    } else {
-        // filename does not have extension
-        strncpy( *data_name, arg, len );
-        (*data_name)[len] = '.';
-        strncpy( *data_name+len+1, ext, 3 );    // max 3 chars default extension
-        (*data_name)[len+4] = '\0';
-        strncpy( *hdr_name, arg, len );
-        (*hdr_name)[len] = '.';
-        strncpy( *hdr_name+len+1, hdr, 3 );
-        (*hdr_name)[len+4] = '\0';
-        strncpy( *prj_name, arg, len );
-        strcpy ( *prj_name+len, ".prj" );
-    }
-}
-
 #ifndef NOMAIN
 
 int main( int argc, const char *argv[] )
 {
-    const int numargs = 4;  // including command name
+    const int minargs = 4;  // including command name
     
     int argnum;
 
@@ -170,6 +117,14 @@ int main( int argc, const char *argv[] )
     char *out_prj_name;
 
     double contrast;
+    int    compress  = 0;
+    int    overviews = 0;
+    int    bits8     = 0;
+    int    nodata    = -1;   // none
+    int    epsg      = 0;    // unknown
+    int    geographic;
+    int    proj_type;
+    long   nthreads;
 
     FILE *in_dat_file;
     FILE *in_hdr_file;
@@ -185,6 +140,8 @@ int main( int argc, const char *argv[] )
     double ymin;
     double ymax;
     float *data;
+    unsigned char *pixels;
+    Flt_Reader *reader;
     char *software1;
     char *software2;
     char *separator;
@@ -201,10 +158,8 @@ int main( int argc, const char *argv[] )
 
     if (argc == 1) {
         usage_exit( 0 );
-    } else if (argc < numargs) {
+    } else if (argc < minargs) {
         usage_exit( "Not enough command-line parameters." );
-    } else if (argc > numargs) {
-        usage_exit( "Too many command-line parameters." );
     }
     
     argnum = 1;
@@ -218,17 +173,77 @@ int main( int argc, const char *argv[] )
     // Validate filenames and open files:
 
     strncpy( extension, "flt", 4 );
-    get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension, "hdr" );
-    if (strcmp( extension, "flt" ) != 0 && strcmp( extension, "FLT" ) != 0) {
+    if (get_filenames( argv[argnum++], &in_dat_name, &in_hdr_name, &in_prj_name, extension,
+                       NULL ))
+    {
         usage_exit( "Input filename must have .flt extension (if any)." );
     }
     
     strncpy( extension, "tif", 4 );
-    get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension, "tfw" );
-    
-    if (strcmp( extension, "tif" ) != 0 && strcmp( extension, "TIF" ) != 0) {
+    if (get_filenames( argv[argnum++], &out_dat_name, &out_hdr_name, &out_prj_name, extension,
+                       NULL ))
+    {
         usage_exit( "Output filename must have .tif extension (if any)." );
     }
+    // the .tif file's companion is a .tfw (world) file, not a .hdr file
+    strcpy( out_hdr_name + strlen( out_hdr_name ) - 3, "tfw" );
+    
+    while (argnum < argc) {
+        thisarg = argv[argnum++];
+        if (*thisarg != '-') {
+            prefix_error();
+            fprintf( stderr, "Extra command-line parameter '%s' not recognized.\n", thisarg );
+            usage_exit( 0 );
+        }
+        ++thisarg;
+        if (strcmp( thisarg, "compress" ) == 0) {
+            compress = 1;
+        } else if (strcmp( thisarg, "overviews" ) == 0) {
+            overviews = 1;
+        } else if (strcmp( thisarg, "8bit" ) == 0) {
+            bits8 = 1;
+        } else if (strcmp( thisarg, "nodata" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -nodata must be followed by a value of 0 or 255." );
+            }
+            thisarg = argv[argnum++];
+            nodata = (int)strtol( thisarg, &endptr, 10 );
+            if (endptr == thisarg || *endptr != '\0' || (nodata != 0 && nodata != 255)) {
+                usage_exit( "Option -nodata must be followed by a value of 0 or 255." );
+            }
+        } else if (strcmp( thisarg, "epsg" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -epsg must be followed by an EPSG code." );
+            }
+            thisarg = argv[argnum++];
+            epsg = (int)strtol( thisarg, &endptr, 10 );
+            if (endptr == thisarg || *endptr != '\0' || epsg < 1024 || epsg > 32766) {
+                usage_exit( "Option -epsg must be followed by an EPSG code." );
+            }
+        } else if (strcmp( thisarg, "threads" ) == 0) {
+            if (argnum >= argc) {
+                usage_exit( "Option -threads must be followed by a number of threads." );
+            }
+            thisarg = argv[argnum++];
+            nthreads = strtol( thisarg, &endptr, 10 );
+            if (endptr == thisarg || *endptr != '\0' || nthreads < 0) {
+                usage_exit( "Option -threads must be followed by a number of threads." );
+            }
+            thread_pool_set_threads( (int)nthreads );
+        } else {
+            prefix_error();
+            fprintf( stderr, "Command-line option '-%s' not recognized.\n", thisarg );
+            usage_exit( 0 );
+        }
+    }
+    
+    if (nodata >= 0 && !bits8) {
+        usage_exit( "Option -nodata requires option -8bit." );
+    }
+    
+    if (overviews && !compress) {
+        usage_exit( "Option -overviews requires option -compress." );
+    }
     
     if (!strcmp( in_prj_name, out_prj_name )) {
         usage_exit( "Input and outfile filenames must not be the same." );
@@ -273,11 +288,23 @@ int main( int argc, const char *argv[] )
     printf( "Reading input files...\n" );
     fflush( stdout );
 
-    data = read_flt_hdr_files(
-        in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
-        &has_nulls, &all_ints, &software1 );
+    if (nodata >= 0) {
+        // read void points as NaN, for terrain_image_bytes() to mark them
+        keep_flt_voids( 1 );
+    }
+
+    if (bits8) {
+        // 8-bit pixels are converted from blocks of rows as they are read
+        reader = open_flt_reader(
+            in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
+            &software1 );
+    } else {
+        data = read_flt_hdr_files(
+            in_dat_file, in_hdr_file, &nrows, &ncols, &xmin, &xmax, &ymin, &ymax,
+            &has_nulls, &all_ints, &software1 );
     
-    fclose( in_dat_file );
+        fclose( in_dat_file );
+    }
     fclose( in_hdr_file );
     
     if (software1) {
@@ -299,6 +326,27 @@ int main( int argc, const char *argv[] )
         free( software1 );
     }
 
+    // Coordinate system for GeoTIFF tags:
+
+    proj_type = determine_projection(
+        xmin, xmax, ymin, ymax, (xmax - xmin) / (double)ncols, (ymax - ymin) / (double)nrows );
+    if (epsg) {
+        // an explicit code decides the model type (EPSG geographic systems are 4000-4999)
+        geographic = epsg >= 4000 && epsg <= 4999;
+        if (proj_type != 0 && geographic != (proj_type < 0)) {
+            fprintf( stderr, "*** WARNING: " );
+            fprintf( stderr, "EPSG:%d is a %s coordinate system, ", epsg,
+                     geographic ? "geographic" : "projected" );
+            fprintf( stderr, "but input coordinates appear to be %s.\n",
+                     geographic ? "projected" : "lat/lon" );
+        }
+    } else {
+        geographic = proj_type < 0;
+        if (geographic) {
+            epsg = 4326;    // WGS 84
+        }
+    }
+
     // Process data:
 
     printf(
@@ -308,21 +356,60 @@ int main( int argc, const char *argv[] )
 
     // Adjust contrast:
     
-    // set vertical enhancement parameter and set range to 0..65535
-    terrain_image_data( data, nrows, ncols, contrast, 0.0, 65535.0 );
+    if (bits8) {
+        const float *rows;
+        int first = 0;
+        int count;
+
+        // about 4 MB of input per block, so the whole input is never in memory
+        int block_rows = (1 << 20) / ncols;
+        if (block_rows < 1) {
+            block_rows = 1;
+        }
+
+        pixels = (unsigned char *)malloc( (size_t)nrows * (size_t)ncols );
+        if (!pixels) {
+            prefix_error();
+            fprintf( stderr, "Memory allocation error occurred.\n" );
+            exit( EXIT_FAILURE );
+        }
+
+        // set vertical enhancement parameter and set range to 0..255,
+        // leaving out the nodata value (if any) for void pixels
+        while ((rows = next_flt_rows( reader, block_rows, &count )) != NULL) {
+            terrain_image_bytes(
+                rows, pixels + (size_t)first * (size_t)ncols, count, ncols, contrast,
+                nodata == 0 ? 1 : 0, nodata == 255 ? 254 : 255, nodata < 0 ? 0 : nodata );
+            first += count;
+        }
+
+        close_flt_reader( reader );
+        fclose( in_dat_file );
+    } else {
+        // set vertical enhancement parameter and set range to 0..65535
+        terrain_image_data( data, nrows, ncols, contrast, 0.0, 65535.0 );
+    }
     
     // Write .tif and .tfw files:
 
     printf( "Writing output files...\n" );
     fflush( stdout );
 
-    write_tif_tfw_files(
-        out_dat_file, out_hdr_file, nrows, ncols, xmin, xmax, ymin, ymax, data, software2 );
+    if (bits8) {
+        write_8bit_tif_tfw_files(
+            out_dat_file, out_hdr_file, nrows, ncols, xmin, xmax, ymin, ymax,
+            pixels, software2, geographic, epsg, nodata, compress, overviews );
+        free( pixels );
+    } else {
+        write_tif_tfw_files(
+            out_dat_file, out_hdr_file, nrows, ncols, xmin, xmax, ymin, ymax,
+            data, software2, geographic, epsg, compress, overviews );
+        free_flt_data( data );
+    }
     
     fclose( out_dat_file );
     fclose( out_hdr_file );
 
-    free( data );
     free( software2 );
     
     // Copy optional .prj file:
@@ -0,0 +1,269 @@
+/*
+ * thread_pool.c
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "thread_pool.h"
+
+#include <stddef.h> // for ptrdiff_t
+#include <stdlib.h>
+
+#if defined( _WIN32 ) && !defined( NO_THREADS )
+#   define NO_THREADS
+#endif
+
+#ifndef NO_THREADS
+#   include <pthread.h>
+#   include <unistd.h>      // sysconf()
+#endif
+
+// Upper limit on number of threads, including the calling thread
+#define MAX_THREADS 256
+
+// Chunks per thread when splitting a loop, to balance uneven workloads
+#define CHUNKS_PER_THREAD 4
+
+static int requested_threads = 0;   // from thread_pool_set_threads()
+
+void thread_pool_set_threads( int nthreads )
+{
+    requested_threads = nthreads > MAX_THREADS ? MAX_THREADS : nthreads;
+}
+
+#ifdef NO_THREADS
+
+int thread_pool_threads( void )
+{
+    return 1;
+}
+
+void thread_pool_run(
+    long             count,
+    long             min_chunk,
+    Thread_Pool_Task task,
+    void            *state )
+{
+    if (count > 0) {
+        task( state, 0, count );
+    }
+}
+
+Thread_Pool_Background *thread_pool_start( Thread_Pool_Job job, void *state )
+{
+    job( state );
+    return NULL;
+}
+
+void thread_pool_join( Thread_Pool_Background *background )
+{
+}
+
+#else
+
+// All of the following are protected by pool_mutex
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  work_cond  = PTHREAD_COND_INITIALIZER;   // new loop started
+static pthread_cond_t  done_cond  = PTHREAD_COND_INITIALIZER;   // last chunk finished
+
+static int  workers_started = 0;    // number of worker threads created so far
+static int  busy            = 0;    // nonzero while a loop is running
+static long generation      = 0;    // incremented for each new loop
+
+static Thread_Pool_Task job_task;
+static void *job_state;
+static long  job_count;         // number of loop iterations
+static long  job_chunk;         // iterations per chunk
+static long  job_nchunks;       // number of chunks
+static long  job_next;          // next chunk not yet started
+static long  job_unfinished;    // number of chunks not yet finished
+static int   job_workers;       // number of worker threads to participate
+
+// Runs chunks of the current loop until none are left.
+// Must be called with pool_mutex locked; returns with it locked.
+static void run_chunks( void )
+{
+    while (job_next < job_nchunks) {
+        long begin = job_next++ * job_chunk;
+        long end   = begin + job_chunk < job_count ? begin + job_chunk : job_count;
+
+        pthread_mutex_unlock( &pool_mutex );
+        job_task( job_state, begin, end );
+        pthread_mutex_lock( &pool_mutex );
+
+        if (--job_unfinished == 0) {
+            pthread_cond_broadcast( &done_cond );
+        }
+    }
+}
+
+static void *worker_main( void *arg )
+{
+    int  index = (int)(ptrdiff_t)arg;
+    long seen;
+
+    pthread_mutex_lock( &pool_mutex );
+    seen = generation;
+    for (;;) {
+        while (generation == seen) {
+            pthread_cond_wait( &work_cond, &pool_mutex );
+        }
+        seen = generation;
+        if (index < job_workers) {
+            run_chunks();
+        }
+    }
+    return NULL;
+}
+
+int thread_pool_threads( void )
+{
+    static int num_cpus = 0;
+
+    if (requested_threads > 0) {
+        return requested_threads;
+    }
+    if (num_cpus == 0) {
+        long n = sysconf( _SC_NPROCESSORS_ONLN );
+        num_cpus = n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : (int)n;
+    }
+    return num_cpus;
+}
+
+void thread_pool_run(
+    long             count,
+    long             min_chunk,
+    Thread_Pool_Task task,
+    void            *state )
+{
+    int  nthreads = thread_pool_threads();
+    long chunk, nchunks;
+
+    if (count <= 0) {
+        return;
+    }
+    if (min_chunk < 1) {
+        min_chunk = 1;
+    }
+
+    chunk = (count + nthreads * CHUNKS_PER_THREAD - 1) / (nthreads * CHUNKS_PER_THREAD);
+    if (chunk < min_chunk) {
+        chunk = min_chunk;
+    }
+    nchunks = (count + chunk - 1) / chunk;
+
+    if (nthreads <= 1 || nchunks <= 1) {
+        task( state, 0, count );
+        return;
+    }
+
+    pthread_mutex_lock( &pool_mutex );
+
+    if (busy) {
+        // called from within a task (or concurrently by another thread)
+        pthread_mutex_unlock( &pool_mutex );
+        task( state, 0, count );
+        return;
+    }
+
+    while (workers_started < nthreads - 1) {
+        pthread_t thread;
+        if (pthread_create( &thread, NULL, worker_main, (void *)(ptrdiff_t)workers_started )) {
+            break;  // run with the threads we have
+        }
+        pthread_detach( thread );
+        ++workers_started;
+    }
+
+    busy           = 1;
+    job_task       = task;
+    job_state      = state;
+    job_count      = count;
+    job_chunk      = chunk;
+    job_nchunks    = nchunks;
+    job_next       = 0;
+    job_unfinished = nchunks;
+    job_workers    = nthreads - 1;
+    ++generation;
+    pthread_cond_broadcast( &work_cond );
+
+    run_chunks();
+    while (job_unfinished > 0) {
+        pthread_cond_wait( &done_cond, &pool_mutex );
+    }
+
+    busy = 0;
+    pthread_mutex_unlock( &pool_mutex );
+}
+
+struct Thread_Pool_Background {
+    pthread_t       thread;
+    Thread_Pool_Job job;
+    void           *state;
+};
+
+static void *background_main( void *arg )
+{
+    Thread_Pool_Background *background = (Thread_Pool_Background *)arg;
+
+    background->job( background->state );
+    return NULL;
+}
+
+Thread_Pool_Background *thread_pool_start( Thread_Pool_Job job, void *state )
+{
+    Thread_Pool_Background *background = NULL;
+
+    if (requested_threads != 1) {
+        background = (Thread_Pool_Background *)malloc( sizeof( Thread_Pool_Background ) );
+    }
+
+    if (background) {
+        background->job   = job;
+        background->state = state;
+        if (pthread_create( &background->thread, NULL, background_main, background ) == 0) {
+            return background;
+        }
+        free( background );
+    }
+
+    job( state );   // run it here instead
+    return NULL;
+}
+
+void thread_pool_join( Thread_Pool_Background *background )
+{
+    if (background) {
+        pthread_join( background->thread, NULL );
+        free( background );
+    }
+}
+
+#endif
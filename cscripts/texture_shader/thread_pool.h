@@ -0,0 +1,93 @@
+/*
+ * thread_pool.h
+ *
+ * Created by agent on 2026 Oct 18.
+ *
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// A minimal pool of worker threads for splitting loops whose iterations are
+// independent (see the CONCURRENCY NOTEs throughout this code). Threads are
+// created on first use and reused by later calls.
+//
+// Builds without POSIX threads (or with NO_THREADS defined) run every loop
+// on the calling thread, with identical results.
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Function to process iterations begin..end-1 of a parallel loop.
+typedef void (*Thread_Pool_Task)(
+    void *state,    // copy of state pointer passed to thread_pool_run()
+    long  begin,    // first iteration to process
+    long  end );    // one past last iteration to process
+
+// Calls task() on consecutive subranges covering iterations 0..count-1,
+// spread across the threads of the pool (including the calling thread),
+// and returns when all are done. Subranges contain at least min_chunk
+// iterations, except possibly the last; their boundaries depend only on
+// count, min_chunk, and the thread count, not on timing.
+// If called from within a task, runs the whole range on the calling thread.
+void thread_pool_run(
+    long             count,     // number of loop iterations
+    long             min_chunk, // minimum iterations per call to task()
+    Thread_Pool_Task task,      // function to process a range of iterations
+    void            *state      // pointer passed to task()
+);
+
+// Sets the number of threads used by thread_pool_run(), including the
+// calling thread; 0 (the default) uses one thread per online processor.
+void thread_pool_set_threads( int nthreads );
+
+// Returns the number of threads thread_pool_run() will use.
+int thread_pool_threads( void );
+
+// Function run in the background by thread_pool_start().
+typedef void (*Thread_Pool_Job)( void *state );
+
+// Handle for a job running in the background.
+typedef struct Thread_Pool_Background Thread_Pool_Background;
+
+// Starts job( state ) on a thread of its own, so that the caller can overlap
+// other work (such as file I/O) with it, and returns a handle to pass to
+// thread_pool_join(). Runs the job before returning, and returns NULL, if
+// threads are unavailable or the thread count was set to 1. A job that calls
+// thread_pool_run() while another loop is running runs its loop by itself.
+Thread_Pool_Background *thread_pool_start( Thread_Pool_Job job, void *state );
+
+// Waits for a job started by thread_pool_start() to finish (if handle is not NULL).
+void thread_pool_join( Thread_Pool_Background *background );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * tool_support.c
+ *
+ * Created by agent on 2026 Oct 18.
+ * Functions moved from texture.c, shadow.c, and svf.c, by Leland Brown
+ * and Kyle Bradley, NTU.
+ *
+ * Copyright (c) 2026 agent.
+ * Portions copyright (c) 2011-2013 Leland Brown.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _CRT_SECURE_NO_DEPRECATE
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "tool_support.h"
+#include "terrain_filter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <assert.h>
+
+const char *get_command_name( const char *argv[] )
+{
+    const char *colon;
+    const char *slash;
+    const char *result;
+
+    colon = strchr( argv[0], ':' );
+    if (colon) {
+        ++colon;
+    } else {
+        colon = argv[0];
+    }
+    slash = strrchr( colon, '/' );
+    if (slash) {
+        ++slash;
+    } else {
+        slash = colon;
+    }
+    result = strrchr( slash, '\\' );
+    if (result) {
+        ++result;
+    } else {
+        result = slash;
+    }
+    return result;
+}
+
+void prefix_error( void )
+{
+    fprintf( stderr, "\n*** ERROR: " );
+}
+
+static int same_extension( const char *a, const char *b )
+// Compares two extensions, ignoring case.
+{
+    while (*a && toupper( (unsigned char)*a ) == toupper( (unsigned char)*b )) {
+        ++a;
+        ++b;
+    }
+    return *a == *b;
+}
+
+static int file_exists( const char *name )
+{
+    FILE *file = fopen( name, "rb" );
+
+    if (file) {
+        fclose( file );
+    }
+
+    return file != NULL;
+}
+
+int get_filenames(
+    const char *arg, char **data_name, char **hdr_name, char **prj_name, char *ext,
+    int *is_tif )
+{
+    const char *dot;
+
+    size_t len = strlen( arg );
+    int    tif = 0;
+
+    *data_name = (char *)malloc( len+5 );   // add 5 for ".", extension, and null terminator
+    *hdr_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
+    *prj_name  = (char *)malloc( len+5 );   // assume these mallocs succeed
+
+    dot = strrchr( arg, '.' );
+
+    if (dot++ && !strpbrk( dot, "/\\" ) && strlen( dot ) <= 4) {
+        // filename has extension (of up to 4 characters)
+        tif = is_tif && (same_extension( dot, "tif" ) || same_extension( dot, "tiff" ));
+        if (!same_extension( dot, ext ) && !tif &&
+            !(is_tif && same_extension( dot, "bil" )))
+        {
+            free( *data_name );
+            free( *hdr_name );
+            free( *prj_name );
+            *data_name = *hdr_name = *prj_name = NULL;
+            return 1;
+        }
+        memcpy( ext, dot, strlen( ext ) );  // ext keeps its own null terminator
+        len -= strlen( dot );   // length up to and including the dot
+        strcpy( *data_name, arg );
+        memcpy( *hdr_name, arg, len );
+        memcpy( *prj_name, arg, len );
+        strcpy( *hdr_name+len, "hdr" );
+        strcpy( *prj_name+len, "prj" );
+    } else {
+        // filename does not have extension
+        memcpy( *data_name, arg, len );
+        (*data_name)[len] = '.';
+        strncpy( *data_name+len+1, ext, 3 );    // max 3 chars default extension
+        (*data_name)[len+4] = '\0';
+        if (is_tif && !file_exists( *data_name )) {
+            // input may be an EHdr integer grid instead
+            strcpy( *data_name+len+1, "bil" );
+            if (file_exists( *data_name )) {
+                strcpy( ext, "bil" );
+            } else {
+                strncpy( *data_name+len+1, ext, 3 );
+            }
+        }
+        memcpy( *hdr_name, arg, len );
+        memcpy( *prj_name, arg, len );
+        strcpy( *hdr_name+len, ".hdr" );
+        strcpy( *prj_name+len, ".prj" );
+    }
+
+    if (is_tif) {
+        *is_tif = tif;
+    }
+
+    return 0;
+}
+
+int print_progress( float portion, float steps_done, int total_steps, void *state )
+{
+    int *last_count = (int *)state;
+    int  this_count = (int)steps_done;
+
+    if (this_count > *last_count) {
+        printf( "Processing phase %d...\n", this_count + 1 );
+        fflush( stdout );
+        *last_count = this_count;
+    }
+
+    return 0;
+}
+
+int determine_projection(
+    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim )
+{
+    // Determine projection type:
+
+    if  ( (ydim <    0.02 && xdim <   0.02) &&
+          (xmin > -180.01 && xmax < 180.01) &&
+          (ymin >  -90.01 && ymax <  90.01) )
+    {
+        return -1;  // lat/lon (geographic) coordinates
+    } else if
+        // Kyle Bradley December 2020 : dim check interferes with along-topo grid in km/km units
+        // ( (ydim >    0.09 && xdim >   0.09) &&
+        ( (xmin < -181.00 || xmax > 181.00) &&
+          (ymin <  -91.00 || ymax >  91.00) )
+    {
+        return +1;  // projected into linear coordinates (easting/northing)
+    }
+
+    return 0;   // unable to determine correct projection type
+}
+
+void check_aspect(
+    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim,
+    int proj_type, int verbose )
+{
+    // Check pixel aspect ratio and size of map extent:
+
+    const double max_meters = 1000000.0;        // = 1000 kilometers
+    const double distortion_limit = 15.0/16.0;  // must be < 1
+
+    double xsize, ysize;
+    double xres,  yres;
+    double aspect;
+    double ynarrow;
+    double min_aspect;
+
+    if (proj_type < 0) {
+        geographic_scale( 0.5 * (ymin + ymax), &xsize, &ysize );
+
+        xres = xsize * xdim;
+        yres = ysize * ydim;
+
+        if (verbose) {
+            printf( "Assuming pixel aspect ratio of %5.3f based on latitude range.\n", xres / yres );
+            fflush( stdout );
+        }
+
+        aspect = xsize / ysize;
+        ynarrow = ymax >= -ymin ? ymax : ymin;
+        min_aspect = geographic_aspect( ynarrow );
+        if (min_aspect < aspect * distortion_limit ) {
+            fprintf( stderr, "*** WARNING: " );
+            fprintf( stderr, "Map area too large.\n" );
+            fprintf( stderr, "***          " );
+            fprintf( stderr, "(Small-scale maps require data to be in Mercator projection.)\n" );
+            fprintf( stderr, "***          " );
+            fprintf( stderr, "This will degrade the quality of the result.\n" );
+        }
+    } else {
+        if (verbose) {
+            printf( "Assuming pixel aspect ratio of %5.3f.\n", xdim / ydim );
+            fflush( stdout );
+        }
+
+        if (proj_type != 2) {
+            if (ymax - ymin > max_meters || xmax - xmin > max_meters) {
+                fprintf( stderr, "*** WARNING: " );
+                fprintf( stderr, "Map area too large. (Small-scale maps require -mercator option.)\n" );
+                fprintf( stderr, "***          " );
+                fprintf( stderr, "This will degrade the quality of the result.\n" );
+            }
+        }
+    }
+}
+
+void get_horizon_map(
+    Horizon_Map *map, const char *cache_name, const float *data, int nrows, int ncols,
+    double xdim, double ydim, int nsectors )
+{
+    FILE *cache_file;
+    int error;
+
+    cache_file = fopen( cache_name, "rb" );     // use binary mode for compatibility
+    if (cache_file) {
+        error = read_horizon_map( map, cache_file, data, nrows, ncols, xdim, ydim, nsectors );
+        fclose( cache_file );
+    } else {
+        error = HORIZON_FILE_ERROR;
+    }
+
+    if (error && error != HORIZON_MALLOC_ERROR) {
+        // missing or stale cache file
+        error = compute_horizon_map( map, data, nrows, ncols, xdim, ydim, nsectors );
+        if (!error) {
+            cache_file = fopen( cache_name, "wb" ); // use binary mode for compatibility
+            if (!cache_file || write_horizon_map( map, cache_file, data, xdim, ydim )) {
+                fprintf( stderr, "*** WARNING: " );
+                fprintf( stderr, "Could not write horizon cache file '%s'.\n", cache_name );
+            }
+            if (cache_file) {
+                fclose( cache_file );
+            }
+        }
+    }
+
+    if (error) {
+        assert( error == HORIZON_MALLOC_ERROR );
+        prefix_error();
+        fprintf( stderr, "Memory allocation error occurred during processing of data.\n" );
+        exit( EXIT_FAILURE );
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * tool_support.h
+ *
+ * Created by agent on 2026 Oct 18.
+ * Functions moved from texture.c, shadow.c, and svf.c, by Leland Brown
+ * and Kyle Bradley, NTU.
+ *
+ * Copyright (c) 2026 agent.
+ * Portions copyright (c) 2011-2013 Leland Brown.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Command-line support shared by the texture, texture_image, shadow, and svf
+// tools: file naming, projection checks, and loading cached horizon maps.
+//
+
+#ifndef TOOL_SUPPORT_H
+#define TOOL_SUPPORT_H
+
+#include "horizon_map.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns name of command (argv[0] without any path or drive).
+const char *get_command_name( const char *argv[] );
+
+// Starts an error message on stderr.
+void prefix_error( void );
+
+// Builds names of data (with default extension ext, e.g. "flt"), .hdr, and .prj
+// files from arg, which may have an extension of up to 4 characters; if it does,
+// it must be ext (in any case), and is copied into ext. If is_tif is not NULL
+// (for an input file), a .bil extension is also accepted, as is .tif or .tiff
+// (for a GeoTIFF file), and *is_tif is set to say if arg has one; an input with
+// no extension is taken as .bil (copied into ext) if only that file exists.
+// NOTE: caller is responsible to free pointers *data_name, *hdr_name, and *prj_name!
+// Returns 0 on success, nonzero (with the three pointers set to NULL) if arg has
+// an extension other than these.
+int get_filenames(
+    const char *arg, char **data_name, char **hdr_name, char **prj_name, char *ext,
+    int *is_tif );
+
+// Terrain_Progress_Callback printing the processing phase to stdout.
+int print_progress( float portion, float steps_done, int total_steps, void *state );
+
+// Returns -1 for geographic coordinates, +1 for projected coordinates, 0 if unable to determine
+int determine_projection(
+    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim );
+
+// Warns on stderr if the map extent is too large for the projection type
+// (2 = Mercator); if verbose, also prints the pixel aspect ratio to stdout.
+void check_aspect(
+    double xmin, double xmax, double ymin, double ymax, double xdim, double ydim,
+    int proj_type, int verbose );
+
+// Loads horizon map from cache file if it matches the data, otherwise
+// computes it and (re)writes the cache file. Exits on memory allocation error.
+void get_horizon_map(
+    Horizon_Map *map, const char *cache_name, const float *data, int nrows, int ncols,
+    double xdim, double ydim, int nsectors );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -32,6 +32,7 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "transpose_inplace.h"
+#include "thread_pool.h"
 
 #include "compatibility.h"
 
@@ -45,7 +46,14 @@
 #   include <stdint.h>      // intptr_t
 #   include <unistd.h>      // sysconf(), getpagesize()
 #   include <sys/types.h>
-#   include <sys/mman.h>    // posix_madvise()
+#   include <sys/mman.h>    // posix_madvise(), mmap()
+#endif
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>   // _MM_TRANSPOSE4_PS()
+#   define TRANSPOSE_SSE 1
+#else
+#   define TRANSPOSE_SSE 0
 #endif
 
 // For a 64-bit compile we need LONG to be 64 bits, even if the compiler uses an LLP64 model
@@ -63,6 +71,25 @@
 //#define SIMPLE_CASES_SPECIAL 1
 #define SIMPLE_CASES_SPECIAL 0
 
+// Compilation options - performance tuning:
+
+// Side of the square tiles moved by transpose_tile(); a multiple of 4
+#define TILE 8
+//#define TILE 16
+
+// Minimum number of elements to split a single transpose_outplace() across threads
+#define PARALLEL_MIN_ELEMS (1L << 16)
+
+// Elements transposed between progress reports when transposing out of place
+#define SLAB_ELEMS (1L << 22)
+
+// Default memory budget for transposing out of place, as a fraction of physical memory,
+// when using more than one thread. Faulting in a fresh buffer costs about as much as
+// the in-place algorithm saves on a single core, so then only small matrices use a buffer;
+// with more threads, the buffer's transpose and copy run fully in parallel, while the
+// in-place algorithm moves blocks in sequence.
+#define DEFAULT_BUDGET_FRACTION 0.25
+
 
 #ifdef _WIN32
 //  static INLINE void madv_dontneed( const void *addr, size_t len ) { }
@@ -100,7 +127,10 @@ static INLINE int report_progress( const struct Transpose_Progress_Info *info )
         info->progress->state );
 }
 
-static int transpose_inplace_small( float *a, long nrows, long ncols );
+static size_t get_memory_budget( void );
+
+static int transpose_via_buffer(
+    float *a, long nrows, long ncols, struct Transpose_Progress_Info *progress_info );
 
 static void transpose_outplace(
     const void *RESTRICT a, void *RESTRICT b, long nrows, long ncols );
@@ -161,8 +191,20 @@ int transpose_inplace(
         return 0;   // no work to do (nrows <= 1 or ncols <= 1)
     }
 
-    if (nbands <= 2) {
-        return transpose_inplace_small( a, nrows, ncols );
+    if (progress) {
+        progress_info.progress = progress;
+        progress_info.moves_done = 0;
+        progress_ptr = &progress_info;
+    }
+
+    if (nbands <= 2 ||
+        (double)nrows * (double)ncols * sizeof( float ) <= (double)get_memory_budget())
+    {
+        // transposing out of place is faster, if a buffer can be allocated
+        error = transpose_via_buffer( a, nrows, ncols, progress_ptr );
+        if (error <= 0 || nbands <= 2) {
+            return error;
+        }
     }
 
     error = setup_bands( a, a, nrows, ncols, nbands, nbands, &bufin, &bufout, &pinfo, &qinfo );
@@ -171,12 +213,7 @@ int transpose_inplace(
         return 1;
     }
     
-    if (progress) {
-        progress_info.progress = progress;
-        progress_info.per_move = 2.0 / (float)( 7 * (LONG)nbands * (LONG)nbands - (LONG)nbands );
-        progress_info.moves_done = 0;
-        progress_ptr = &progress_info;
-    }
+    progress_info.per_move = 2.0 / (float)( 7 * (LONG)nbands * (LONG)nbands - (LONG)nbands );
 
     cancel = cancel || isolate_blocks( a, pinfo, qinfo, nrows, ncols, nbands, progress_ptr );
 
@@ -199,37 +236,239 @@ int transpose_inplace(
     return 0;
 }
 
+// Transposes one TILE x TILE tile: to[j*tostride+i] = from[i*fromstride+j].
+static INLINE void transpose_tile(
+    const float *RESTRICT from, LONG fromstride, float *RESTRICT to, LONG tostride )
+{
+    int i, j;
+#if TRANSPOSE_SSE
+    // transpose each 4x4 sub-tile in SSE registers
+    for (i=0; i<TILE; i+=4) {
+        for (j=0; j<TILE; j+=4) {
+            const float *RESTRICT f = from + i * fromstride + j;
+            float       *RESTRICT t = to   + j * tostride   + i;
+            __m128 row0 = _mm_loadu_ps( f );
+            __m128 row1 = _mm_loadu_ps( f + fromstride );
+            __m128 row2 = _mm_loadu_ps( f + fromstride * 2 );
+            __m128 row3 = _mm_loadu_ps( f + fromstride * 3 );
+            _MM_TRANSPOSE4_PS( row0, row1, row2, row3 );
+            _mm_storeu_ps( t,                row0 );
+            _mm_storeu_ps( t + tostride,     row1 );
+            _mm_storeu_ps( t + tostride * 2, row2 );
+            _mm_storeu_ps( t + tostride * 3, row3 );
+        }
+    }
+#else
+    for (j=0; j<TILE; ++j) {
+        for (i=0; i<TILE; ++i) {
+            to[j * tostride + i] = from[i * fromstride + j];
+        }
+    }
+#endif
+}
+
+// Transposes columns jbegin..jend-1 of matrix a (nrows x ncols)
+// to rows jbegin..jend-1 of matrix b (ncols x nrows).
+static void transpose_columns(
+    const float *RESTRICT a, float *RESTRICT b, long nrows, long ncols, long jbegin, long jend )
+{
+    long i, j, jtile;
+
+    for (jtile=jbegin; jtile+TILE<=jend; jtile+=TILE) {
+        const float *RESTRICT fromcol = a + jtile;
+        float       *RESTRICT torow   = b + (LONG)jtile * (LONG)nrows;
+        for (i=0; i+TILE<=nrows; i+=TILE) {
+            transpose_tile( fromcol + (LONG)i * (LONG)ncols, ncols, torow + i, nrows );
+        }
+        for (; i<nrows; ++i) {
+            for (j=0; j<TILE; ++j) {
+                torow[(LONG)j * (LONG)nrows + i] = fromcol[(LONG)i * (LONG)ncols + j];
+            }
+        }
+    }
+    for (j=jtile; j<jend; ++j) {
+        const float *RESTRICT fromcol = a + j;
+        float       *RESTRICT torow   = b + (LONG)j * (LONG)nrows;
+        for (i=0; i<nrows; ++i) {
+            torow[i] = fromcol[(LONG)i * (LONG)ncols];
+        }
+    }
+}
+
+struct Transpose_Columns_Task {
+    const float *a;
+    float       *b;
+    long         nrows;
+    long         ncols;
+    long         jfirst;    // first column of range to transpose
+    long         jlast;     // one past last column of range
+};
+
+// Thread_Pool_Task for transpose_columns(); iterations are groups of TILE columns
+static void transpose_columns_task( void *state, long begin, long end )
+{
+    const struct Transpose_Columns_Task *task = (const struct Transpose_Columns_Task *)state;
+    long jbegin = task->jfirst + begin * TILE;
+    long jend   = task->jfirst + end   * TILE;
+    if (jend > task->jlast) {
+        jend = task->jlast;
+    }
+    transpose_columns( task->a, task->b, task->nrows, task->ncols, jbegin, jend );
+}
+
+// Transposes columns jbegin..jend-1 of a to rows of b, using multiple threads if worthwhile.
+static void transpose_columns_parallel(
+    const float *RESTRICT a, float *RESTRICT b, long nrows, long ncols, long jbegin, long jend )
+{
+    struct Transpose_Columns_Task task;
+    long ngroups = (jend - jbegin + TILE - 1) / TILE;
+
+    if ((LONG)nrows * (LONG)(jend - jbegin) < PARALLEL_MIN_ELEMS) {
+        transpose_columns( a, b, nrows, ncols, jbegin, jend );
+        return;
+    }
+
+    task.a      = a;
+    task.b      = b;
+    task.nrows  = nrows;
+    task.ncols  = ncols;
+    task.jfirst = jbegin;
+    task.jlast  = jend;
+    thread_pool_run( ngroups, 1, transpose_columns_task, &task );
+}
+
 static void transpose_outplace(
     const void *RESTRICT a, void *RESTRICT b, long nrows, long ncols )
 {
-    const float *RESTRICT fromaddr = (const float *)a;
-          float *RESTRICT toaddr   =       (float *)b;
-    long i, j;
-    // write each new row sequentially, gather from columns
-    for (j=0; j<ncols; ++j) {
-        const float *RESTRICT fromcol = fromaddr + j;
-        for (i=0; i<nrows; ++i) {
-            *toaddr++ = *fromcol;
-            fromcol  += ncols;
+    transpose_columns_parallel( (const float *)a, (float *)b, nrows, ncols, 0, ncols );
+}
+
+// Memory budget for transpose_via_buffer(); see transpose_set_memory_budget()
+static int    memory_budget_set = 0;
+static size_t memory_budget     = 0;
+
+void transpose_set_memory_budget( size_t bytes )
+{
+    memory_budget     = bytes;
+    memory_budget_set = 1;
+}
+
+static size_t get_memory_budget( void )
+{
+    // the default depends on the thread count, which may change between calls
+    if (!memory_budget_set && thread_pool_threads() > 1) {
+#ifndef _WIN32
+        double physical = (double)sysconf( _SC_PHYS_PAGES ) * (double)sysconf( _SC_PAGESIZE );
+        if (physical > 0.0) {
+            double budget = physical * DEFAULT_BUDGET_FRACTION;
+            return budget < (double)(size_t)-1 ? (size_t)budget : (size_t)-1;
         }
+#endif
     }
+    return memory_budget;
 }
 
-static int transpose_inplace_small( float *a, long nrows, long ncols )
+// Allocates a large temporary buffer, backed by huge pages where available
+// to reduce TLB misses during the transpose. Free with free_buffer().
+static void *alloc_buffer( size_t size )
 {
-    LONG totalsize = (LONG)nrows * (LONG)ncols * sizeof( float );
+#if !defined( _WIN32 ) && defined( MAP_ANONYMOUS ) && defined( MADV_HUGEPAGE )
+    void *buf = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if (buf == MAP_FAILED) {
+        return NULL;
+    }
+    madvise( buf, size, MADV_HUGEPAGE );   // only a hint; ignore failure
+    return buf;
+#else
+    return malloc( size );
+#endif
+}
 
-    float *RESTRICT b = (float *)malloc( totalsize );
-    
+static void free_buffer( void *buf, size_t size )
+{
+#if !defined( _WIN32 ) && defined( MAP_ANONYMOUS ) && defined( MADV_HUGEPAGE )
+    munmap( buf, size );
+#else
+    free( buf );
+#endif
+}
+
+struct Copy_Task {
+    char       *to;
+    const char *from;
+    LONG        chunk;  // bytes per iteration
+    LONG        size;   // total bytes
+};
+
+static void copy_task( void *state, long begin, long end )
+{
+    const struct Copy_Task *task = (const struct Copy_Task *)state;
+    LONG start  = (LONG)begin * task->chunk;
+    LONG finish = (LONG)end   * task->chunk;
+    if (finish > task->size) {
+        finish = task->size;
+    }
+    memcpy( task->to + start, task->from + start, finish - start );
+}
+
+static int transpose_via_buffer(
+    float *a, long nrows, long ncols, struct Transpose_Progress_Info *progress_info )
+// Transposes matrix out of place into a temporary buffer, then copies it back.
+// Returns 0 on success, 1 if a memory allocation error occurred (with matrix unchanged),
+// or -1 if canceled via progress callback (leaving matrix corrupted).
+{
+    const LONG copy_chunk = 1L << 16;   // bytes copied per thread pool iteration
+
+    LONG   totalsize = (LONG)nrows * (LONG)ncols * sizeof( float );
+    long   slab, jbegin, jend;
+    LONG   offset;
+    float *RESTRICT b;
+
+    struct Copy_Task copy;
+
+    b = (float *)alloc_buffer( totalsize );
     if (!b) {
         return 1;
     }
-    
-    transpose_outplace( a, b, nrows, ncols );
 
-    memcpy( a, b, totalsize );
-    
-    free( b );
+    // transpose in slabs of columns, reporting progress between slabs
+
+    slab = SLAB_ELEMS / nrows;
+    slab = slab < TILE ? TILE : slab - slab % TILE;
+    for (jbegin=0; jbegin<ncols; jbegin=jend) {
+        jend = jbegin + slab < ncols ? jbegin + slab : ncols;
+        transpose_columns_parallel( a, b, nrows, ncols, jbegin, jend );
+        if (progress_info && progress_info->progress->callback(
+            0.5f * (float)jend / (float)ncols, progress_info->progress->state ))
+        {
+            free_buffer( b, totalsize );
+            return -1;
+        }
+    }
+
+    // copy back, also in slabs
+
+    copy.to    = (char *)a;
+    copy.from  = (const char *)b;
+    copy.chunk = copy_chunk;
+    copy.size  = totalsize;
+    for (offset=0; offset<totalsize; offset+=SLAB_ELEMS*sizeof( float )) {
+        struct Copy_Task part = copy;
+        part.to   += offset;
+        part.from += offset;
+        part.size  = totalsize - offset < (LONG)(SLAB_ELEMS*sizeof( float )) ?
+                     totalsize - offset : (LONG)(SLAB_ELEMS*sizeof( float ));
+        thread_pool_run( (long)((part.size + copy_chunk - 1) / copy_chunk), 1, copy_task, &part );
+        if (progress_info && progress_info->progress->callback(
+            0.5f + 0.5f * (float)(offset + part.size) / (float)totalsize,
+            progress_info->progress->state ))
+        {
+            free_buffer( b, totalsize );
+            return -1;
+        }
+    }
+
+    free_buffer( b, totalsize );
         
     return 0;
 }
@@ -404,6 +643,75 @@ static int setup_bands(
     return 1;
 }
 
+// Minimum rows per thread pool chunk, for rows of the given size in bytes
+static INLINE long parallel_min_rows( LONG rowsize )
+{
+    LONG rows = PARALLEL_MIN_ELEMS * sizeof( float ) / (rowsize > 0 ? rowsize : 1);
+    return rows > 1 ? (long)rows : 1;
+}
+
+struct Isolate_Rows_Task {
+    const char      *fromband;  // first row of band
+    char            *toaddr;    // destination of first block
+    LONG             rowsize;   // bytes per row
+    long             psize;     // rows in band
+    const Band_Info *qinfo;
+    int              nbands;
+};
+
+// Thread_Pool_Task distributing rows begin..end-1 of a band to its blocks
+static void isolate_rows_task( void *state, long begin, long end )
+{
+    const struct Isolate_Rows_Task *task = (const struct Isolate_Rows_Task *)state;
+    const LONG elemsize = sizeof( float );
+
+    int  j;
+    long k;
+
+    for (k=begin; k<end; ++k) {
+        const char *fromaddr = task->fromband + k * task->rowsize;
+        char       *toblock  = task->toaddr;
+        for (j=0; j<task->nbands; ++j) {
+            LONG qsize = task->qinfo[j].size * elemsize;
+            memcpy( toblock + qsize * k, fromaddr, qsize );
+            toblock  += qsize * task->psize;
+            fromaddr += qsize;
+        }
+    }
+}
+
+struct Merge_Rows_Task {
+    char            *toband;    // first new row of band
+    const char      *fromaddr;  // first block of band
+    LONG             colsize;   // bytes per new row
+    long             qsize;     // new rows in band
+    const Band_Info *pinfo;
+    int              nbands;
+};
+
+// Thread_Pool_Task gathering new rows begin..end-1 of a band from its blocks
+static void merge_rows_task( void *state, long begin, long end )
+{
+    const struct Merge_Rows_Task *task = (const struct Merge_Rows_Task *)state;
+    const LONG elemsize = sizeof( float );
+
+    int  i;
+    long k;
+
+    for (k=begin; k<end; ++k) {
+        const char *fromblock = task->fromaddr;
+        char       *torow     = task->toband + k * task->colsize;
+        char       *toaddr    = torow;
+        for (i=0; i<task->nbands; ++i) {
+            LONG psize = task->pinfo[i].size * elemsize;
+            memcpy( toaddr, fromblock + psize * k, psize );
+            fromblock += psize * task->qsize;
+            toaddr    += psize;
+        }
+        madv_dontneed( torow, task->colsize );
+    }
+}
+
 static int isolate_blocks(
     void *a, const Band_Info *RESTRICT pinfo, const Band_Info *RESTRICT qinfo,
     long nrows, long ncols, int nbands,
@@ -452,21 +760,17 @@ static int isolate_blocks(
             
                 // read each row sequentially, distribute to blocks
                 
-                char *fromaddr = fromband;
-                // CONCURRENCY NOTE: The iterations of this loop (over k)
-                // will be independent and can be executed in parallel,
-                // if each thread has its own fromaddr initialized
-                // as in the comment below.
-                for (k=0; k<pinfo[i].size; ++k) {
-                    //char *fromaddr = fromband + k * rowsize;  // for concurrency
-                    char *toblock = toaddr;
-                    for (j=0; j<nbands; ++j) {
-                        LONG qsize = qinfo[j].size * elemsize;
-                        memcpy( toblock + qsize * k, fromaddr, qsize );
-                        toblock  += qsize * pinfo[i].size;
-                        fromaddr += qsize;
-                    }
-                }
+                // The iterations over rows are independent,
+                // so they are split across threads.
+                struct Isolate_Rows_Task task;
+                task.fromband = fromband;
+                task.toaddr   = toaddr;
+                task.rowsize  = rowsize;
+                task.psize    = pinfo[i].size;
+                task.qinfo    = qinfo;
+                task.nbands   = nbands;
+                thread_pool_run( pinfo[i].size, parallel_min_rows( rowsize ),
+                    isolate_rows_task, &task );
                 madv_dontneed( toaddr, bandsize );
             
                 if (progress_info) {
@@ -533,23 +837,17 @@ static int merge_blocks(
             
                 // write each new row sequentially, gathering from blocks
                 
-                char *toaddr = toband;
-                // CONCURRENCY NOTE: The iterations of this loop (over k)
-                // will be independent and can be executed in parallel,
-                // if each thread has its own toaddr initialized
-                // as in the comment below.
-                for (k=0; k<qinfo[j].size; ++k) {
-                    //char *toaddr = toband + k * colsize;  // for concurrency
-                    const char *fromblock = fromaddr;
-                    char       *torow     = toaddr;
-                    for (i=0; i<nbands; ++i) {
-                        LONG psize = pinfo[i].size * elemsize;
-                        memcpy( toaddr, fromblock + psize * k, psize );
-                        fromblock += psize * qinfo[j].size;
-                        toaddr    += psize;
-                    }
-                    madv_dontneed( torow, colsize );
-                }
+                // The iterations over new rows are independent,
+                // so they are split across threads.
+                struct Merge_Rows_Task task;
+                task.toband   = toband;
+                task.fromaddr = fromaddr;
+                task.colsize  = colsize;
+                task.qsize    = qinfo[j].size;
+                task.pinfo    = pinfo;
+                task.nbands   = nbands;
+                thread_pool_run( qinfo[j].size, parallel_min_rows( colsize ),
+                    merge_rows_task, &task );
             
                 if (progress_info) {
                     progress_info->moves_done += nbands;
@@ -31,6 +31,8 @@
 #ifndef TRANSPOSE_INPLACE_H
 #define TRANSPOSE_INPLACE_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -55,6 +57,13 @@ int transpose_inplace(
           *progress     // optional callback functor for status; NULL for none
 );
 
+// Sets the largest matrix size (in bytes) that transpose_inplace() may transpose
+// via a temporary buffer of the same size, which is faster than the in-place
+// algorithm on more than one thread. 0 means always transpose in place (except
+// for small matrices). The default is a quarter of physical memory when
+// thread_pool_threads() is more than 1, else 0.
+void transpose_set_memory_budget( size_t bytes );
+
 #ifdef __cplusplus
 }
 #endif
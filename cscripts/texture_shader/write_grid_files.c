@@ -36,11 +36,26 @@
 #include "write_grid_files.h"
 
 #include "WriteGrayscaleTIFF.h"
+#include "thread_pool.h"
 
+#include <stddef.h> // for ptrdiff_t
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+// For a 64-bit compile we need LONG to be 64 bits, even if the compiler uses an LLP64 model
+#define LONG ptrdiff_t
+
+// Rows per chunk for output statistics
+#define FLT_CHUNK_ROWS 16
+
+// Approximate size of each block of .flt output converted in parallel and
+// written with a single fwrite()
+#define FLT_BATCH_BYTES (16L << 20)
+
+// Initial NODATA value for .flt output; values below half of it may change it
+#define FLT_NODATA_START -1.0e+06
+
 static int am_big_endian()
 {
     const int one = 1;
@@ -142,25 +157,9 @@ void write_bil_hdr_files(
         (float)nodata, (float)min_value, (float)max_value, 0, software );
 }
 
-void write_tif_tfw_files(
-    FILE *out_tif_file, // .tif file - should be opened in BINARY mode
-    FILE *out_tfw_file, // .tfw file - should be opened in BINARY mode
-    int nrows,          // number of rows in data array
-    int ncols,          // number of cols in data array
-    double xmin,        // min X coordinate (longitude or easting)
-    double xmax,        // max X coordinate (longitude or easting)
-    double ymin,        // min Y coordinate (latitude  or northing)
-    double ymax,        // max Y coordinate (latitude  or northing)
-    const float *data,  // array of data values
-    const char *software // software name and version number (optional)
-)
+static void check_tif_output( int error, size_t fileSize )
+// Exits on error, or warns if the .tif file may be too big for some readers
 {
-    int error;
-    size_t fileSize;
-    
-    // Write .tif file:
-
-    error = WriteGrayscale16BitToTIFF( out_tif_file, ncols, nrows, data, software, &fileSize );
     if (error == -2) {
         error_exit( "Memory allocation error occurred during file output." );
     }
@@ -183,68 +182,315 @@ void write_tif_tfw_files(
         fprintf( stderr,
             "This may not be readable by some TIFF readers.\n" );
     }
+}
+
+static void set_geotiff_info(
+    GeoTIFFInfo *geo, int nrows, int ncols,
+    double xmin, double xmax, double ymin, double ymax, int geographic, int epsg )
+{
+    geo->xmin       = xmin;
+    geo->ymax       = ymax;
+    geo->xdim       = (xmax - xmin) / (double)ncols;
+    geo->ydim       = (ymax - ymin) / (double)nrows;
+    geo->geographic = geographic;
+    geo->epsg       = epsg;
+}
+
+void write_tif_tfw_files(
+    FILE *out_tif_file, // .tif file - should be opened in BINARY mode
+    FILE *out_tfw_file, // .tfw file - should be opened in BINARY mode
+    int nrows,          // number of rows in data array
+    int ncols,          // number of cols in data array
+    double xmin,        // min X coordinate (longitude or easting)
+    double xmax,        // max X coordinate (longitude or easting)
+    double ymin,        // min Y coordinate (latitude  or northing)
+    double ymax,        // max Y coordinate (latitude  or northing)
+    const float *data,  // array of data values
+    const char *software, // software name and version number (optional)
+    int geographic,     // nonzero if coordinates are longitude and latitude
+    int epsg,           // EPSG code of coordinate system for GeoTIFF tags (0 if unknown)
+    int compress,       // nonzero to write compressed tiles (see WriteGrayscaleTIFF.h)
+    int overviews       // nonzero to also write overviews of compressed tiles
+)
+{
+    int error;
+    size_t fileSize;
+    GeoTIFFInfo geo;
+    
+    // Write .tif file:
+
+    set_geotiff_info( &geo, nrows, ncols, xmin, xmax, ymin, ymax, geographic, epsg );
+
+    if (compress) {
+        error = WriteGrayscale16BitToCompressedTIFF(
+            out_tif_file, ncols, nrows, data, software, &geo, overviews, &fileSize );
+    } else {
+        error = WriteGrayscale16BitToTIFF(
+            out_tif_file, ncols, nrows, data, software, &geo, &fileSize );
+    }
+    check_tif_output( error, fileSize );
 
     // Write .tfw file:
 
     write_tfw_file( out_tfw_file, nrows, ncols, xmin, xmax, ymin, ymax );
 }
 
+void write_8bit_tif_tfw_files(
+    FILE *out_tif_file, // .tif file - should be opened in BINARY mode
+    FILE *out_tfw_file, // .tfw file - should be opened in BINARY mode
+    int nrows,          // number of rows in data array
+    int ncols,          // number of cols in data array
+    double xmin,        // min X coordinate (longitude or easting)
+    double xmax,        // max X coordinate (longitude or easting)
+    double ymin,        // min Y coordinate (latitude  or northing)
+    double ymax,        // max Y coordinate (latitude  or northing)
+    const unsigned char *data,
+                        // array of pixel values
+    const char *software, // software name and version number (optional)
+    int geographic,     // nonzero if coordinates are longitude and latitude
+    int epsg,           // EPSG code of coordinate system for GeoTIFF tags (0 if unknown)
+    int nodata,         // pixel value of void pixels, or -1 if none
+    int compress,       // nonzero to write compressed tiles (see WriteGrayscaleTIFF.h)
+    int overviews       // nonzero to also write overviews of compressed tiles
+)
+{
+    int error;
+    size_t fileSize;
+    GeoTIFFInfo geo;
+    
+    // Write .tif file:
+
+    set_geotiff_info( &geo, nrows, ncols, xmin, xmax, ymin, ymax, geographic, epsg );
+
+    if (compress) {
+        error = WriteGrayscale8BitToCompressedTIFF(
+            out_tif_file, ncols, nrows, data, software, &geo, nodata, overviews, &fileSize );
+    } else {
+        error = WriteGrayscale8BitToTIFF(
+            out_tif_file, ncols, nrows, data, software, &geo, nodata, &fileSize );
+    }
+    check_tif_output( error, fileSize );
+
+    // Write .tfw file:
+
+    write_tfw_file( out_tfw_file, nrows, ncols, xmin, xmax, ymin, ymax );
+}
+
+// Statistics of one chunk of rows of .flt output
+typedef struct {
+    float min_value;    // minimum non-NaN value (if any)
+    float max_value;    // maximum non-NaN value (if any)
+    LONG  first_nan;    // array index of first NaN, or -1 if none
+    int   has_values;   // nonzero if any value is not NaN
+    int   has_low;      // nonzero if any value is below FLT_NODATA_START/2
+} Flt_Stats;
+
+// Parameters shared by all chunks of .flt output
+typedef struct {
+    const float *data;
+    float       *buffer;    // converted output for rows first_row onward
+    Flt_Stats   *stats;     // statistics of each chunk
+    int    nrows;
+    int    ncols;
+    int    first_row;       // first row of buffer
+    LONG   first_nan;       // array index of first NaN, or -1 if none
+    float  nodata;          // value replacing NaNs
+    char  *conflict;        // per row of buffer: set nonzero if, in the chunk starting
+                            // there, a value after first_nan equals nodata
+} Flt_Task;
+
+// Thread_Pool_Task finding statistics of chunks begin..end-1
+static void flt_stats_task( void *state, long begin, long end )
+{
+    Flt_Task *task = (Flt_Task *)state;
+
+    long n;
+
+    for (n=begin; n<end; ++n) {
+        Flt_Stats *stats = task->stats + n;
+
+        LONG first = (LONG)n * FLT_CHUNK_ROWS * task->ncols;
+        LONG last  = (LONG)(n + 1) * FLT_CHUNK_ROWS * task->ncols;
+        LONG k;
+
+        if (last > (LONG)task->nrows * task->ncols) {
+            last = (LONG)task->nrows * task->ncols;
+        }
+
+        stats->first_nan  = -1;
+        stats->has_values = 0;
+        stats->has_low    = 0;
+
+        for (k=first; k<last; ++k) {
+            float value = task->data[k];
+            if (flt_isnan( value )) {
+                if (stats->first_nan < 0) {
+                    stats->first_nan = k;
+                }
+                continue;
+            }
+            if (!stats->has_values) {
+                stats->min_value  = value;
+                stats->max_value  = value;
+                stats->has_values = 1;
+            } else if (value < stats->min_value) {
+                stats->min_value = value;
+            } else if (value > stats->max_value) {
+                stats->max_value = value;
+            }
+            if (value < FLT_NODATA_START * 0.5) {
+                stats->has_low = 1;
+            }
+        }
+    }
+}
+
+// Thread_Pool_Task converting rows first_row+begin..first_row+end-1 into buffer
+static void flt_convert_task( void *state, long begin, long end )
+{
+    Flt_Task *task = (Flt_Task *)state;
+
+    LONG first = ((LONG)task->first_row + begin) * task->ncols;
+    LONG last  = ((LONG)task->first_row + end)   * task->ncols;
+    LONG k;
+
+    const float *data   = task->data;
+    float       *buffer = task->buffer - (LONG)task->first_row * task->ncols;
+
+    for (k=first; k<last; ++k) {
+        if (flt_isnan( data[k] )) {
+            buffer[k] = task->nodata;
+        } else {
+            if (data[k] == task->nodata && k > task->first_nan) {
+                task->conflict[begin] = 1;  // each chunk writes only its own flag
+            }
+            buffer[k] = data[k];
+        }
+    }
+}
+
 static void write_flt_file(
     FILE *out_flt_file, int nrows, int ncols,
     const float *data, float *nodata, float *min_value, float *max_value )
 {
     // Write .flt file and find min/max values:
     
-    int i, j;
-    int count;
-    int has_nulls = 0;
-    int error;
+    Flt_Task task;
 
-    const float *ptr;
+    long nchunks    = (nrows + FLT_CHUNK_ROWS - 1) / FLT_CHUNK_ROWS;
+    long batch_rows = FLT_BATCH_BYTES / ((long)ncols * (long)sizeof( float ));
 
-    int bufsize = ncols * sizeof( float );
-    float *buffer = (float *)malloc( bufsize );
-    
-    if (!buffer) {
+    int  has_low = 0;
+    int  count;
+    int  error;
+    int  i;
+    long n;
+
+    if (batch_rows < 1) {
+        batch_rows = 1;
+    } else if (batch_rows > nrows) {
+        batch_rows = nrows;
+    }
+
+    task.data      = data;
+    task.stats     = (Flt_Stats *)malloc( nchunks * sizeof( Flt_Stats ) );
+    task.nrows     = nrows;
+    task.ncols     = ncols;
+    task.first_nan = -1;
+
+    if (!task.stats) {
         error_exit( "Memory allocation error occurred during file output." );
     }
-    
-    *nodata = -1.0e+06; // must be negative for code below to work correctly
-    //*nodata = -1.0e+38;
 
+    // CONCURRENCY NOTE: Each chunk reads only the data array and writes only
+    // its own statistics, which are then combined in order, so the results
+    // are identical to a single pass over the data.
+
+    thread_pool_run( nchunks, 1, flt_stats_task, &task );
+
+    // if data[0] is NaN, min & max stay NaN (as in a single pass)
     *min_value = *data;
     *max_value = *data;
 
-    for (i=0, ptr=data; i<nrows; ++i, ptr+=ncols) {
-        memcpy( buffer, ptr, bufsize );
-        
-        for (j=0; j<ncols; ++j) {
-            if (flt_isnan( buffer[j] )) {
-                buffer[j] = *nodata;
-                has_nulls = 1;
-                continue;
+    for (n=0; n<nchunks; ++n) {
+        const Flt_Stats *stats = task.stats + n;
+        if (task.first_nan < 0) {
+            task.first_nan = stats->first_nan;
+        }
+        if (stats->has_values) {
+            if (stats->min_value < *min_value) {
+                *min_value = stats->min_value;
             }
-            if (!has_nulls) {
-                if (buffer[j] < *nodata * 0.5) {    // assumes nodata < 0
-                    *nodata *= 10.0;
-                }
-            } else if (buffer[j] == *nodata) {
+            if (stats->max_value > *max_value) {
+                *max_value = stats->max_value;
+            }
+        }
+        has_low = has_low || stats->has_low;
+    }
+
+    free( task.stats );
+
+    *nodata = FLT_NODATA_START; // must be negative for code below to work correctly
+    //*nodata = -1.0e+38;
+
+    // Until the first NaN, NODATA is moved (by a factor of 10 per value) below
+    // any values near it, in order; this is rarely needed.
+
+    if (has_low) {
+        LONG last = task.first_nan >= 0 ? task.first_nan : (LONG)nrows * ncols;
+        LONG k;
+        for (k=0; k<last; ++k) {
+            if (data[k] < *nodata * 0.5) {  // assumes nodata < 0
+                *nodata *= 10.0;
+            }
+        }
+    }
+
+    task.nodata = *nodata;
+
+    if (task.first_nan < 0) {
+        // nothing to replace - write data array as is
+        for (i=0; i<nrows; i+=batch_rows) {
+            int  rows   = nrows - i < batch_rows ? nrows - i : (int)batch_rows;
+            LONG values = (LONG)rows * ncols;
+            if ((LONG)fwrite( data + (LONG)i * ncols, sizeof( float ), values, out_flt_file ) < values) {
+                error_exit( "Write error occurred on output .flt file." );
+            }
+        }
+    } else {
+        task.buffer   = (float *)malloc( batch_rows * ncols * sizeof( float ) );
+        task.conflict = (char  *)calloc( batch_rows, 1 );
+
+        if (!task.buffer || !task.conflict) {
+            error_exit( "Memory allocation error occurred during file output." );
+        }
+
+        for (i=0; i<nrows; i+=batch_rows) {
+            int  rows   = nrows - i < batch_rows ? nrows - i : (int)batch_rows;
+            LONG values = (LONG)rows * ncols;
+
+            task.first_row = i;
+
+            // CONCURRENCY NOTE: Each row reads only the data array and writes
+            // only its own part of the buffer, so rows are processed in parallel.
+
+            thread_pool_run( rows, FLT_CHUNK_ROWS, flt_convert_task, &task );
+
+            if (memchr( task.conflict, 1, rows )) {
                 prefix_error();
                 fprintf( stderr, "Actual output data point matches chosen NODATA value of " );
                 fprintf( stderr, "%.6g.\n", *nodata );
                 exit( EXIT_FAILURE );
             }
-            if (buffer[j] < *min_value) {
-                *min_value = buffer[j];
-            } else if (buffer[j] > *max_value) {
-                *max_value = buffer[j];
+
+            count = fwrite( task.buffer, sizeof( float ), values, out_flt_file );
+            if (count < values) {
+                error_exit( "Write error occurred on output .flt file." );
             }
         }
 
-        count = fwrite( buffer, sizeof( float ), ncols, out_flt_file );
-        if (count < ncols) {
-            error_exit( "Write error occurred on output .flt file." );
-        }
+        free( task.buffer );
+        free( task.conflict );
     }
     
     error = fflush( out_flt_file );
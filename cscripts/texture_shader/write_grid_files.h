@@ -63,6 +63,7 @@ void write_bil_hdr_files(
     const char *software // software name and version number (optional)
 );
 
+// Writes a .tif file with georeferencing in GeoTIFF tags, and the same in a .tfw file
 void write_tif_tfw_files(
     FILE *out_tif_file, // .tif file - should be opened in BINARY mode
     FILE *out_tfw_file, // .tfw file - should be opened in BINARY mode
@@ -73,7 +74,31 @@ void write_tif_tfw_files(
     double ymin,        // min Y coordinate (latitude  or northing)
     double ymax,        // max Y coordinate (latitude  or northing)
     const float *data,  // array of data values
-    const char *software // software name and version number (optional)
+    const char *software, // software name and version number (optional)
+    int geographic,     // nonzero if coordinates are longitude and latitude
+    int epsg,           // EPSG code of coordinate system for GeoTIFF tags (0 if unknown)
+    int compress,       // nonzero to write compressed tiles (see WriteGrayscaleTIFF.h)
+    int overviews       // nonzero to also write overviews of compressed tiles
+);
+
+// Writes 8-bit pixel values (e.g., from terrain_image_bytes()) as is
+void write_8bit_tif_tfw_files(
+    FILE *out_tif_file, // .tif file - should be opened in BINARY mode
+    FILE *out_tfw_file, // .tfw file - should be opened in BINARY mode
+    int nrows,          // number of rows in data array
+    int ncols,          // number of cols in data array
+    double xmin,        // min X coordinate (longitude or easting)
+    double xmax,        // max X coordinate (longitude or easting)
+    double ymin,        // min Y coordinate (latitude  or northing)
+    double ymax,        // max Y coordinate (latitude  or northing)
+    const unsigned char *data,
+                        // array of pixel values
+    const char *software, // software name and version number (optional)
+    int geographic,     // nonzero if coordinates are longitude and latitude
+    int epsg,           // EPSG code of coordinate system for GeoTIFF tags (0 if unknown)
+    int nodata,         // pixel value of void pixels, or -1 if none
+    int compress,       // nonzero to write compressed tiles (see WriteGrayscaleTIFF.h)
+    int overviews       // nonzero to also write overviews of compressed tiles
 );
 
 #ifdef __cplusplus